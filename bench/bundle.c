@@ -0,0 +1,108 @@
+// Boot-time loading of many small files, one by one versus from a single bundle.
+//
+//     cc -O2 -Isrc -DFIREFLY_NATIVE_NO_MAIN bench/bundle.c src/firefly_native.c -lm -o bundle && ./bundle
+//
+// Creates a temporary ROM directory with FILES files and a bundle of them.
+// In the native runtime, a host file call is a real file system access,
+// so the numbers show the per-call cost that the bundle avoids.
+
+#define FFPACK_NO_MAIN
+#define _DEFAULT_SOURCE
+
+#include "../tools/ffpack.c"
+#include "../src/firefly.c"
+#include "../src/firefly_assets.c"
+#include "../src/firefly_bundle.c"
+#include "../src/firefly_native.h"
+#include <time.h>
+#include <unistd.h>
+
+#define FILES 64
+#define FILE_SIZE 512
+#define ROUNDS 50
+
+static char files[FILES * FILE_SIZE];
+static char bundle[FILES * (FILE_SIZE + 16) + 8];
+static char names[FILES][16];
+static AssetKey keys[FILES];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+    char root[] = "/tmp/ffbench-XXXXXX";
+    if (mkdtemp(root) == NULL)
+    {
+        return 1;
+    }
+    char assets[64];
+    char rom[64];
+    snprintf(assets, sizeof(assets), "%s/assets", root);
+    snprintf(rom, sizeof(rom), "%s/rom", root);
+    mkdir(assets, 0755);
+    mkdir(rom, 0755);
+    for (int i = 0; i < FILES; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "sprite%02d", i);
+        keys[i] = asset_key(cstr(names[i]));
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", assets, names[i]);
+        FILE *f = fopen(path, "wb");
+        for (int j = 0; j < FILE_SIZE; j++)
+        {
+            fputc(i + j, f);
+        }
+        fclose(f);
+        snprintf(path, sizeof(path), "%s/%s", rom, names[i]);
+        f = fopen(path, "wb");
+        for (int j = 0; j < FILE_SIZE; j++)
+        {
+            fputc(i + j, f);
+        }
+        fclose(f);
+    }
+    char bundlePath[128];
+    snprintf(bundlePath, sizeof(bundlePath), "%s/bundle", rom);
+    if (ffpack_dir(assets, bundlePath) != FILES)
+    {
+        return 1;
+    }
+    native_set_rom_dir(rom);
+
+    double start = now();
+    size_t check = 0;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (int i = 0; i < FILES; i++)
+        {
+            Buffer buf = {get_file_size_str(keys[i].path), files + i * FILE_SIZE};
+            check += load_file_str(keys[i].path, buf).size;
+        }
+    }
+    double separate = (now() - start) / ROUNDS;
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        Buffer buf = {sizeof(bundle), bundle};
+        Bundle b = open_bundle(load_file_str(STR("bundle"), buf));
+        for (int i = 0; i < FILES; i++)
+        {
+            check += bundle_get(&b, keys[i]).size;
+        }
+    }
+    double bundled = (now() - start) / ROUNDS;
+
+    printf("%d files of %d bytes (check %zu)\n", FILES, FILE_SIZE, check);
+    printf("separate  %10.1f us  (%d host calls)\n", separate * 1e6, FILES * 2);
+    printf("bundle    %10.1f us  (1 host call)\n", bundled * 1e6);
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -r %s", root);
+    return system(cmd);
+}
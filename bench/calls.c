@@ -0,0 +1,87 @@
+// The cost of calling the SDK wrappers, compared between build modes.
+//
+// Build it against a separately compiled firefly.c and in the header-only mode:
+//
+//     cc -O2 -Isrc -c src/firefly.c -o firefly.o
+//     cc -O2 -Isrc -DFIREFLY_NATIVE_NO_MAIN -c src/firefly_native.c -o native.o
+//     cc -O2 -Isrc bench/calls.c firefly.o native.o -lm -o calls && ./calls
+//     cc -O2 -Isrc -DFIREFLY_HEADER_ONLY bench/calls.c native.o -lm -o calls-header && ./calls-header
+//
+// The native host imports do real work (drawing into the framebuffer, etc),
+// so the difference between the modes is the wrapper overhead only.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/firefly.h"
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS 2000000
+
+#if defined(FIREFLY_HEADER_ONLY) && defined(FIREFLY_NO_DRAW_HOOKS)
+#define MODE "header-only, no hooks"
+#elif defined(FIREFLY_HEADER_ONLY)
+#define MODE "header-only"
+#else
+#define MODE "separate firefly.c"
+#endif
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, uint32_t check)
+{
+    double took = now() - start;
+    printf("%-12s %8.2f ns/call  (check %u)\n", name, took / ROUNDS * 1e9, check);
+}
+
+int main()
+{
+    printf("mode: %s\n", MODE);
+    uint32_t check = 0;
+
+    double start = now();
+    for (int32_t i = 0; i < ROUNDS; i++)
+    {
+        Point p = {i % WIDTH, i % HEIGHT};
+        draw_point(p, (Color)(1 + i % 16));
+    }
+    report("draw_point", start, check);
+
+    start = now();
+    for (int32_t i = 0; i < ROUNDS; i++)
+    {
+        Point p = {i % WIDTH, i % HEIGHT};
+        Size s = {4, 4};
+        Style st = {RED, BLACK, 1};
+        draw_rect(p, s, st);
+    }
+    report("draw_rect", start, check);
+
+    start = now();
+    for (int32_t i = 0; i < ROUNDS; i++)
+    {
+        Pad pad = read_pad(get_me());
+        check += (uint32_t)pad.x;
+    }
+    report("read_pad", start, check);
+
+    start = now();
+    for (int32_t i = 0; i < ROUNDS; i++)
+    {
+        check += (uint32_t)get_random();
+    }
+    report("get_random", start, check);
+
+    start = now();
+    for (int32_t i = 0; i < ROUNDS; i++)
+    {
+        check += is_online(get_peers(), (Peer)(i % 32));
+    }
+    report("is_online", start, check);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Throughput of the state hash and the per-frame cost of desync checksums.
+//
+// Build it twice to compare the SIMD and the scalar implementation:
+//
+//     cc -O2 -Isrc bench/checksum.c -o checksum && ./checksum
+//     cc -O2 -Isrc -DFIREFLY_NO_SIMD bench/checksum.c -o checksum-scalar && ./checksum-scalar
+//
+// The frame cost is for 64 KB of state in 16 regions, 2 of which are written every frame,
+// as a share of a 60 FPS frame.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/firefly_checksum.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STATE_SIZE (64 * 1024)
+#define REGIONS 16
+#define FRAMES 20000
+
+static uint8_t state[STATE_SIZE];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+    for (size_t i = 0; i < STATE_SIZE; i++)
+    {
+        state[i] = (uint8_t)(i * 31 + (i >> 7));
+    }
+
+    size_t sizes[] = {64, 1024, 16 * 1024, STATE_SIZE};
+    for (int s = 0; s < 4; s++)
+    {
+        size_t rounds = (size_t)256 * 1024 * 1024 / sizes[s];
+        uint64_t check = 0;
+        double start = now();
+        for (size_t r = 0; r < rounds; r++)
+        {
+            check += hash_bytes(state, sizes[s], r);
+        }
+        double took = now() - start;
+        printf("hash %6zu bytes  %8.1f MB/s  (check %04x)\n",
+               sizes[s], (double)sizes[s] * rounds / took / 1e6, (unsigned)(check & 0xffff));
+    }
+
+    Checksum sum = new_checksum();
+    for (int i = 0; i < REGIONS; i++)
+    {
+        checksum_add_region(&sum, state + i * (STATE_SIZE / REGIONS), STATE_SIZE / REGIONS);
+    }
+    char packet[CHECKSUM_PACKET_SIZE];
+    Buffer buf = {sizeof(packet), packet};
+    uint32_t mismatches = 0;
+    double start = now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        state[f % 4096]++;
+        state[STATE_SIZE / 2 + f % 4096]++;
+        checksum_touch_ptr(&sum, &state[f % 4096]);
+        checksum_touch_ptr(&sum, &state[STATE_SIZE / 2 + f % 4096]);
+        checksum_update(&sum, f);
+        Stash s = checksum_pack(&sum, buf);
+        mismatches += checksum_verify(&sum, s).frame >= 0;
+    }
+    double frame = (now() - start) / FRAMES;
+    printf("frame %7.2f us  (%.3f%% of a 60 FPS frame, %llu bytes hashed per frame, %u mismatches)\n",
+           frame * 1e6, frame * 60 * 100, (unsigned long long)(sum.stats.bytes / sum.stats.frames), mismatches);
+    return 0;
+}
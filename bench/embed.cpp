@@ -0,0 +1,168 @@
+// Boot-time cost of images loaded from ROM files versus images embedded as constant data.
+//
+//     cc -O2 -DFIREFLY_NATIVE_NO_MAIN -c src/firefly_native.c -o firefly_native.o
+//     c++ -std=c++20 -O2 -Isrc bench/embed.cpp firefly_native.o -lm -o embed && ./embed
+//
+// The sprites are built with ff::make_image at compile time. The load_file path
+// reads the same art from a temporary ROM directory, encoded at runtime
+// in the plainest format (4 BPP, identity color swaps) without make_image.
+// Both paths must draw identical frames, which checks the encoder.
+
+#include "../src/firefly.c"
+#include "../src/firefly.hpp"
+#include "../src/firefly_native.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <time.h>
+
+#define FILES 32
+#define ROUNDS 200
+
+#define ART_HEART \
+    "........"    \
+    ".33..33."    \
+    "33333333"    \
+    "33333333"    \
+    ".333333."    \
+    "..3333.."    \
+    "...33..."    \
+    "........"
+
+static constexpr auto heart = ff::make_image<8, 8, 1>(ART_HEART);
+
+#define ART_COIN \
+    "..4444.."   \
+    ".455554."   \
+    "45544554"   \
+    "45545554"   \
+    "45545554"   \
+    "45544554"   \
+    ".455554."   \
+    "..4444.."
+
+static constexpr auto coin = ff::make_image<8, 8, 2>(ART_COIN);
+
+#define ART_SLIME \
+    "........"    \
+    "...66..."    \
+    "..6776.."    \
+    ".677776."    \
+    ".6f7f76."    \
+    "67777776"    \
+    "66666666"    \
+    "........"
+
+static constexpr auto slime = ff::make_image<8, 8>(ART_SLIME);
+
+#define ART_BRICK \
+    "2222d222"    \
+    "c22cdc22"    \
+    "dddddddd"    \
+    "22d2222d"    \
+    "c2dc22cd"    \
+    "dddddddd"    \
+    "2222d222"    \
+    "dddddddd"
+
+static constexpr auto brick = ff::make_image<8, 8>(ART_BRICK);
+
+static const Image sprites[] = {heart.image(), coin.image(), slime.image(), brick.image()};
+static const char *arts[] = {ART_HEART, ART_COIN, ART_SLIME, ART_BRICK};
+static char loaded[FILES * 64];
+static uint8_t expected[WIDTH * HEIGHT];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// The reference encoding: the palette index of every pixel as is,
+// and the first unused index for the transparent pixels.
+static size_t encode_plain(const char *art, uint8_t out[64])
+{
+    bool used[16] = {};
+    for (const char *c = art; *c; c++)
+    {
+        used[*c == '.' ? 0 : (*c <= '9' ? *c - '0' : *c - 'a' + 10)] |= *c != '.';
+    }
+    uint8_t clear = 0;
+    while (used[clear])
+    {
+        clear++;
+    }
+    uint8_t header[] = {0x21, 4, 8, 0, clear, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef};
+    memcpy(out, header, sizeof(header));
+    memset(out + sizeof(header), 0, 32);
+    for (int i = 0; art[i]; i++)
+    {
+        uint8_t v = art[i] == '.' ? clear : (art[i] <= '9' ? art[i] - '0' : art[i] - 'a' + 10);
+        out[sizeof(header) + i / 2] |= i % 2 == 0 ? v << 4 : v;
+    }
+    return sizeof(header) + 32;
+}
+
+static Point position(int i)
+{
+    return ff::point(8 + (i % 16) * 12, 8 + (i / 16) * 12);
+}
+
+int main()
+{
+    char root[] = "/tmp/ffbench-XXXXXX";
+    if (mkdtemp(root) == nullptr)
+    {
+        return 1;
+    }
+    char names[FILES][16];
+    for (int i = 0; i < FILES; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "sprite%02d", i);
+        char path[sizeof(root) + 24];
+        snprintf(path, sizeof(path), "%s/sprite%02d", root, i);
+        FILE *f = fopen(path, "wb");
+        uint8_t plain[64];
+        fwrite(plain, 1, encode_plain(arts[i % 4], plain), f);
+        fclose(f);
+    }
+    native_set_rom_dir(root);
+
+    double start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        clear_screen(WHITE);
+        char *next = loaded;
+        for (int i = 0; i < FILES; i++)
+        {
+            Buffer buf = {ff::get_file_size(names[i]), next};
+            Image img = ff::load_file(names[i], ff::span(buf));
+            next += img.size;
+            draw_image(img, position(i));
+        }
+    }
+    double files = (now() - start) / ROUNDS;
+    memcpy(expected, native_framebuffer(), sizeof(expected));
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        clear_screen(WHITE);
+        for (int i = 0; i < FILES; i++)
+        {
+            draw_image(sprites[i % 4], position(i));
+        }
+    }
+    double embedded = (now() - start) / ROUNDS;
+    bool same = memcmp(expected, native_framebuffer(), sizeof(expected)) == 0;
+
+    printf("%d images of %zu-%zu bytes%s\n", FILES, heart.image().size, slime.image().size, same ? "" : "  MISMATCH");
+    printf("load_file %10.1f us  (%d host file calls, %d bytes of buffers)\n", files * 1e6, FILES * 2, FILES * 45);
+    printf("embedded  %10.1f us  (no host file calls, no buffers)\n", embedded * 1e6);
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -r %s", root);
+    return system(cmd) != 0 || !same;
+}
@@ -0,0 +1,108 @@
+// Compression ratio and decompression throughput of the LZ4 decompressor.
+//
+//     cc -O2 -Isrc -DFIREFLY_NATIVE_NO_MAIN bench/lz.c src/firefly_native.c -lm -o lz && ./lz
+//
+// The inputs imitate typical assets: a tiled 4 BPP image, a text file, and random bytes.
+
+#define _POSIX_C_SOURCE 200809L
+#define FFLZ_NO_MAIN
+
+#include "../tools/fflz.c"
+#include "../src/firefly.c"
+#include "../src/firefly_alloc.c"
+#include "../src/firefly_lz.c"
+#include <time.h>
+
+#define INPUT_SIZE (WIDTH * HEIGHT / 2)
+#define ROUNDS 2000
+
+static uint8_t input[INPUT_SIZE];
+static uint8_t *packed;
+static uint8_t output[INPUT_SIZE];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name)
+{
+    size_t size = fflz_compress_file(input, INPUT_SIZE, packed);
+    File src = {size, (char *)packed};
+    Buffer dst = {INPUT_SIZE, (char *)output};
+
+    double start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        lz_decompress(src, dst);
+    }
+    double whole = now() - start;
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        LzStream s = new_lz_stream(src, dst);
+        while (!lz_stream_step(&s, 4096))
+        {
+        }
+    }
+    double streamed = now() - start;
+
+    bool ok = memcmp(input, output, INPUT_SIZE) == 0;
+    double bytes = (double)INPUT_SIZE * ROUNDS;
+    printf("%-8s %6zu -> %6zu bytes (%5.1f%%)  %8.1f MB/s  %8.1f MB/s streamed%s\n",
+           name, (size_t)INPUT_SIZE, size, 100.0 * size / INPUT_SIZE,
+           bytes / whole / 1e6, bytes / streamed / 1e6, ok ? "" : "  MISMATCH");
+}
+
+int main()
+{
+    packed = malloc(fflz_bound(INPUT_SIZE) + LZ_HEADER_SIZE);
+    // A map of 8x8 tiles picked from a small tileset.
+    uint32_t seed = 1;
+    uint8_t tiles[8][32];
+    for (int t = 0; t < 8; t++)
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            tiles[t][i] = (uint8_t)(seed >> 16);
+        }
+    }
+    for (int ty = 0; ty < HEIGHT / 8; ty++)
+    {
+        for (int tx = 0; tx < WIDTH / 8; tx++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int t = (seed >> 16) % 8;
+            for (int y = 0; y < 8; y++)
+            {
+                memcpy(input + (ty * 8 + y) * (WIDTH / 2) + tx * 4, tiles[t] + y * 4, 4);
+            }
+        }
+    }
+    run("tiles");
+
+    const char *words[] = {"the ", "player ", "jumps ", "over ", "a ", "lazy ", "slime ", "and ", "finds ", "gold\n"};
+    size_t pos = 0;
+    while (pos < INPUT_SIZE)
+    {
+        seed = seed * 1103515245 + 12345;
+        const char *w = words[(seed >> 16) % 10];
+        size_t len = strlen(w);
+        len = len > INPUT_SIZE - pos ? INPUT_SIZE - pos : len;
+        memcpy(input + pos, w, len);
+        pos += len;
+    }
+    run("text");
+
+    for (size_t i = 0; i < INPUT_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        input[i] = (uint8_t)(seed >> 16);
+    }
+    run("random");
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Per-frame cost of rollback snapshots and restores for typical state sizes.
+//
+//     cc -O2 -Isrc -DFIREFLY_NATIVE_NO_MAIN bench/rollback.c src/firefly_native.c -lm -o rollback && ./rollback
+//
+// Every frame, the step rewrites a block of "entities" at the start of the state
+// (about 1 KB) and a few scattered bytes, like a typical game: most of a big state
+// (tilemaps, inventories) stays the same from frame to frame.
+//
+// The second table runs rollback_advance with a remote peer whose inputs arrive
+// LATENCY frames late and change every few frames, so that predictions fail and
+// the state is rolled back and resimulated. The final state is checked against
+// a straight run with all inputs known.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/firefly.c"
+#include "../src/firefly_rollback.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SNAPSHOTS 8
+#define FRAMES 20000
+#define ENTITIES 1024
+#define LATENCY 3
+
+static uint8_t state[64 * 1024];
+static uint8_t expected[64 * 1024];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void step(void *ctx, const RollbackInput *inputs, Peers peers)
+{
+    size_t size = *(size_t *)ctx;
+    uint32_t *seed = (uint32_t *)state;
+    (void)peers;
+    for (size_t i = 4; i < ENTITIES && i < size; i++)
+    {
+        state[i] += (uint8_t)(i + inputs[0] + inputs[1]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        *seed = *seed * 1664525u + 1013904223u + inputs[1];
+        state[*seed % size] ^= 1;
+    }
+}
+
+static void run(size_t size, RollbackMode mode)
+{
+    Buffer storage = {rollback_storage_size(size, SNAPSHOTS), 0};
+    storage.head = malloc(storage.size);
+    Rollback rb;
+    new_rollback(&rb, state, size, SNAPSHOTS, mode, storage);
+    rollback_set_step(&rb, step, &size);
+    RollbackInput inputs[ROLLBACK_MAX_PEERS] = {0};
+    Peers peers = {1};
+
+    // The snapshot alone, excluding the step.
+    double saving = 0;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        double start = now();
+        rollback_save(&rb);
+        saving += now() - start;
+        step(&size, inputs, peers);
+        rb.frame++;
+    }
+
+    double start = now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        rollback_restore(&rb, rb.frame - 1 - f % (SNAPSHOTS - 1));
+        rb.frame = FRAMES;
+    }
+    double restoring = now() - start;
+
+    printf("%6zu bytes  %-6s  save %8.2f us  (%6.0f bytes copied)  restore %8.2f us\n",
+           size, mode == ROLLBACK_COPY ? "copy" : "pages",
+           saving / FRAMES * 1e6, (double)rb.stats.bytes_saved / FRAMES,
+           restoring / FRAMES * 1e6);
+    free(storage.head);
+}
+
+static RollbackInput remote_input(int32_t frame)
+{
+    return (RollbackInput)(frame / 5 % 3);
+}
+
+static bool run_mispredicted(size_t size, RollbackMode mode)
+{
+    RollbackInput inputs[ROLLBACK_MAX_PEERS] = {0};
+    Peers peers = {3};
+    memset(state, 0, size);
+    for (int f = 0; f < FRAMES; f++)
+    {
+        inputs[1] = remote_input(f);
+        step(&size, inputs, peers);
+    }
+    memcpy(expected, state, size);
+
+    Buffer storage = {rollback_storage_size(size, SNAPSHOTS), 0};
+    storage.head = malloc(storage.size);
+    Rollback rb;
+    new_rollback(&rb, state, size, SNAPSHOTS, mode, storage);
+    rollback_set_step(&rb, step, &size);
+    memset(state, 0, size);
+    double start = now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        rollback_set_peers(&rb, f, peers);
+        rollback_set_input(&rb, f, 0, 0);
+        if (f >= LATENCY)
+        {
+            rollback_set_input(&rb, f - LATENCY, 1, remote_input(f - LATENCY));
+        }
+        if (f == FRAMES - 1)
+        {
+            for (int late = f - LATENCY + 1; late <= f; late++)
+            {
+                rollback_set_input(&rb, late, 1, remote_input(late));
+            }
+        }
+        rollback_advance(&rb);
+    }
+    double took = now() - start;
+    bool ok = memcmp(state, expected, size) == 0;
+
+    printf("%6zu bytes  %-6s  advance %8.2f us  (%5.2f frames resimulated, %6.0f bytes copied)  %s\n",
+           size, mode == ROLLBACK_COPY ? "copy" : "pages",
+           took / FRAMES * 1e6, (double)rb.stats.resimulated / FRAMES,
+           (double)rb.stats.bytes_saved / FRAMES, ok ? "ok" : "WRONG STATE");
+    free(storage.head);
+    return ok;
+}
+
+int main()
+{
+    size_t sizes[] = {1024, 4096, 16 * 1024, 64 * 1024};
+    for (int i = 0; i < 4; i++)
+    {
+        run(sizes[i], ROLLBACK_COPY);
+        run(sizes[i], ROLLBACK_PAGES);
+    }
+    printf("\nremote input %d frames late:\n", LATENCY);
+    bool ok = true;
+    for (int i = 0; i < 4; i++)
+    {
+        ok &= run_mispredicted(sizes[i], ROLLBACK_COPY);
+        ok &= run_mispredicted(sizes[i], ROLLBACK_PAGES);
+    }
+    return ok ? 0 : 1;
+}
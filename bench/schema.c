@@ -0,0 +1,133 @@
+// Throughput of the schema codec compared to copying whole structs.
+//
+//     cc -O2 -Isrc bench/schema.c -o schema && ./schema
+//
+// The struct is a typical save: a level, a position, a few counters, flags,
+// and a small inventory. The codec packs it into less than half of its memory size.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/firefly_schema.c"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define RECORDS 1024
+#define ROUNDS 2000
+
+typedef struct
+{
+    uint8_t level;
+    float x, y;
+    float angle;
+    uint32_t coins;
+    int32_t balance;
+    bool sword;
+    bool shield;
+    int16_t hp;
+    uint8_t items[4];
+} Save;
+
+#define SAVE_FIELDS(F)                      \
+    F(level, 1, SCHEMA_INT(1, 99))          \
+    F(x, 1, SCHEMA_FLOAT(0, 240, 12))       \
+    F(y, 1, SCHEMA_FLOAT(0, 160, 12))       \
+    F(angle, 1, SCHEMA_FLOAT(0, 360, 8))    \
+    F(coins, 1, SCHEMA_VARINT())            \
+    F(balance, 1, SCHEMA_SVARINT())         \
+    F(sword, 1, SCHEMA_BOOL())              \
+    F(shield, 1, SCHEMA_BOOL())             \
+    F(items[0], 1, SCHEMA_UINT(5))          \
+    F(items[1], 1, SCHEMA_UINT(5))          \
+    F(items[2], 1, SCHEMA_UINT(5))          \
+    F(items[3], 1, SCHEMA_UINT(5))          \
+    F(hp, 2, SCHEMA_INT(-100, 100))
+
+SCHEMA_DEFINE(save, Save, 2, SAVE_FIELDS)
+
+static Save records[RECORDS];
+static Save decoded[RECORDS];
+static char packed[RECORDS * save_MAX_SIZE];
+static size_t offsets[RECORDS + 1];
+static char raw[RECORDS * sizeof(Save)];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+    uint32_t seed = 7;
+    for (int i = 0; i < RECORDS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        Save *s = &records[i];
+        memset(s, 0, sizeof(*s));
+        s->level = 1 + seed % 99;
+        s->x = (float)(seed % 2400) / 10;
+        s->y = (float)(seed % 1600) / 10;
+        s->angle = (float)(seed % 360);
+        s->coins = (seed >> 8) % (i % 8 == 0 ? 100000 : 300);
+        s->balance = (int32_t)(seed % 2001) - 1000;
+        s->sword = seed & 1;
+        s->shield = (seed >> 1) & 1;
+        s->hp = (int16_t)((seed >> 4) % 201) - 100;
+        for (int j = 0; j < 4; j++)
+        {
+            s->items[j] = (seed >> (j * 5)) & 31;
+        }
+    }
+
+    size_t total = 0;
+    double start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        total = 0;
+        for (int i = 0; i < RECORDS; i++)
+        {
+            offsets[i] = total;
+            total += save_encode(&records[i], (Buffer){save_MAX_SIZE, packed + total});
+        }
+        offsets[RECORDS] = total;
+    }
+    double encode = (now() - start) / ROUNDS / RECORDS;
+
+    uint32_t failed = 0;
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (int i = 0; i < RECORDS; i++)
+        {
+            Buffer b = {offsets[i + 1] - offsets[i], packed + offsets[i]};
+            failed += !save_decode(&decoded[i], b);
+        }
+    }
+    double decode = (now() - start) / ROUNDS / RECORDS;
+
+    uint32_t wrong = 0;
+    for (int i = 0; i < RECORDS; i++)
+    {
+        Save *a = &records[i], *b = &decoded[i];
+        wrong += a->level != b->level || a->coins != b->coins || a->balance != b->balance ||
+                 a->hp != b->hp || a->sword != b->sword || memcmp(a->items, b->items, 4) != 0 ||
+                 a->x - b->x > 0.1f || b->x - a->x > 0.1f || a->angle - b->angle > 1.5f || b->angle - a->angle > 1.5f;
+    }
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        memcpy(raw, records, sizeof(records));
+        memcpy(decoded, raw, sizeof(raw));
+    }
+    double copy = (now() - start) / ROUNDS / RECORDS;
+
+    printf("schema  %5.1f bytes/record  encode %6.1f ns  decode %6.1f ns  (%u failed, %u wrong)\n",
+           (double)total / RECORDS, encode * 1e9, decode * 1e9, failed, wrong);
+    printf("schema  encode %7.1f MB/s  decode %7.1f MB/s  of struct data\n",
+           sizeof(Save) / encode / 1e6, sizeof(Save) / decode / 1e6);
+    printf("memcpy  %5zu bytes/record  encode+decode %6.1f ns\n", sizeof(Save), copy * 1e9);
+    return failed != 0 || wrong != 0;
+}
@@ -1,17 +1,15 @@
 #include "../../src/firefly.c"
+#include "../../src/firefly_alloc.c"
 
+Arena arena;
 Image image;
 
 BOOT void boot()
 {
-    // We know the image size in advance.
-    // You can see it when running `firefly_cli build`.
-    // You could also use `get_file_size` to detect the file size
-    // in runtime but that requires using an allocator.
-    const size_t fileSize = 97;
-    char head[fileSize];
-    Buffer buf = {.head = head, .size = fileSize};
-    image = load_file("img", buf);
+    // The image must outlive boot, so it can't be loaded into a stack buffer.
+    // The arena allocates exactly as much memory as the file needs.
+    arena = new_arena(0);
+    image = arena_load_file(&arena, "img");
 }
 
 UPDATE void update()
@@ -1,6 +1,9 @@
 /// @file
 /// @brief The function definitions for Firefly Zero C SDK.
 
+/// @private
+#define _FF_FIREFLY_C
+
 #include "firefly.h"
 #include "firefly_bindings.h"
 #include <stdint.h>
@@ -8,42 +11,42 @@
 #include <string.h>
 
 /// @brief An angle in radians where τ(2π) is the full circle.
-Angle radians(float a)
+FIREFLY_API Angle radians(float a)
 {
     struct Angle r = {a};
     return r;
 };
 
 /// @brief An angle in degrees where 360.0 is the full circle.
-Angle degrees(float a)
+FIREFLY_API Angle degrees(float a)
 {
     struct Angle r = {a * (float)3.14159265358979323846 / (float)180.0};
     return r;
 };
 
 /// @brief Time in the number of samples.
-AudioTime samples(int32_t s)
+FIREFLY_API AudioTime samples(int32_t s)
 {
     struct AudioTime t = {s};
     return t;
 }
 
 /// @brief Time in seconds.
-AudioTime seconds(int32_t s)
+FIREFLY_API AudioTime seconds(int32_t s)
 {
     struct AudioTime t = {s * SAMPLE_RATE};
     return t;
 }
 
 /// @brief Time in miliseconds.
-AudioTime miliseconds(int32_t s)
+FIREFLY_API AudioTime miliseconds(int32_t s)
 {
     struct AudioTime t = {s * SAMPLE_RATE / 1000};
     return t;
 }
 
 /// @brief Convert Pad to DPad8.
-DPad8 pad_to_dpad8(Pad pad)
+FIREFLY_API DPad8 pad_to_dpad8(Pad pad)
 {
     DPad8 dpad = {
         .left = pad.x <= -400,
@@ -54,7 +57,7 @@ DPad8 pad_to_dpad8(Pad pad)
 }
 
 /// @brief Convert Pad to DPad4.
-DPad4 pad_to_dpad4(Pad self)
+FIREFLY_API DPad4 pad_to_dpad4(Pad self)
 {
     int x = self.x;
     int y = self.y;
@@ -89,117 +92,570 @@ DPad4 pad_to_dpad4(Pad self)
 
 // -- GRAPHICS -- //
 
+/// @private
+/// @brief The hook intercepting drawing operations, if any.
+#if defined(FIREFLY_HEADER_ONLY) && defined(__GNUC__)
+// Weak, so that all translation units including the header share one hook.
+__attribute__((weak)) DrawHook _ff_draw_hook = 0;
+#else
+static DrawHook _ff_draw_hook = 0;
+#endif
+
+/// @private
+/// @brief The hook as seen by the drawing functions.
+/// @details With FIREFLY_NO_DRAW_HOOKS defined, the drawing functions
+/// always call the host directly and the hook check is compiled out.
+/// Modules built on hooks (batches, camera, frame diffing) don't work then.
+#ifdef FIREFLY_NO_DRAW_HOOKS
+#define _FF_DRAW_HOOK ((DrawHook)0)
+#else
+#define _FF_DRAW_HOOK _ff_draw_hook
+#endif
+
 /// @brief Fill the whole frame with the given color.
-void clear_screen(Color c)
+FIREFLY_API void clear_screen(Color c)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_CLEAR_SCREEN, 0, 0, {c}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_clear_screen(c);
 }
 
 /// @brief Set a color value in the palette.
-void set_color(Color c, RGB v)
+FIREFLY_API void set_color(Color c, RGB v)
 {
     _ffb_set_color(c, v.r, v.g, v.b);
 }
 
 /// @brief Set a single point (1 pixel is scaling is 1) on the frame.
-void draw_point(Point p, Color c)
+FIREFLY_API void draw_point(Point p, Color c)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_POINT, 0, 0, {p.x, p.y, c}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_point(p.x, p.y, c);
 }
 
 /// @brief Draw a straight line from point a to point b.
-void draw_line(Point a, Point b, LineStyle s)
+FIREFLY_API void draw_line(Point a, Point b, LineStyle s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_LINE, 0, 0, {a.x, a.y, b.x, b.y, s.color, s.width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_line(a.x, a.y, b.x, b.y, s.color, s.width);
 }
 
 /// @brief Draw a rectangle filling the given bounding box.
-void draw_rect(Point p, Size b, Style s)
+FIREFLY_API void draw_rect(Point p, Size b, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_RECT, 0, 0, {p.x, p.y, b.width, b.height, s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_rect(p.x, p.y, b.width, b.height, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw a rectangle with rounded corners.
-void draw_rounded_rect(Point p, Size b, Size c, Style s)
+FIREFLY_API void draw_rounded_rect(Point p, Size b, Size c, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_ROUNDED_RECT, 0, 0, {p.x, p.y, b.width, b.height, c.width, c.height, s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_rounded_rect(p.x, p.y, b.width, b.height, c.width, c.height, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw a circle with the given diameter.
-void draw_circle(Point p, int32_t d, Style s)
+FIREFLY_API void draw_circle(Point p, int32_t d, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_CIRCLE, 0, 0, {p.x, p.y, d, s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_circle(p.x, p.y, d, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw an ellipse (oval).
-void draw_ellipse(Point p, Size b, Style s)
+FIREFLY_API void draw_ellipse(Point p, Size b, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_ELLIPSE, 0, 0, {p.x, p.y, b.width, b.height, s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_ellipse(p.x, p.y, b.width, b.height, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw a triangle.
-void draw_triangle(Point a, Point b, Point c, Style s)
+FIREFLY_API void draw_triangle(Point a, Point b, Point c, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_TRIANGLE, 0, 0, {a.x, a.y, b.x, b.y, c.x, c.y, s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_triangle(a.x, a.y, b.x, b.y, c.x, c.y, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw an arc.
-void draw_arc(Point p, int32_t d, Angle start, Angle sweep, Style s)
+FIREFLY_API void draw_arc(Point p, int32_t d, Angle start, Angle sweep, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_ARC, 0, 0, {p.x, p.y, d, draw_cmd_angle_bits(start.a), draw_cmd_angle_bits(sweep.a), s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_arc(p.x, p.y, d, start.a, sweep.a, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Draw a sector.
-void draw_sector(Point p, int32_t d, Angle start, Angle sweep, Style s)
+FIREFLY_API void draw_sector(Point p, int32_t d, Angle start, Angle sweep, Style s)
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_SECTOR, 0, 0, {p.x, p.y, d, draw_cmd_angle_bits(start.a), draw_cmd_angle_bits(sweep.a), s.fill_color, s.stroke_color, s.stroke_width}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_draw_sector(p.x, p.y, d, start.a, sweep.a, s.fill_color, s.stroke_color, s.stroke_width);
 }
 
 /// @brief Render a text message using the given font.
-void draw_text(char *t, Font f, Point p, Color c)
+FIREFLY_API void draw_text(char *t, Font f, Point p, Color c)
 {
-    size_t tLen = strlen(t);
-    _ffb_draw_text((int)t, tLen, (int)f.head, f.size, p.x, p.y, c);
+    draw_text_str(cstr(t), f, p, c);
+}
+
+/// @brief Render a text message of the known length using the given font.
+FIREFLY_API void draw_text_str(Str t, Font f, Point p, Color c)
+{
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_TEXT, (char *)t.ptr, f.head, {p.x, p.y, c, (int32_t)t.len, (int32_t)f.size}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
+    _ffb_draw_text((uintptr_t)t.ptr, t.len, (uintptr_t)f.head, f.size, p.x, p.y, c);
 }
 
 /// @brief Render a QR code for the given text.
-void draw_qr(char *t, Point p, Color black, Color white)
+FIREFLY_API void draw_qr(char *t, Point p, Color black, Color white)
+{
+    draw_qr_str(cstr(t), p, black, white);
+}
+
+/// @brief Render a QR code for the given text of the known length.
+FIREFLY_API void draw_qr_str(Str t, Point p, Color black, Color white)
 {
-    size_t tLen = strlen(t);
-    _ffb_draw_qr((int)t, tLen, p.x, p.y, black, white);
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_QR, (char *)t.ptr, 0, {p.x, p.y, black, white, (int32_t)t.len}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
+    _ffb_draw_qr((uintptr_t)t.ptr, t.len, p.x, p.y, black, white);
 }
 
 /// @brief Draw an image.
-void draw_image(Image i, Point p)
+FIREFLY_API void draw_image(Image i, Point p)
 {
-    _ffb_draw_image((int)i.head, i.size, p.x, p.y);
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_IMAGE, i.head, 0, {p.x, p.y, (int32_t)i.size}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
+    _ffb_draw_image((uintptr_t)i.head, i.size, p.x, p.y);
 }
 
 /// @brief Draw an image subregion.
-void draw_sub_image(SubImage s, Point p)
+FIREFLY_API void draw_sub_image(SubImage s, Point p)
 {
-    _ffb_draw_sub_image((int)s.image.head, s.image.size, p.x, p.y, s.point.x, s.point.y, s.size.width, s.size.height);
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_SUB_IMAGE, s.image.head, 0, {p.x, p.y, s.point.x, s.point.y, s.size.width, s.size.height, (int32_t)s.image.size}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
+    _ffb_draw_sub_image((uintptr_t)s.image.head, s.image.size, p.x, p.y, s.point.x, s.point.y, s.size.width, s.size.height);
 }
 
 /// @brief Set the target image for all subsequent drawing operations.
-void set_canvas(Canvas c)
+FIREFLY_API void set_canvas(Canvas c)
 {
-    _ffb_set_canvas((int)c.head, c.size);
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_SET_CANVAS, c.head, 0, {(int32_t)c.size}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
+    _ffb_set_canvas((uintptr_t)c.head, c.size);
 }
 
 /// @brief Make all subsequent drawing operations target the screen instead of a canvas.
 /// @details Cancels the effect of [set_canvas].
-void unset_canvas()
+FIREFLY_API void unset_canvas()
 {
+    if (_FF_DRAW_HOOK)
+    {
+        DrawCmd cmd = {DRAW_UNSET_CANVAS, 0, 0, {0}};
+        _FF_DRAW_HOOK(&cmd);
+        return;
+    }
     _ffb_unset_canvas();
 }
 
+/// @brief Get the width and height of an image.
+/// @details Returns zero size if the buffer is not a valid image.
+FIREFLY_API Size image_size(Image i)
+{
+    Size size = {0, 0};
+    uint8_t *raw = (uint8_t *)i.head;
+    if (i.size < 5 || raw[0] != 0x21)
+    {
+        return size;
+    }
+    int32_t bpp = raw[1];
+    if (bpp != 1 && bpp != 2 && bpp != 4)
+    {
+        return size;
+    }
+    size_t header = 5 + (1 << bpp) / 2;
+    int32_t width = raw[2] | (raw[3] << 8);
+    if (width == 0 || i.size < header)
+    {
+        return size;
+    }
+    size.width = width;
+    size.height = (int32_t)((i.size - header) * 8 / bpp / width);
+    return size;
+}
+
+// -- DRAW COMMANDS -- //
+
+/// @brief Intercept all drawing operations with the given function.
+///
+/// @details While a hook is installed, the drawing functions (draw_rect, clear_screen, etc)
+/// don't call the host but pass a DrawCmd into the hook instead.
+/// The hook can then modify, record, or skip the command
+/// and eventually execute it using exec_draw_cmd.
+///
+/// Returns the previously installed hook (or NULL) so that hooks can be chained.
+/// Pass NULL to remove the hook.
+FIREFLY_API DrawHook set_draw_hook(DrawHook hook)
+{
+    DrawHook prev = _ff_draw_hook;
+    _ff_draw_hook = hook;
+    return prev;
+}
+
+/// @brief Execute the drawing command the same way the drawing functions do.
+/// @details Passes the command into the installed hook if there is one,
+/// otherwise executes it on the host.
+FIREFLY_API void submit_draw_cmd(const DrawCmd *cmd)
+{
+    if (_FF_DRAW_HOOK)
+    {
+        _FF_DRAW_HOOK(cmd);
+        return;
+    }
+    exec_draw_cmd(cmd);
+}
+
+/// @brief Execute the drawing command on the host, bypassing the hook.
+FIREFLY_API void exec_draw_cmd(const DrawCmd *cmd)
+{
+    const int32_t *a = cmd->args;
+    switch (cmd->op)
+    {
+    case DRAW_CLEAR_SCREEN:
+        _ffb_clear_screen(a[0]);
+        break;
+    case DRAW_POINT:
+        _ffb_draw_point(a[0], a[1], a[2]);
+        break;
+    case DRAW_LINE:
+        _ffb_draw_line(a[0], a[1], a[2], a[3], a[4], a[5]);
+        break;
+    case DRAW_RECT:
+        _ffb_draw_rect(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+        break;
+    case DRAW_ROUNDED_RECT:
+        _ffb_draw_rounded_rect(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+        break;
+    case DRAW_CIRCLE:
+        _ffb_draw_circle(a[0], a[1], a[2], a[3], a[4], a[5]);
+        break;
+    case DRAW_ELLIPSE:
+        _ffb_draw_ellipse(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+        break;
+    case DRAW_TRIANGLE:
+        _ffb_draw_triangle(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+        break;
+    case DRAW_ARC:
+        _ffb_draw_arc(a[0], a[1], a[2], draw_cmd_angle(cmd, 3), draw_cmd_angle(cmd, 4), a[5], a[6], a[7]);
+        break;
+    case DRAW_SECTOR:
+        _ffb_draw_sector(a[0], a[1], a[2], draw_cmd_angle(cmd, 3), draw_cmd_angle(cmd, 4), a[5], a[6], a[7]);
+        break;
+    case DRAW_TEXT:
+        _ffb_draw_text((uintptr_t)cmd->ptr, a[3], (uintptr_t)cmd->ptr2, a[4], a[0], a[1], a[2]);
+        break;
+    case DRAW_QR:
+        _ffb_draw_qr((uintptr_t)cmd->ptr, a[4], a[0], a[1], a[2], a[3]);
+        break;
+    case DRAW_IMAGE:
+        _ffb_draw_image((uintptr_t)cmd->ptr, a[2], a[0], a[1]);
+        break;
+    case DRAW_SUB_IMAGE:
+        _ffb_draw_sub_image((uintptr_t)cmd->ptr, a[6], a[0], a[1], a[2], a[3], a[4], a[5]);
+        break;
+    case DRAW_SET_CANVAS:
+        _ffb_set_canvas((uintptr_t)cmd->ptr, a[0]);
+        break;
+    case DRAW_UNSET_CANVAS:
+        _ffb_unset_canvas();
+        break;
+    }
+}
+
+/// @brief Get the bounding box of all pixels the command may touch.
+///
+/// @details Returns false for commands that don't have bounds
+/// (clear_screen, set_canvas, unset_canvas) and for invalid images.
+/// Text bounds are estimated from the font glyph size.
+FIREFLY_API bool draw_cmd_bounds(const DrawCmd *cmd, Rect *r)
+{
+    const int32_t *a = cmd->args;
+    int32_t x0 = a[0];
+    int32_t y0 = a[1];
+    int32_t x1 = a[0];
+    int32_t y1 = a[1];
+    switch (cmd->op)
+    {
+    case DRAW_CLEAR_SCREEN:
+    case DRAW_SET_CANVAS:
+    case DRAW_UNSET_CANVAS:
+        return false;
+    case DRAW_POINT:
+        x1 += 1;
+        y1 += 1;
+        break;
+    case DRAW_LINE:
+    {
+        int32_t half = a[5] / 2 + 1;
+        x0 = (a[0] < a[2] ? a[0] : a[2]) - half;
+        y0 = (a[1] < a[3] ? a[1] : a[3]) - half;
+        x1 = (a[0] > a[2] ? a[0] : a[2]) + half + 1;
+        y1 = (a[1] > a[3] ? a[1] : a[3]) + half + 1;
+        break;
+    }
+    case DRAW_RECT:
+    case DRAW_ROUNDED_RECT:
+    case DRAW_ELLIPSE:
+        x1 += a[2];
+        y1 += a[3];
+        break;
+    case DRAW_CIRCLE:
+    case DRAW_ARC:
+    case DRAW_SECTOR:
+        x1 += a[2];
+        y1 += a[2];
+        break;
+    case DRAW_TRIANGLE:
+    {
+        int32_t half = a[8] / 2 + 1;
+        for (int i = 2; i < 6; i += 2)
+        {
+            x0 = a[i] < x0 ? a[i] : x0;
+            y0 = a[i + 1] < y0 ? a[i + 1] : y0;
+            x1 = a[i] > x1 ? a[i] : x1;
+            y1 = a[i + 1] > y1 ? a[i + 1] : y1;
+        }
+        x0 -= half;
+        y0 -= half;
+        x1 += half + 1;
+        y1 += half + 1;
+        break;
+    }
+    case DRAW_TEXT:
+    {
+        // Font header: magic, encoding, glyph width, glyph height, baseline.
+        uint8_t *font = (uint8_t *)cmd->ptr2;
+        if (a[4] < 5)
+        {
+            return false;
+        }
+        int32_t lines = 1;
+        int32_t cols = 0;
+        int32_t maxCols = 0;
+        for (int32_t i = 0; i < a[3]; i++)
+        {
+            if (cmd->ptr[i] == '\n')
+            {
+                lines++;
+                cols = 0;
+                continue;
+            }
+            cols++;
+            maxCols = cols > maxCols ? cols : maxCols;
+        }
+        y0 -= font[4];
+        x1 = x0 + maxCols * font[2];
+        y1 = y0 + lines * font[3];
+        break;
+    }
+    case DRAW_QR:
+        // The largest QR code fitting on the screen is version 40 (177 modules).
+        x1 += 177;
+        y1 += 177;
+        break;
+    case DRAW_IMAGE:
+    {
+        Image img = {(size_t)a[2], cmd->ptr};
+        Size size = image_size(img);
+        if (size.width == 0)
+        {
+            return false;
+        }
+        x1 += size.width;
+        y1 += size.height;
+        break;
+    }
+    case DRAW_SUB_IMAGE:
+        x1 += a[4];
+        y1 += a[5];
+        break;
+    }
+    r->point.x = x0;
+    r->point.y = y0;
+    r->size.width = x1 - x0;
+    r->size.height = y1 - y0;
+    return true;
+}
+
+/// @brief Get the angle (in radians) stored in the given argument of DRAW_ARC or DRAW_SECTOR.
+FIREFLY_API float draw_cmd_angle(const DrawCmd *cmd, int32_t i)
+{
+    float a;
+    memcpy(&a, &cmd->args[i], sizeof(a));
+    return a;
+}
+
+/// @brief Convert an angle (in radians) into a DrawCmd argument.
+FIREFLY_API int32_t draw_cmd_angle_bits(float a)
+{
+    int32_t bits;
+    memcpy(&bits, &a, sizeof(bits));
+    return bits;
+}
+
+/// @brief Check if two rectangles have at least one common pixel.
+FIREFLY_API bool rect_intersects(Rect a, Rect b)
+{
+    return a.point.x < b.point.x + b.size.width &&
+           b.point.x < a.point.x + a.size.width &&
+           a.point.y < b.point.y + b.size.height &&
+           b.point.y < a.point.y + a.size.height;
+}
+
+/// @brief Check if the inner rectangle is fully inside of the outer one.
+FIREFLY_API bool rect_contains(Rect outer, Rect inner)
+{
+    return inner.point.x >= outer.point.x &&
+           inner.point.y >= outer.point.y &&
+           inner.point.x + inner.size.width <= outer.point.x + outer.size.width &&
+           inner.point.y + inner.size.height <= outer.point.y + outer.size.height;
+}
+
 // -- INPUT -- //
 
+/// @private
+/// @brief The hook intercepting input and randomness, if any.
+#if defined(FIREFLY_HEADER_ONLY) && defined(__GNUC__)
+__attribute__((weak)) InputHook _ff_input_hook = 0;
+#else
+static InputHook _ff_input_hook = 0;
+#endif
+
+/// @private
+/// @brief The hook as seen by the input functions.
+/// @details With FIREFLY_NO_INPUT_HOOKS defined, the input functions
+/// always call the host directly. Input recording and replay don't work then.
+#ifdef FIREFLY_NO_INPUT_HOOKS
+#define _FF_INPUT_HOOK ((InputHook)0)
+#else
+#define _FF_INPUT_HOOK _ff_input_hook
+#endif
+
+/// @brief Set the hook intercepting input and randomness.
+///
+/// @details When set, read_pad, read_buttons, get_peers, set_seed,
+/// and get_random don't call the host but ask the hook for the raw value.
+/// The hook can record the values returned by exec_input or replay recorded ones.
+///
+/// Returns the previously installed hook (or NULL) so that hooks can be chained.
+/// Pass NULL to remove the hook.
+FIREFLY_API InputHook set_input_hook(InputHook hook)
+{
+    InputHook prev = _ff_input_hook;
+    _ff_input_hook = hook;
+    return prev;
+}
+
+/// @brief Get the raw input value the same way the input functions do.
+/// @details Asks the installed hook if there is one, otherwise the host.
+FIREFLY_API uintptr_t submit_input(InputOp op, uintptr_t arg)
+{
+    if (_FF_INPUT_HOOK)
+    {
+        return _FF_INPUT_HOOK(op, arg);
+    }
+    return exec_input(op, arg);
+}
+
+/// @brief Get the raw input value from the host, bypassing the hook.
+FIREFLY_API uintptr_t exec_input(InputOp op, uintptr_t arg)
+{
+    switch (op)
+    {
+    case INPUT_READ_PAD:
+        return (uint32_t)_ffb_read_pad((int32_t)arg);
+    case INPUT_READ_BUTTONS:
+        return (uint32_t)_ffb_read_buttons((int32_t)arg);
+    case INPUT_GET_PEERS:
+        return (uint32_t)_ffb_get_peers();
+    case INPUT_SET_SEED:
+        _ffb_set_seed(arg);
+        return 0;
+    case INPUT_GET_RANDOM:
+        return _ffb_get_random();
+    }
+    return 0;
+}
+
 /// @brief Read touchpad state: if it's pressed and where.
-Pad read_pad(Peer peer)
+FIREFLY_API Pad read_pad(Peer peer)
 {
-    int32_t raw = _ffb_read_pad(peer);
+    int32_t raw = _FF_INPUT_HOOK ? (int32_t)_FF_INPUT_HOOK(INPUT_READ_PAD, peer) : _ffb_read_pad(peer);
     Pad pad;
     if (raw == 0xffff)
     {
@@ -217,9 +673,9 @@ Pad read_pad(Peer peer)
 }
 
 /// @brief Get pressed buttons.
-Buttons read_buttons(Peer peer)
+FIREFLY_API Buttons read_buttons(Peer peer)
 {
-    int32_t raw = _ffb_read_buttons(peer);
+    int32_t raw = _FF_INPUT_HOOK ? (int32_t)_FF_INPUT_HOOK(INPUT_READ_BUTTONS, peer) : _ffb_read_buttons(peer);
     Buttons buttons = {
         .s = (raw & 0b1) != 0,
         .e = (raw & 0b10) != 0,
@@ -234,19 +690,29 @@ Buttons read_buttons(Peer peer)
 /// @brief Get size (in bytes) of the given file.
 /// @details Useful for dynamically allocating Buffer
 /// of the right size for [load_file].
-size_t get_file_size(char *path)
+FIREFLY_API size_t get_file_size(char *path)
 {
-    size_t pathLen = strlen(path);
-    return _ffb_get_file_size((int)path, pathLen);
+    return get_file_size_str(cstr(path));
+}
+
+/// @brief Get size (in bytes) of the file at the path of the known length.
+FIREFLY_API size_t get_file_size_str(Str path)
+{
+    return _ffb_get_file_size((uintptr_t)path.ptr, path.len);
 }
 
 /// @brief Read file from the given path into the given buffer.
 /// @details The resulting File uses the same memory as the given
 /// Buffer but has its size adjusted to the file size.
-File load_file(char *path, Buffer buf)
+FIREFLY_API File load_file(char *path, Buffer buf)
 {
-    size_t pathLen = strlen(path);
-    int32_t size = _ffb_load_file((int)path, pathLen, (int)buf.head, buf.size);
+    return load_file_str(cstr(path), buf);
+}
+
+/// @brief Read file from the path of the known length into the given buffer.
+FIREFLY_API File load_file_str(Str path, Buffer buf)
+{
+    int32_t size = _ffb_load_file((uintptr_t)path.ptr, path.len, (uintptr_t)buf.head, buf.size);
     File file;
     if (buf.size < size)
     {
@@ -260,40 +726,50 @@ File load_file(char *path, Buffer buf)
 /// @brief Write the given content into the given path.
 /// @details The created file can be loaded using [LoadFile]
 /// but only in a singleplayer game.
-void dump_file(char *path, File f)
+FIREFLY_API void dump_file(char *path, File f)
+{
+    dump_file_str(cstr(path), f);
+}
+
+/// @brief Write the given content into the path of the known length.
+FIREFLY_API void dump_file_str(Str path, File f)
 {
-    size_t pathLen = strlen(path);
-    _ffb_dump_file((int)path, pathLen, (int)f.head, f.size);
+    _ffb_dump_file((uintptr_t)path.ptr, path.len, (uintptr_t)f.head, f.size);
 }
 
 /// @brief Delete a file created using dump_file().
 /// @details Files in ROM cannot be deleted.
-void remove_file(char *path)
+FIREFLY_API void remove_file(char *path)
 {
-    size_t pathLen = strlen(path);
-    _ffb_remove_file((int)path, pathLen);
+    remove_file_str(cstr(path));
+}
+
+/// @brief Delete a file at the path of the known length.
+FIREFLY_API void remove_file_str(Str path)
+{
+    _ffb_remove_file((uintptr_t)path.ptr, path.len);
 }
 
 // -- NET -- //
 
 /// @brief Get the Peer corresponding to the current device.
-Peer get_me()
+FIREFLY_API Peer get_me()
 {
     return _ffb_get_me();
 }
 
 /// @brief Get a mapping of peers currently online.
-Peers get_peers()
+FIREFLY_API Peers get_peers()
 {
     Peers peers;
-    peers.online = _ffb_get_peers();
+    peers.online = _FF_INPUT_HOOK ? (uint32_t)_FF_INPUT_HOOK(INPUT_GET_PEERS, 0) : (uint32_t)_ffb_get_peers();
     return peers;
 }
 
 /// @brief Check if the given Peer is online.
 /// @details Accepts the bitmap of Peers returned by get_peers().
 /// The Peer can be obtained by a for loop from 0 to 31.
-bool is_online(Peers peers, Peer peer)
+FIREFLY_API bool is_online(Peers peers, Peer peer)
 {
     return ((peers.online >> peer) & 1) != 0;
 }
@@ -305,9 +781,9 @@ bool is_online(Peers peers, Peer peer)
 /// On exit, the runtime will persist the stash in FS.
 /// Next time the app starts, calling load_stash() will restore the stash
 /// saved earlier.
-void save_stash(Peer p, Stash s)
+FIREFLY_API void save_stash(Peer p, Stash s)
 {
-    _ffb_save_stash(p, (int)s.head, s.size);
+    _ffb_save_stash(p, (uintptr_t)s.head, s.size);
 }
 
 /// @brief Load Stash saved earlier (in this or previous run) by save_stash.
@@ -318,10 +794,10 @@ void save_stash(Peer p, Stash s)
 ///
 /// If the given buffer is nil, a new buffer will be allocated
 /// big enough to fit the biggest allowed stash. At the moment, it is 80 bytes.
-Stash load_stash(Peer p, Buffer s)
+FIREFLY_API Stash load_stash(Peer p, Buffer s)
 {
     Stash res;
-    res.size = _ffb_load_stash(p, (int)s.head, s.size);
+    res.size = _ffb_load_stash(p, (uintptr_t)s.head, s.size);
     res.head = s.head;
     return res;
 }
@@ -329,49 +805,77 @@ Stash load_stash(Peer p, Buffer s)
 // -- MISC -- //
 
 /// @brief Write a debug message.
-void log_debug(char *msg)
+FIREFLY_API void log_debug(char *msg)
 {
-    size_t msgLen = strlen(msg);
-    _ffb_log_debug((int)msg, msgLen);
+    log_debug_str(cstr(msg));
+}
+
+/// @brief Write a debug message of the known length.
+FIREFLY_API void log_debug_str(Str msg)
+{
+    _ffb_log_debug((uintptr_t)msg.ptr, msg.len);
 }
 
 /// @brief Write an error message.
-void log_error(char *msg)
+FIREFLY_API void log_error(char *msg)
+{
+    log_error_str(cstr(msg));
+}
+
+/// @brief Write an error message of the known length.
+FIREFLY_API void log_error_str(Str msg)
+{
+    _ffb_log_error((uintptr_t)msg.ptr, msg.len);
+}
+
+/// @brief Make a Str from a null-terminated string.
+FIREFLY_API Str cstr(const char *s)
 {
-    size_t msgLen = strlen(msg);
-    _ffb_log_error((int)msg, msgLen);
+    Str res;
+    res.ptr = s;
+    res.len = strlen(s);
+    return res;
 }
 
 /// @brief Set the random seed. Useful for testing.
-void set_seed(uintptr_t seed)
+FIREFLY_API void set_seed(uintptr_t seed)
 {
+    if (_FF_INPUT_HOOK)
+    {
+        _FF_INPUT_HOOK(INPUT_SET_SEED, seed);
+        return;
+    }
     _ffb_set_seed(seed);
 }
 
 /// @brief Get a random integer.
-uintptr_t get_random()
+FIREFLY_API uintptr_t get_random()
 {
+    if (_FF_INPUT_HOOK)
+    {
+        return _FF_INPUT_HOOK(INPUT_GET_RANDOM, 0);
+    }
     return _ffb_get_random();
 }
 
 /// @brief Write device name into the given Buffer.
 /// @details The buffer size must be at least 16 bytes.
-Buffer get_name(Peer p, Buffer buf)
+FIREFLY_API Buffer get_name(Peer p, Buffer buf)
 {
-    int32_t size = _ffb_get_name(p, (int)buf.head, buf.size);
+    int32_t size = _ffb_get_name(p, (uintptr_t)buf.head, buf.size);
     File name = {
         .size = size,
         .head = buf.head};
     return name;
 }
 
-Color _parseColor(uint32_t c)
+FIREFLY_API Color _parseColor(uint32_t c)
 {
-    return (Color)(c & 0xf + 1);
+    return (Color)((c & 0xf) + 1);
 }
 
 /// @brief Get system settings.
-Settings get_settings(Peer p)
+FIREFLY_API Settings get_settings(Peer p)
 {
     int64_t raw = _ffb_get_settings(p);
     Language language = (Language)(uint16_t)raw;
@@ -396,13 +900,13 @@ Settings get_settings(Peer p)
 }
 
 /// @brief Ask the runtime to restart the app after the current update iteration.
-void restart()
+FIREFLY_API void restart()
 {
     _ffb_restart();
 }
 
 /// @brief Ask the runtime to exit the app after the current update iteration.
-void quit()
+FIREFLY_API void quit()
 {
     _ffb_quit();
 }
@@ -416,7 +920,7 @@ void quit()
 ///
 /// If the Peer is COMBINED, the progress is added to every peer
 /// and the returned value is the lowest progress.
-Progress add_progress(Peer p, Badge b, int16_t v)
+FIREFLY_API Progress add_progress(Peer p, Badge b, int16_t v)
 {
     uint32_t r = _ffb_add_progress(p, b, v);
     Progress progress = {
@@ -426,7 +930,7 @@ Progress add_progress(Peer p, Badge b, int16_t v)
 }
 
 /// @brief Get the progress of earning the badge.
-Progress get_progress(Peer p, Badge b)
+FIREFLY_API Progress get_progress(Peer p, Badge b)
 {
     return add_progress(p, b, 0);
 }
@@ -438,13 +942,13 @@ Progress get_progress(Peer p, Badge b)
 ///
 /// If the Peer is COMBINED, the score is added for every peer
 /// and the returned value is the lowest of their best scores.
-Score add_score(Peer p, Board b, Score v)
+FIREFLY_API Score add_score(Peer p, Board b, Score v)
 {
     return _ffb_add_score(p, b, v);
 }
 
 /// @brief Get the personal best of the player.
-Score get_score(Peer p, Board b)
+FIREFLY_API Score get_score(Peer p, Board b)
 {
     return add_score(p, b, 0);
 }
@@ -452,7 +956,7 @@ Score get_score(Peer p, Board b)
 // -- AUDIO -- //
 
 /// @brief Add sine AudioNode as a child node for the given node.
-AudioNode add_sine(AudioNode parent, float freq, float phase)
+FIREFLY_API AudioNode add_sine(AudioNode parent, float freq, float phase)
 {
     AudioNode node;
     node.id = _ffba_add_sine(parent.id, freq, phase);
@@ -460,7 +964,7 @@ AudioNode add_sine(AudioNode parent, float freq, float phase)
 }
 
 /// @brief Add square AudioNode as a child node for the given node.
-AudioNode add_square(AudioNode parent, float freq, float phase)
+FIREFLY_API AudioNode add_square(AudioNode parent, float freq, float phase)
 {
     AudioNode node;
     node.id = _ffba_add_square(parent.id, freq, phase);
@@ -468,7 +972,7 @@ AudioNode add_square(AudioNode parent, float freq, float phase)
 }
 
 /// @brief Add sawtooth AudioNode as a child node for the given node.
-AudioNode add_sawtooth(AudioNode parent, float freq, float phase)
+FIREFLY_API AudioNode add_sawtooth(AudioNode parent, float freq, float phase)
 {
     AudioNode node;
     node.id = _ffba_add_sawtooth(parent.id, freq, phase);
@@ -476,7 +980,7 @@ AudioNode add_sawtooth(AudioNode parent, float freq, float phase)
 }
 
 /// @brief Add triangle AudioNode as a child node for the given node.
-AudioNode add_triangle(AudioNode parent, float freq, float phase)
+FIREFLY_API AudioNode add_triangle(AudioNode parent, float freq, float phase)
 {
     AudioNode node;
     node.id = _ffba_add_triangle(parent.id, freq, phase);
@@ -484,7 +988,7 @@ AudioNode add_triangle(AudioNode parent, float freq, float phase)
 }
 
 /// @brief Add noise AudioNode as a child node for the given node.
-AudioNode add_noise(AudioNode parent, int32_t seed)
+FIREFLY_API AudioNode add_noise(AudioNode parent, int32_t seed)
 {
     AudioNode node;
     node.id = _ffba_add_noise(parent.id, seed);
@@ -492,7 +996,7 @@ AudioNode add_noise(AudioNode parent, int32_t seed)
 }
 
 /// @brief Add empty AudioNode as a child node for the given node.
-AudioNode add_empty(AudioNode parent)
+FIREFLY_API AudioNode add_empty(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_empty(parent.id);
@@ -500,7 +1004,7 @@ AudioNode add_empty(AudioNode parent)
 }
 
 /// @brief Add zero AudioNode as a child node for the given node.
-AudioNode add_zero(AudioNode parent)
+FIREFLY_API AudioNode add_zero(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_zero(parent.id);
@@ -508,16 +1012,21 @@ AudioNode add_zero(AudioNode parent)
 }
 
 /// @brief Add file AudioNode as a child node for the given node.
-AudioNode add_file(AudioNode parent, char *path)
+FIREFLY_API AudioNode add_file(AudioNode parent, char *path)
+{
+    return add_file_str(parent, cstr(path));
+}
+
+/// @brief Add file AudioNode for the path of the known length as a child node for the given node.
+FIREFLY_API AudioNode add_file_str(AudioNode parent, Str path)
 {
-    size_t pathLen = strlen(path);
     AudioNode node;
-    node.id = _ffba_add_file(parent.id, (int)path, pathLen);
+    node.id = _ffba_add_file(parent.id, (uintptr_t)path.ptr, path.len);
     return node;
 }
 
 /// @brief Add mix AudioNode as a child node for the given node.
-AudioNode add_mix(AudioNode parent)
+FIREFLY_API AudioNode add_mix(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_mix(parent.id);
@@ -525,7 +1034,7 @@ AudioNode add_mix(AudioNode parent)
 }
 
 /// @brief Add allforone AudioNode as a child node for the given node.
-AudioNode add_all_for_one(AudioNode parent)
+FIREFLY_API AudioNode add_all_for_one(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_all_for_one(parent.id);
@@ -533,7 +1042,7 @@ AudioNode add_all_for_one(AudioNode parent)
 }
 
 /// @brief Add gain AudioNode as a child node for the given node.
-AudioNode add_gain(AudioNode parent, float lvl)
+FIREFLY_API AudioNode add_gain(AudioNode parent, float lvl)
 {
     AudioNode node;
     node.id = _ffba_add_gain(parent.id, lvl);
@@ -541,7 +1050,7 @@ AudioNode add_gain(AudioNode parent, float lvl)
 }
 
 /// @brief Add loop AudioNode as a child node for the given node.
-AudioNode add_loop(AudioNode parent)
+FIREFLY_API AudioNode add_loop(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_loop(parent.id);
@@ -549,7 +1058,7 @@ AudioNode add_loop(AudioNode parent)
 }
 
 /// @brief Add concat AudioNode as a child node for the given node.
-AudioNode add_concat(AudioNode parent)
+FIREFLY_API AudioNode add_concat(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_concat(parent.id);
@@ -557,7 +1066,7 @@ AudioNode add_concat(AudioNode parent)
 }
 
 /// @brief Add pan AudioNode as a child node for the given node.
-AudioNode add_pan(AudioNode parent, float lvl)
+FIREFLY_API AudioNode add_pan(AudioNode parent, float lvl)
 {
     AudioNode node;
     node.id = _ffba_add_pan(parent.id, lvl);
@@ -565,7 +1074,7 @@ AudioNode add_pan(AudioNode parent, float lvl)
 }
 
 /// @brief Add mute AudioNode as a child node for the given node.
-AudioNode add_mute(AudioNode parent)
+FIREFLY_API AudioNode add_mute(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_mute(parent.id);
@@ -573,7 +1082,7 @@ AudioNode add_mute(AudioNode parent)
 }
 
 /// @brief Add pause AudioNode as a child node for the given node.
-AudioNode add_pause(AudioNode parent)
+FIREFLY_API AudioNode add_pause(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_pause(parent.id);
@@ -581,7 +1090,7 @@ AudioNode add_pause(AudioNode parent)
 }
 
 /// @brief Add trackposition AudioNode as a child node for the given node.
-AudioNode add_track_position(AudioNode parent)
+FIREFLY_API AudioNode add_track_position(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_track_position(parent.id);
@@ -589,7 +1098,7 @@ AudioNode add_track_position(AudioNode parent)
 }
 
 /// @brief Add lowpass AudioNode as a child node for the given node.
-AudioNode add_low_pass(AudioNode parent, float freq, float q)
+FIREFLY_API AudioNode add_low_pass(AudioNode parent, float freq, float q)
 {
     AudioNode node;
     node.id = _ffba_add_low_pass(parent.id, freq, q);
@@ -597,7 +1106,7 @@ AudioNode add_low_pass(AudioNode parent, float freq, float q)
 }
 
 /// @brief Add highpass AudioNode as a child node for the given node.
-AudioNode add_high_pass(AudioNode parent, float freq, float q)
+FIREFLY_API AudioNode add_high_pass(AudioNode parent, float freq, float q)
 {
     AudioNode node;
     node.id = _ffba_add_high_pass(parent.id, freq, q);
@@ -605,7 +1114,7 @@ AudioNode add_high_pass(AudioNode parent, float freq, float q)
 }
 
 /// @brief Add takeleft AudioNode as a child node for the given node.
-AudioNode add_take_left(AudioNode parent)
+FIREFLY_API AudioNode add_take_left(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_take_left(parent.id);
@@ -613,7 +1122,7 @@ AudioNode add_take_left(AudioNode parent)
 }
 
 /// @brief Add takeright AudioNode as a child node for the given node.
-AudioNode add_take_right(AudioNode parent)
+FIREFLY_API AudioNode add_take_right(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_take_right(parent.id);
@@ -621,7 +1130,7 @@ AudioNode add_take_right(AudioNode parent)
 }
 
 /// @brief Add swap AudioNode as a child node for the given node.
-AudioNode add_swap(AudioNode parent)
+FIREFLY_API AudioNode add_swap(AudioNode parent)
 {
     AudioNode node;
     node.id = _ffba_add_swap(parent.id);
@@ -629,7 +1138,7 @@ AudioNode add_swap(AudioNode parent)
 }
 
 /// @brief Add clip AudioNode as a child node for the given node.
-AudioNode add_clip(AudioNode parent, float low, float high)
+FIREFLY_API AudioNode add_clip(AudioNode parent, float low, float high)
 {
     AudioNode node;
     node.id = _ffba_add_clip(parent.id, low, high);
@@ -637,37 +1146,37 @@ AudioNode add_clip(AudioNode parent, float low, float high)
 }
 
 /// @brief Reset the state of the given AudioNode.
-void audio_reset(AudioNode node)
+FIREFLY_API void audio_reset(AudioNode node)
 {
     _ffba_reset(node.id);
 }
 
 /// @brief Reset the state of the given AudioNode and all its child nodes.
-void audio_reset_all(AudioNode node)
+FIREFLY_API void audio_reset_all(AudioNode node)
 {
     _ffba_reset_all(node.id);
 }
 
 /// @brief Remove all child nodes from the given AudioNode.
-void audio_clear(AudioNode node)
+FIREFLY_API void audio_clear(AudioNode node)
 {
     _ffba_clear(node.id);
 }
 
 /// @brief Modulate an audio node's parameter using a LinearModulator.
-void mod_linear(AudioNode node, ModParam param, LinearModulator mod)
+FIREFLY_API void mod_linear(AudioNode node, ModParam param, LinearModulator mod)
 {
     _ffba_mod_linear(node.id, param, mod.start, mod.end, mod.start_at.samples, mod.end_at.samples);
 }
 
 /// @brief Modulate an audio node's parameter using a HoldModulator.
-void mod_hold(AudioNode node, ModParam param, HoldModulator mod)
+FIREFLY_API void mod_hold(AudioNode node, ModParam param, HoldModulator mod)
 {
     _ffba_mod_hold(node.id, param, mod.before, mod.after, mod.time.samples);
 }
 
 /// @brief Modulate an audio node's parameter using a SineModulator.
-void mod_sine(AudioNode node, ModParam param, SineModulator mod)
+FIREFLY_API void mod_sine(AudioNode node, ModParam param, SineModulator mod)
 {
     _ffba_mod_sine(node.id, param, mod.freq, mod.low, mod.high);
 }
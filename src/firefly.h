@@ -5,22 +5,33 @@
 
 #include "firefly_bindings.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef FIREFLY_HEADER_ONLY
+/// @brief Marks the SDK functions.
+/// @details Define FIREFLY_HEADER_ONLY before including firefly.h to get
+/// all functions as static inline and not build firefly.c separately.
+/// Each wrapper then compiles down to the host import call.
+#define FIREFLY_API static inline
+#else
+#define FIREFLY_API
+#endif
+
 /// @brief Mark a "boot" callback function.
-#define BOOT __attribute__((export_name("boot")))
+#define BOOT WASM_EXPORT("boot")
 
 /// @brief Mark an "update" callback function.
-#define UPDATE __attribute__((export_name("update")))
+#define UPDATE WASM_EXPORT("update")
 
 /// @brief Mark an "render" callback function.
-#define RENDER __attribute__((export_name("render")))
+#define RENDER WASM_EXPORT("render")
 
 /// @brief Mark a "cheat" callback function.
-#define CHEAT __attribute__((export_name("cheat")))
+#define CHEAT WASM_EXPORT("cheat")
 
 /// @brief Mark a "before_exit" callback function.
-#define BEFORE_EXIT __attribute__((export_name("BEFORE_EXIT")))
+#define BEFORE_EXIT WASM_EXPORT("before_exit")
 
 /// @brief Screen width.
 #define WIDTH 240
@@ -158,6 +169,24 @@ typedef struct Buffer Canvas;
 typedef struct Buffer Stash;
 typedef struct Buffer Font;
 
+/// @brief A string with a known length. It doesn't have to be null-terminated.
+struct Str
+{
+    /// @brief The pointer to the first character.
+    const char *ptr;
+    /// @brief The string length, in bytes.
+    size_t len;
+};
+typedef struct Str Str;
+
+/// @brief Make a Str from a string literal. The length is known at compile time.
+/// @details Doesn't compile for anything but a literal, use cstr() for other strings.
+#ifdef __cplusplus
+#define STR(s) (Str{"" s, sizeof(s) - 1})
+#else
+#define STR(s) ((Str){"" s, sizeof(s) - 1})
+#endif
+
 /// @brief A subregion of an Image.
 struct SubImage
 {
@@ -170,6 +199,77 @@ struct SubImage
 };
 typedef struct SubImage SubImage;
 
+// -- DRAW COMMANDS -- //
+
+/// @brief An axis-aligned rectangle on the screen or a canvas.
+struct Rect
+{
+    /// @brief The upper-left corner.
+    Point point;
+    /// @brief The width and height.
+    Size size;
+};
+typedef struct Rect Rect;
+
+/// @brief The kind of a drawing operation described by DrawCmd.
+enum DrawOp
+{
+    DRAW_CLEAR_SCREEN,
+    DRAW_POINT,
+    DRAW_LINE,
+    DRAW_RECT,
+    DRAW_ROUNDED_RECT,
+    DRAW_CIRCLE,
+    DRAW_ELLIPSE,
+    DRAW_TRIANGLE,
+    DRAW_ARC,
+    DRAW_SECTOR,
+    DRAW_TEXT,
+    DRAW_QR,
+    DRAW_IMAGE,
+    DRAW_SUB_IMAGE,
+    DRAW_SET_CANVAS,
+    DRAW_UNSET_CANVAS,
+};
+typedef enum DrawOp DrawOp;
+
+/// @brief A single drawing operation, as passed to a DrawHook.
+///
+/// @details The arguments are the same as the host function expects
+/// but the coordinates of the first point always go first:
+///
+/// * DRAW_CLEAR_SCREEN: color.
+/// * DRAW_POINT: x, y, color.
+/// * DRAW_LINE: x1, y1, x2, y2, color, width.
+/// * DRAW_RECT, DRAW_ELLIPSE: x, y, width, height, fill, stroke, stroke width.
+/// * DRAW_ROUNDED_RECT: x, y, width, height, corner width, corner height, fill, stroke, stroke width.
+/// * DRAW_CIRCLE: x, y, diameter, fill, stroke, stroke width.
+/// * DRAW_TRIANGLE: x1, y1, x2, y2, x3, y3, fill, stroke, stroke width.
+/// * DRAW_ARC, DRAW_SECTOR: x, y, diameter, start, sweep, fill, stroke, stroke width.
+///   The angles are float bits, see draw_cmd_angle.
+/// * DRAW_TEXT: x, y, color, text length, font size. `ptr` is text, `ptr2` is font.
+/// * DRAW_QR: x, y, black, white, text length. `ptr` is text.
+/// * DRAW_IMAGE: x, y, image size. `ptr` is image.
+/// * DRAW_SUB_IMAGE: x, y, sub x, sub y, sub width, sub height, image size. `ptr` is image.
+/// * DRAW_SET_CANVAS: canvas size. `ptr` is canvas.
+/// * DRAW_UNSET_CANVAS: nothing.
+struct DrawCmd
+{
+    /// @brief The operation.
+    DrawOp op;
+    /// @brief The main buffer used by the operation (text, image, or canvas).
+    char *ptr;
+    /// @brief The font used by DRAW_TEXT.
+    char *ptr2;
+    /// @brief The integer arguments.
+    int32_t args[9];
+};
+typedef struct DrawCmd DrawCmd;
+
+/// @brief A function intercepting all drawing operations.
+/// @details Installed by set_draw_hook.
+typedef void (*DrawHook)(const DrawCmd *cmd);
+
 // -- INPUT -- //
 
 /// @brief Get if the touchpad is pressed, and if so, where.
@@ -247,6 +347,27 @@ struct Buttons
 };
 typedef struct Buttons Buttons;
 
+/// @brief A host call reading input or randomness, passed into the InputHook.
+enum InputOp
+{
+    /// @brief read_pad. The argument is the peer, the result is the raw pad.
+    INPUT_READ_PAD = 0,
+    /// @brief read_buttons. The argument is the peer, the result is the button bits.
+    INPUT_READ_BUTTONS = 1,
+    /// @brief get_peers. The result is the bitmap of online peers.
+    INPUT_GET_PEERS = 2,
+    /// @brief set_seed. The argument is the seed, the result is ignored.
+    INPUT_SET_SEED = 3,
+    /// @brief get_random. The result is the random number.
+    INPUT_GET_RANDOM = 4,
+};
+typedef enum InputOp InputOp;
+
+/// @brief A function intercepting all input and randomness host calls.
+/// @details Installed by set_input_hook. Returns the raw value
+/// the host would return, typically by calling exec_input.
+typedef uintptr_t (*InputHook)(InputOp op, uintptr_t arg);
+
 // -- NET -- //
 
 /// @brief The bitmap of peers currently online.
@@ -261,7 +382,7 @@ typedef struct Peers Peers;
 typedef int32_t Peer;
 
 /// @brief A peer ID representing all peers at once.
-const Peer COMBINED = 0xFF;
+static const Peer COMBINED = 0xFF;
 
 // -- STATS -- //
 
@@ -370,7 +491,7 @@ struct AudioNode
 typedef struct AudioNode AudioNode;
 
 /// @brief The root audio node. Its child nodes are mixed and played on the device output.
-const AudioNode OUT = {.id = 0};
+static const AudioNode OUT = {0};
 
 /// @brief A parameter of an audio node that can be modulated.
 enum ModParam
@@ -460,88 +581,117 @@ typedef struct SineModulator SineModulator;
 
 // -- FUNCTIONS -- //
 
-Angle radians(float a);
-Angle degrees(float a);
-AudioTime samples(int32_t s);
-AudioTime seconds(int32_t s);
-AudioTime miliseconds(int32_t s);
-DPad8 pad_to_dpad8(Pad pad);
-DPad4 pad_to_dpad4(Pad pad);
-
-void clear_screen(Color c);
-void set_color(Color c, RGB v);
-void draw_point(Point p, Color c);
-void draw_line(Point a, Point b, LineStyle s);
-void draw_rect(Point p, Size b, Style s);
-void draw_rounded_rect(Point p, Size b, Size c, Style s);
-void draw_circle(Point p, int32_t d, Style s);
-void draw_ellipse(Point p, Size b, Style s);
-void draw_triangle(Point a, Point b, Point c, Style s);
-void draw_text(char *t, Font f, Point p, Color c);
-void draw_qr(char *t, Point p, Color black, Color white);
-void draw_arc(Point p, int32_t d, Angle start, Angle sweep, Style s);
-void draw_sector(Point p, int32_t d, Angle start, Angle sweep, Style s);
-void draw_image(Image img, Point p);
-void draw_sub_image(SubImage s, Point p);
-void set_canvas(Canvas c);
-void unset_canvas();
-
-Pad read_pad(Peer peer);
-Buttons read_buttons(Peer peer);
-
-size_t get_file_size(char *path);
-File load_file(char *path, Buffer buf);
-void dump_file(char *path, File f);
-void remove_file(char *path);
-
-Peer get_me();
-Peers get_peers();
-bool is_online(Peers peers, Peer peer);
-void save_stash(Peer p, Stash s);
-Stash load_stash(Peer p, Buffer s);
-
-void log_debug(char *msg);
-void log_error(char *msg);
-void set_seed(uintptr_t seed);
-uintptr_t get_random();
-Buffer get_name(Peer p, Buffer buf);
-Settings get_settings(Peer p);
-void restart();
-void quit();
-
-Progress add_progress(Peer p, Badge b, int16_t v);
-Progress get_progress(Peer p, Badge b);
-Score add_score(Peer p, Badge b, Score v);
-Score get_score(Peer p, Badge b);
-
-AudioNode add_sine(AudioNode parent, float freq, float phase);
-AudioNode add_square(AudioNode parent, float freq, float phase);
-AudioNode add_sawtooth(AudioNode parent, float freq, float phase);
-AudioNode add_triangle(AudioNode parent, float freq, float phase);
-AudioNode add_noise(AudioNode parent, int32_t seed);
-AudioNode add_empty(AudioNode parent);
-AudioNode add_zero(AudioNode parent);
-AudioNode add_file(AudioNode parent, char *path);
-AudioNode add_mix(AudioNode parent);
-AudioNode add_all_for_one(AudioNode parent);
-AudioNode add_gain(AudioNode parent, float lvl);
-AudioNode add_loop(AudioNode parent);
-AudioNode add_concat(AudioNode parent);
-AudioNode add_pan(AudioNode parent, float lvl);
-AudioNode add_mute(AudioNode parent);
-AudioNode add_pause(AudioNode parent);
-AudioNode add_track_position(AudioNode parent);
-AudioNode add_low_pass(AudioNode parent, float freq, float q);
-AudioNode add_high_pass(AudioNode parent, float freq, float q);
-AudioNode add_take_left(AudioNode parent);
-AudioNode add_take_right(AudioNode parent);
-AudioNode add_swap(AudioNode parent);
-AudioNode add_clip(AudioNode parent, float low, float high);
-
-void mod_linear(AudioNode node, ModParam param, LinearModulator mod);
-void mod_hold(AudioNode node, ModParam param, HoldModulator mod);
-void mod_sine(AudioNode node, ModParam param, SineModulator mod);
-
-void audio_reset(AudioNode node);
-void audio_reset_all(AudioNode node);
-void audio_clear(AudioNode node);
+FIREFLY_API Angle radians(float a);
+FIREFLY_API Angle degrees(float a);
+FIREFLY_API AudioTime samples(int32_t s);
+FIREFLY_API AudioTime seconds(int32_t s);
+FIREFLY_API AudioTime miliseconds(int32_t s);
+FIREFLY_API DPad8 pad_to_dpad8(Pad pad);
+FIREFLY_API DPad4 pad_to_dpad4(Pad pad);
+
+FIREFLY_API void clear_screen(Color c);
+FIREFLY_API void set_color(Color c, RGB v);
+FIREFLY_API void draw_point(Point p, Color c);
+FIREFLY_API void draw_line(Point a, Point b, LineStyle s);
+FIREFLY_API void draw_rect(Point p, Size b, Style s);
+FIREFLY_API void draw_rounded_rect(Point p, Size b, Size c, Style s);
+FIREFLY_API void draw_circle(Point p, int32_t d, Style s);
+FIREFLY_API void draw_ellipse(Point p, Size b, Style s);
+FIREFLY_API void draw_triangle(Point a, Point b, Point c, Style s);
+FIREFLY_API void draw_text(char *t, Font f, Point p, Color c);
+FIREFLY_API void draw_qr(char *t, Point p, Color black, Color white);
+FIREFLY_API void draw_text_str(Str t, Font f, Point p, Color c);
+FIREFLY_API void draw_qr_str(Str t, Point p, Color black, Color white);
+FIREFLY_API void draw_arc(Point p, int32_t d, Angle start, Angle sweep, Style s);
+FIREFLY_API void draw_sector(Point p, int32_t d, Angle start, Angle sweep, Style s);
+FIREFLY_API void draw_image(Image img, Point p);
+FIREFLY_API void draw_sub_image(SubImage s, Point p);
+FIREFLY_API void set_canvas(Canvas c);
+FIREFLY_API void unset_canvas();
+FIREFLY_API Size image_size(Image i);
+
+FIREFLY_API DrawHook set_draw_hook(DrawHook hook);
+FIREFLY_API void submit_draw_cmd(const DrawCmd *cmd);
+FIREFLY_API void exec_draw_cmd(const DrawCmd *cmd);
+FIREFLY_API bool draw_cmd_bounds(const DrawCmd *cmd, Rect *r);
+FIREFLY_API float draw_cmd_angle(const DrawCmd *cmd, int32_t i);
+FIREFLY_API int32_t draw_cmd_angle_bits(float a);
+FIREFLY_API bool rect_intersects(Rect a, Rect b);
+FIREFLY_API bool rect_contains(Rect outer, Rect inner);
+
+FIREFLY_API Pad read_pad(Peer peer);
+FIREFLY_API Buttons read_buttons(Peer peer);
+FIREFLY_API InputHook set_input_hook(InputHook hook);
+FIREFLY_API uintptr_t submit_input(InputOp op, uintptr_t arg);
+FIREFLY_API uintptr_t exec_input(InputOp op, uintptr_t arg);
+
+FIREFLY_API size_t get_file_size(char *path);
+FIREFLY_API File load_file(char *path, Buffer buf);
+FIREFLY_API void dump_file(char *path, File f);
+FIREFLY_API void remove_file(char *path);
+FIREFLY_API size_t get_file_size_str(Str path);
+FIREFLY_API File load_file_str(Str path, Buffer buf);
+FIREFLY_API void dump_file_str(Str path, File f);
+FIREFLY_API void remove_file_str(Str path);
+
+FIREFLY_API Peer get_me();
+FIREFLY_API Peers get_peers();
+FIREFLY_API bool is_online(Peers peers, Peer peer);
+FIREFLY_API void save_stash(Peer p, Stash s);
+FIREFLY_API Stash load_stash(Peer p, Buffer s);
+
+FIREFLY_API void log_debug(char *msg);
+FIREFLY_API void log_error(char *msg);
+FIREFLY_API void log_debug_str(Str msg);
+FIREFLY_API void log_error_str(Str msg);
+FIREFLY_API Str cstr(const char *s);
+FIREFLY_API void set_seed(uintptr_t seed);
+FIREFLY_API uintptr_t get_random();
+FIREFLY_API Buffer get_name(Peer p, Buffer buf);
+FIREFLY_API Settings get_settings(Peer p);
+FIREFLY_API void restart();
+FIREFLY_API void quit();
+
+FIREFLY_API Progress add_progress(Peer p, Badge b, int16_t v);
+FIREFLY_API Progress get_progress(Peer p, Badge b);
+FIREFLY_API Score add_score(Peer p, Badge b, Score v);
+FIREFLY_API Score get_score(Peer p, Badge b);
+
+FIREFLY_API AudioNode add_sine(AudioNode parent, float freq, float phase);
+FIREFLY_API AudioNode add_square(AudioNode parent, float freq, float phase);
+FIREFLY_API AudioNode add_sawtooth(AudioNode parent, float freq, float phase);
+FIREFLY_API AudioNode add_triangle(AudioNode parent, float freq, float phase);
+FIREFLY_API AudioNode add_noise(AudioNode parent, int32_t seed);
+FIREFLY_API AudioNode add_empty(AudioNode parent);
+FIREFLY_API AudioNode add_zero(AudioNode parent);
+FIREFLY_API AudioNode add_file(AudioNode parent, char *path);
+FIREFLY_API AudioNode add_file_str(AudioNode parent, Str path);
+FIREFLY_API AudioNode add_mix(AudioNode parent);
+FIREFLY_API AudioNode add_all_for_one(AudioNode parent);
+FIREFLY_API AudioNode add_gain(AudioNode parent, float lvl);
+FIREFLY_API AudioNode add_loop(AudioNode parent);
+FIREFLY_API AudioNode add_concat(AudioNode parent);
+FIREFLY_API AudioNode add_pan(AudioNode parent, float lvl);
+FIREFLY_API AudioNode add_mute(AudioNode parent);
+FIREFLY_API AudioNode add_pause(AudioNode parent);
+FIREFLY_API AudioNode add_track_position(AudioNode parent);
+FIREFLY_API AudioNode add_low_pass(AudioNode parent, float freq, float q);
+FIREFLY_API AudioNode add_high_pass(AudioNode parent, float freq, float q);
+FIREFLY_API AudioNode add_take_left(AudioNode parent);
+FIREFLY_API AudioNode add_take_right(AudioNode parent);
+FIREFLY_API AudioNode add_swap(AudioNode parent);
+FIREFLY_API AudioNode add_clip(AudioNode parent, float low, float high);
+
+FIREFLY_API void mod_linear(AudioNode node, ModParam param, LinearModulator mod);
+FIREFLY_API void mod_hold(AudioNode node, ModParam param, HoldModulator mod);
+FIREFLY_API void mod_sine(AudioNode node, ModParam param, SineModulator mod);
+
+FIREFLY_API void audio_reset(AudioNode node);
+FIREFLY_API void audio_reset_all(AudioNode node);
+FIREFLY_API void audio_clear(AudioNode node);
+
+// firefly.c defines _FF_FIREFLY_C so that including it directly
+// doesn't pull in the definitions a second time.
+#if defined(FIREFLY_HEADER_ONLY) && !defined(_FF_FIREFLY_C)
+#include "firefly.c"
+#endif
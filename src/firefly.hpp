@@ -0,0 +1,398 @@
+/// @file
+/// @brief The C++ interface for Firefly Zero C SDK.
+///
+/// @details A thin header-only layer over firefly.h. Everything is in the `ff` namespace:
+///
+/// * constexpr builders for points, sizes, colors, and styles;
+/// * std::span and std::string_view overloads, so that no string is measured with strlen;
+/// * compile-time AudioTime conversions;
+/// * make_image, building images from pixel art at compile time;
+/// * CanvasScope, drawing on a canvas until the end of the scope.
+///
+/// Every function is inline and forwards to the C API, so the layer adds no code
+/// on its own. It doesn't use exceptions or RTTI and works with
+/// `-fno-exceptions -fno-rtti`. Requires C++20.
+///
+/// ```cpp
+/// #include "firefly.hpp"
+///
+/// BOOT void boot()
+/// {
+///     ff::CanvasScope scope{canvas};
+///     ff::draw_text("hello", font, ff::point(10, 20), BLACK);
+/// }
+/// ```
+
+#pragma once
+
+#include "firefly.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace ff
+{
+
+// -- GRAPHICS -- //
+
+/// @brief A point on the screen.
+constexpr Point point(int32_t x, int32_t y) noexcept
+{
+    return Point{x, y};
+}
+
+/// @brief The width and height of a shape.
+constexpr Size size(int32_t width, int32_t height) noexcept
+{
+    return Size{width, height};
+}
+
+/// @brief The color at the given palette index, from 0 to 15.
+constexpr Color palette(int32_t index) noexcept
+{
+    return static_cast<Color>((index & 0xf) + 1);
+}
+
+/// @brief A shape style with the given fill and stroke.
+constexpr Style style(Color fill, Color stroke = NONE, int32_t stroke_width = 0) noexcept
+{
+    return Style{fill, stroke, stroke_width};
+}
+
+/// @brief A shape style filling the shape with the color and drawing no stroke.
+constexpr Style filled(Color fill) noexcept
+{
+    return Style{fill, NONE, 0};
+}
+
+/// @brief A shape style drawing only the stroke.
+constexpr Style outlined(Color stroke, int32_t stroke_width = 1) noexcept
+{
+    return Style{NONE, stroke, stroke_width};
+}
+
+/// @brief A line style.
+constexpr LineStyle line_style(Color color, int32_t width = 1) noexcept
+{
+    return LineStyle{color, width};
+}
+
+constexpr Point operator+(Point a, Point b) noexcept
+{
+    return Point{a.x + b.x, a.y + b.y};
+}
+
+constexpr Point operator-(Point a, Point b) noexcept
+{
+    return Point{a.x - b.x, a.y - b.y};
+}
+
+constexpr bool operator==(Point a, Point b) noexcept
+{
+    return a.x == b.x && a.y == b.y;
+}
+
+constexpr bool operator==(Size a, Size b) noexcept
+{
+    return a.width == b.width && a.height == b.height;
+}
+
+/// @brief Draw on the canvas instead of the screen until the end of the scope.
+class CanvasScope
+{
+public:
+    explicit CanvasScope(Canvas c) noexcept
+    {
+        set_canvas(c);
+    }
+
+    ~CanvasScope() noexcept
+    {
+        unset_canvas();
+    }
+
+    CanvasScope(const CanvasScope &) = delete;
+    CanvasScope &operator=(const CanvasScope &) = delete;
+};
+
+// -- BUFFERS AND STRINGS -- //
+
+/// @brief A Buffer using the memory of the span.
+constexpr Buffer buffer(std::span<char> s) noexcept
+{
+    return Buffer{s.size(), s.data()};
+}
+
+/// @brief A Buffer using the memory of the read-only span.
+/// @details Only for images, fonts, and other data the host only reads.
+inline Buffer buffer(std::span<const char> s) noexcept
+{
+    return Buffer{s.size(), const_cast<char *>(s.data())};
+}
+
+/// @brief A Buffer using the memory of the read-only byte span.
+/// @details Only for images, fonts, and other data the host only reads.
+inline Buffer buffer(std::span<const uint8_t> s) noexcept
+{
+    return Buffer{s.size(), reinterpret_cast<char *>(const_cast<uint8_t *>(s.data()))};
+}
+
+/// @brief The memory of the Buffer as a span.
+constexpr std::span<char> span(Buffer b) noexcept
+{
+    return std::span<char>{b.head, b.size};
+}
+
+/// @brief A Str view of the string. String literals are measured at compile time.
+constexpr Str str(std::string_view s) noexcept
+{
+    return Str{s.data(), s.size()};
+}
+
+inline void draw_text(std::string_view t, Font f, Point p, Color c) noexcept
+{
+    draw_text_str(str(t), f, p, c);
+}
+
+inline void draw_qr(std::string_view t, Point p, Color black, Color white) noexcept
+{
+    draw_qr_str(str(t), p, black, white);
+}
+
+inline size_t get_file_size(std::string_view path) noexcept
+{
+    return get_file_size_str(str(path));
+}
+
+inline File load_file(std::string_view path, std::span<char> buf) noexcept
+{
+    return load_file_str(str(path), buffer(buf));
+}
+
+inline void dump_file(std::string_view path, std::span<const char> content) noexcept
+{
+    dump_file_str(str(path), buffer(content));
+}
+
+inline void remove_file(std::string_view path) noexcept
+{
+    remove_file_str(str(path));
+}
+
+inline void log_debug(std::string_view msg) noexcept
+{
+    log_debug_str(str(msg));
+}
+
+inline void log_error(std::string_view msg) noexcept
+{
+    log_error_str(str(msg));
+}
+
+inline AudioNode add_file(AudioNode parent, std::string_view path) noexcept
+{
+    return add_file_str(parent, str(path));
+}
+
+// -- EMBEDDED IMAGES -- //
+
+/// @brief An image in the draw_image format stored in constant data.
+template <size_t N>
+struct EmbeddedImage
+{
+    /// @brief The raw image bytes: the header, color swaps, and packed pixels.
+    uint8_t bytes[N];
+
+    /// @brief The image, pointing into the constant data. No copying or loading.
+    Image image() const noexcept
+    {
+        return buffer(std::span<const uint8_t>{bytes, N});
+    }
+};
+
+/// @private
+/// @brief Not constexpr, calling it from make_image fails the compilation.
+inline void _image_error(const char *) noexcept {}
+
+/// @private
+constexpr int32_t _art_index(char c) noexcept
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return c == '.' ? -1 : -2;
+}
+
+/// @private
+constexpr bool _art_space(char c) noexcept
+{
+    return c == ' ' || c == '\n' || c == '\t';
+}
+
+/// @brief Build an image from pixel art at compile time.
+///
+/// @details Every pixel is a hex digit of the palette index (0-f),
+/// or a dot for a transparent pixel. Whitespace is ignored,
+/// so rows can be written as separate string literals:
+///
+/// ```cpp
+/// static constexpr auto heart = ff::make_image<5, 4, 1>(
+///     ".e.e."
+///     "eeeee"
+///     ".eee."
+///     "..e..");
+///
+/// draw_image(heart.image(), ff::point(10, 20));
+/// ```
+///
+/// With BPP of 1 or 2, the image can use any 2 or 4 distinct palette colors
+/// (including transparency), which are mapped through the color swaps.
+/// Invalid art (a wrong pixel count, an unknown character, or too many colors)
+/// fails the compilation.
+template <int32_t W, int32_t H, int32_t BPP = 4, size_t L>
+consteval auto make_image(const char (&art)[L]) noexcept
+{
+    static_assert(BPP == 1 || BPP == 2 || BPP == 4, "bits per pixel must be 1, 2, or 4");
+    static_assert(W > 0 && W <= 0xffff && H > 0, "invalid image size");
+    constexpr size_t bits = static_cast<size_t>(W) * H * BPP;
+    // The height is derived from the size, so the padding must be shorter than a row.
+    static_assert((8 - bits % 8) % 8 < static_cast<size_t>(W) * BPP, "the pixels don't fill whole bytes, change the width");
+    constexpr size_t header = 5 + (1 << BPP) / 2;
+    EmbeddedImage<header + (bits + 7) / 8> result{};
+
+    // Assign pixel values to the colors in the order of appearance.
+    int32_t colors[16] = {};
+    int32_t colors_len = 0;
+    bool used[16] = {};
+    bool transparent = false;
+    int32_t pixels = 0;
+    for (size_t i = 0; i + 1 < L; i++)
+    {
+        int32_t index = _art_index(art[i]);
+        if (_art_space(art[i]))
+        {
+            continue;
+        }
+        if (index == -2)
+        {
+            _image_error("unknown character in the pixel art");
+        }
+        pixels++;
+        if (index == -1)
+        {
+            transparent = true;
+        }
+        else if (!used[index])
+        {
+            used[index] = true;
+            colors[colors_len++] = index;
+        }
+    }
+    if (pixels != W * H)
+    {
+        _image_error("the number of pixels in the art doesn't match the size");
+    }
+    int32_t clear = 0xff;
+    if (transparent)
+    {
+        clear = 0;
+        while (clear < 16 && used[clear])
+        {
+            clear++;
+        }
+        if (clear == 16)
+        {
+            _image_error("no palette index left for transparency");
+        }
+        colors[colors_len++] = clear;
+    }
+    if (colors_len > (1 << BPP))
+    {
+        _image_error("too many colors for the bits per pixel");
+    }
+
+    uint8_t *b = result.bytes;
+    b[0] = 0x21;
+    b[1] = BPP;
+    b[2] = W & 0xff;
+    b[3] = (W >> 8) & 0xff;
+    b[4] = static_cast<uint8_t>(clear);
+    for (int32_t v = 0; v < colors_len; v++)
+    {
+        b[5 + v / 2] |= static_cast<uint8_t>(v % 2 == 0 ? colors[v] << 4 : colors[v]);
+    }
+    size_t bit = 0;
+    for (size_t i = 0; i + 1 < L; i++)
+    {
+        if (_art_space(art[i]))
+        {
+            continue;
+        }
+        int32_t index = _art_index(art[i]);
+        int32_t value = 0;
+        while (colors[value] != (index == -1 ? clear : index))
+        {
+            value++;
+        }
+        b[header + bit / 8] |= static_cast<uint8_t>(value << (8 - BPP - bit % 8));
+        bit += BPP;
+    }
+    return result;
+}
+
+// -- AUDIO -- //
+
+/// @brief Time in the number of samples.
+constexpr AudioTime samples(uint32_t s) noexcept
+{
+    return AudioTime{s};
+}
+
+/// @brief Time in seconds.
+constexpr AudioTime seconds(uint32_t s) noexcept
+{
+    return AudioTime{s * SAMPLE_RATE};
+}
+
+/// @brief Time in milliseconds.
+constexpr AudioTime milliseconds(uint32_t ms) noexcept
+{
+    return AudioTime{static_cast<uint32_t>(static_cast<uint64_t>(ms) * SAMPLE_RATE / 1000)};
+}
+
+/// @brief Time in seconds, converted and checked at compile time.
+template <uint32_t S>
+constexpr AudioTime seconds() noexcept
+{
+    static_assert(static_cast<uint64_t>(S) * SAMPLE_RATE <= UINT32_MAX, "the time doesn't fit into AudioTime");
+    return AudioTime{S * SAMPLE_RATE};
+}
+
+/// @brief Time in milliseconds, converted and checked at compile time.
+template <uint32_t MS>
+constexpr AudioTime milliseconds() noexcept
+{
+    static_assert(static_cast<uint64_t>(MS) * SAMPLE_RATE / 1000 <= UINT32_MAX, "the time doesn't fit into AudioTime");
+    return AudioTime{static_cast<uint32_t>(static_cast<uint64_t>(MS) * SAMPLE_RATE / 1000)};
+}
+
+constexpr bool operator==(AudioTime a, AudioTime b) noexcept
+{
+    return a.samples == b.samples;
+}
+
+static_assert(seconds<2>() == AudioTime{88200});
+static_assert(milliseconds<500>() == AudioTime{22050});
+static_assert(milliseconds(1500) == AudioTime{66150});
+
+} // namespace ff
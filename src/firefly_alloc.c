@@ -0,0 +1,198 @@
+/// @file
+/// @brief The implementation of allocators. See firefly_alloc.h.
+
+#include "firefly_alloc.h"
+#include <string.h>
+#ifndef __wasm__
+#include <stdlib.h>
+#endif
+
+/// @private
+/// @brief The alignment of all allocations.
+#define _FF_ALLOC_ALIGN 8
+
+/// @private
+#define _FF_ALLOC_ROUND(n) (((n) + _FF_ALLOC_ALIGN - 1) & ~(size_t)(_FF_ALLOC_ALIGN - 1))
+
+/// @private
+/// @brief The size of the chunk header, keeping the chunk data aligned.
+#define _FF_CHUNK_HEADER _FF_ALLOC_ROUND(sizeof(struct _ffArenaChunk))
+
+/// @private
+/// @brief Get fresh memory from the host. Returns NULL if there is none left.
+static void *_ff_alloc_grow(size_t size)
+{
+#ifdef __wasm__
+    size_t pages = (size + 65535) / 65536;
+    size_t prev = __builtin_wasm_memory_grow(0, pages);
+    if (prev == (size_t)-1)
+    {
+        return 0;
+    }
+    return (void *)(prev * 65536);
+#else
+    return malloc(size);
+#endif
+}
+
+/// @brief Create an arena requesting memory in chunks of the given size.
+/// @details Pass 0 for the default (ARENA_CHUNK_SIZE). No memory is requested
+/// until the first allocation. Bigger allocations get a chunk of their own size.
+Arena new_arena(size_t chunk_size)
+{
+    Arena a;
+    memset(&a, 0, sizeof(a));
+    a.chunk_size = chunk_size == 0 ? ARENA_CHUNK_SIZE : chunk_size;
+    return a;
+}
+
+/// @brief Allocate a buffer of the given size, aligned to 8 bytes.
+/// @details Returns an empty buffer (NULL head) if out of memory.
+Buffer arena_alloc(Arena *a, size_t size)
+{
+    Buffer b = {0, 0};
+    size_t rounded = _FF_ALLOC_ROUND(size);
+    struct _ffArenaChunk *c = a->current;
+    while (c != 0 && a->offset + rounded > c->size)
+    {
+        // Chunks left from before a reset are reused in order.
+        c = c->next;
+        a->offset = 0;
+    }
+    if (c == 0)
+    {
+        size_t need = _FF_CHUNK_HEADER + rounded;
+        size_t chunk = need > a->chunk_size ? need : a->chunk_size;
+#ifdef __wasm__
+        // memory.grow always gets whole pages, so use all of them.
+        chunk = (chunk + 65535) & ~(size_t)65535;
+#endif
+        char *mem = (char *)_ff_alloc_grow(chunk);
+        if (mem == 0)
+        {
+            return b;
+        }
+        c = (struct _ffArenaChunk *)mem;
+        c->next = 0;
+        c->size = chunk - _FF_CHUNK_HEADER;
+        a->capacity += chunk;
+        if (a->first == 0)
+        {
+            a->first = c;
+        }
+        else
+        {
+            struct _ffArenaChunk *last = a->current != 0 ? a->current : a->first;
+            while (last->next != 0)
+            {
+                last = last->next;
+            }
+            last->next = c;
+        }
+        a->offset = 0;
+    }
+    a->current = c;
+    b.head = (char *)c + _FF_CHUNK_HEADER + a->offset;
+    b.size = size;
+    a->offset += rounded;
+    a->used += rounded;
+    a->high_water = a->used > a->high_water ? a->used : a->high_water;
+    return b;
+}
+
+/// @brief Load the whole file into a buffer allocated in the arena.
+/// @details Returns an empty file if the file doesn't exist or there is no memory.
+File arena_load_file(Arena *a, char *path)
+{
+    Str p = cstr(path);
+    size_t size = get_file_size_str(p);
+    File f = {0, 0};
+    if (size == 0)
+    {
+        return f;
+    }
+    Buffer buf = arena_alloc(a, size);
+    if (buf.head == 0)
+    {
+        return f;
+    }
+    return load_file_str(p, buf);
+}
+
+/// @brief Free all allocations at once. The memory is kept for the next allocations.
+void arena_reset(Arena *a)
+{
+    a->current = a->first;
+    a->offset = 0;
+    a->used = 0;
+}
+
+/// @private
+static Arena _ff_frame_arena = {0, 0, 0, ARENA_CHUNK_SIZE, 0, 0, 0};
+
+/// @brief Allocate scratch memory valid until the next frame_reset.
+Buffer frame_alloc(size_t size)
+{
+    return arena_alloc(&_ff_frame_arena, size);
+}
+
+/// @brief Free all scratch memory. Call it at the start of every update.
+void frame_reset()
+{
+    arena_reset(&_ff_frame_arena);
+}
+
+/// @brief The arena behind frame_alloc, to read its statistics.
+Arena *frame_arena()
+{
+    return &_ff_frame_arena;
+}
+
+/// @brief Create a pool of blocks of the given size.
+/// @details The memory is requested for the given number of blocks at once.
+/// Blocks are aligned to 8 bytes.
+Pool new_pool(size_t block_size, size_t blocks_per_chunk)
+{
+    Pool p;
+    memset(&p, 0, sizeof(p));
+    p.block_size = _FF_ALLOC_ROUND(block_size < sizeof(void *) ? sizeof(void *) : block_size);
+    blocks_per_chunk = blocks_per_chunk == 0 ? 1 : blocks_per_chunk;
+    p.arena = new_arena(_FF_CHUNK_HEADER + p.block_size * blocks_per_chunk);
+    return p;
+}
+
+/// @brief Allocate a single block.
+/// @details Returns an empty buffer (NULL head) if out of memory.
+Buffer pool_alloc(Pool *p)
+{
+    Buffer b = {0, 0};
+    if (p->free != 0)
+    {
+        b.head = (char *)p->free;
+        p->free = *(void **)p->free;
+    }
+    else
+    {
+        b = arena_alloc(&p->arena, p->block_size);
+        if (b.head == 0)
+        {
+            return b;
+        }
+    }
+    b.size = p->block_size;
+    p->live++;
+    p->high_water = p->live > p->high_water ? p->live : p->high_water;
+    return b;
+}
+
+/// @brief Return a block allocated by pool_alloc to the pool.
+void pool_free(Pool *p, Buffer b)
+{
+    if (b.head == 0)
+    {
+        return;
+    }
+    *(void **)b.head = p->free;
+    p->free = b.head;
+    p->live--;
+}
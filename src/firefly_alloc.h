@@ -0,0 +1,78 @@
+/// @file
+/// @brief Allocators handing out Buffers for files, stashes, names, and canvases.
+///
+/// @details Three allocators on top of the same memory source:
+///
+/// * Arena: a bump allocator. Allocations are freed all at once by arena_reset.
+/// * The frame arena: a global Arena for scratch memory that lives for one frame.
+///   Call frame_reset at the start of every update.
+/// * Pool: fixed-size blocks that can be freed one by one.
+///
+/// On WASM, the memory comes straight from growing the linear memory
+/// with `memory.grow`, so no libc malloc gets linked in. The memory
+/// is never returned to the host, reset allocators reuse it instead.
+/// In native builds, malloc is used.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The default size of memory chunks requested by an Arena: one WASM page.
+#define ARENA_CHUNK_SIZE 65536
+
+/// @private
+/// @brief The header of a memory chunk owned by an Arena.
+struct _ffArenaChunk
+{
+    struct _ffArenaChunk *next;
+    size_t size;
+};
+
+/// @brief A bump allocator growing in chunks.
+struct Arena
+{
+    /// @private
+    struct _ffArenaChunk *first;
+    /// @private
+    struct _ffArenaChunk *current;
+    /// @private
+    size_t offset;
+    /// @private
+    size_t chunk_size;
+    /// @brief The number of bytes allocated since the last reset.
+    size_t used;
+    /// @brief The largest number of bytes allocated between two resets.
+    size_t high_water;
+    /// @brief The number of bytes requested from the memory source, including headers.
+    size_t capacity;
+};
+typedef struct Arena Arena;
+
+/// @brief A free-list allocator of fixed-size blocks.
+struct Pool
+{
+    /// @private
+    Arena arena;
+    /// @private
+    size_t block_size;
+    /// @private
+    void *free;
+    /// @brief The number of blocks currently allocated.
+    size_t live;
+    /// @brief The largest number of blocks allocated at once.
+    size_t high_water;
+};
+typedef struct Pool Pool;
+
+Arena new_arena(size_t chunk_size);
+Buffer arena_alloc(Arena *a, size_t size);
+File arena_load_file(Arena *a, char *path);
+void arena_reset(Arena *a);
+
+Buffer frame_alloc(size_t size);
+void frame_reset();
+Arena *frame_arena();
+
+Pool new_pool(size_t block_size, size_t blocks_per_chunk);
+Buffer pool_alloc(Pool *p);
+void pool_free(Pool *p, Buffer b);
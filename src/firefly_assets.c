@@ -0,0 +1,203 @@
+/// @file
+/// @brief The implementation of the asset manager. See firefly_assets.h.
+
+#include "firefly_assets.h"
+#include <string.h>
+
+/// @private
+/// @brief The alignment of asset data in the storage.
+#define _FF_ASSET_ALIGN 8
+
+/// @brief Hash the path to look it up faster. Compute it once and keep the key.
+AssetKey asset_key(Str path)
+{
+    // FNV-1a, the same as the constexpr ff::asset_key for C++.
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < path.len; i++)
+    {
+        h = (h ^ (uint8_t)path.ptr[i]) * 16777619u;
+    }
+    AssetKey key = {h, path};
+    return key;
+}
+
+/// @brief Create an asset manager keeping the assets in the given storage.
+/// @details The storage size is the memory budget. Allocate it with arena_alloc
+/// or use a static array. It must stay alive while the manager is used.
+Assets new_assets(Buffer storage)
+{
+    Assets a;
+    memset(&a, 0, sizeof(a));
+    a.storage = storage;
+    return a;
+}
+
+/// @private
+/// @brief Find the first gap in the storage big enough for the given size.
+/// @details There are few assets, so the gaps are found by scanning the entries.
+/// With `evictable`, released assets count as free space.
+static bool _ff_assets_fit(Assets *a, size_t size, size_t *offset, bool evictable)
+{
+    size_t head = 0;
+    while (true)
+    {
+        // The entry starting the closest after the head.
+        AssetEntry *next = 0;
+        for (int32_t i = 0; i < ASSETS_MAX; i++)
+        {
+            AssetEntry *e = &a->entries[i];
+            bool taken = e->used && (!evictable || e->refs > 0);
+            if (taken && e->offset >= head && (next == 0 || e->offset < next->offset))
+            {
+                next = e;
+            }
+        }
+        size_t end = next == 0 ? a->storage.size : next->offset;
+        if (end - head >= size)
+        {
+            *offset = head;
+            return true;
+        }
+        if (next == 0)
+        {
+            return false;
+        }
+        head = next->offset + next->size;
+    }
+}
+
+/// @private
+/// @brief Evict the least recently used released asset. Returns false if there is none.
+static bool _ff_assets_evict_one(Assets *a)
+{
+    AssetEntry *oldest = 0;
+    for (int32_t i = 0; i < ASSETS_MAX; i++)
+    {
+        AssetEntry *e = &a->entries[i];
+        if (e->used && e->refs == 0 && (oldest == 0 || e->last_used < oldest->last_used))
+        {
+            oldest = e;
+        }
+    }
+    if (oldest == 0)
+    {
+        return false;
+    }
+    oldest->used = false;
+    a->stats.used -= oldest->size;
+    a->stats.evictions++;
+    return true;
+}
+
+/// @brief Get the file content, loading it if it is not in memory yet.
+///
+/// @details The returned file (or Image, or Font) shares memory with all other
+/// acquires of the same path. Don't modify it, and call asset_release
+/// when it is not needed anymore. Returns an empty file on failure.
+File asset_acquire(Assets *a, AssetKey key)
+{
+    File f = {0, 0};
+    a->clock++;
+    AssetEntry *slot = 0;
+    for (int32_t i = 0; i < ASSETS_MAX; i++)
+    {
+        AssetEntry *e = &a->entries[i];
+        if (!e->used)
+        {
+            slot = slot == 0 ? e : slot;
+            continue;
+        }
+        if (e->key.hash == key.hash && e->key.path.len == key.path.len &&
+            memcmp(e->key.path.ptr, key.path.ptr, key.path.len) == 0)
+        {
+            e->refs++;
+            e->last_used = a->clock;
+            a->stats.hits++;
+            return e->file;
+        }
+    }
+
+    size_t fileSize = get_file_size_str(key.path);
+    size_t size = (fileSize + _FF_ASSET_ALIGN - 1) & ~(size_t)(_FF_ASSET_ALIGN - 1);
+    // A file bigger than the whole storage never fits,
+    // don't evict anything for it.
+    if (fileSize == 0 || size > a->storage.size)
+    {
+        a->stats.failures++;
+        return f;
+    }
+    // Evict nothing if the file won't fit even with all released assets gone,
+    // for example when pinned assets fragment the storage.
+    size_t offset = 0;
+    if (!_ff_assets_fit(a, size, &offset, true))
+    {
+        a->stats.failures++;
+        return f;
+    }
+    if (slot == 0)
+    {
+        // All slots are taken, free one first.
+        if (!_ff_assets_evict_one(a))
+        {
+            a->stats.failures++;
+            return f;
+        }
+        for (int32_t i = 0; i < ASSETS_MAX && slot == 0; i++)
+        {
+            slot = a->entries[i].used ? 0 : &a->entries[i];
+        }
+    }
+    while (!_ff_assets_fit(a, size, &offset, false))
+    {
+        if (!_ff_assets_evict_one(a))
+        {
+            a->stats.failures++;
+            return f;
+        }
+    }
+
+    Buffer buf = {fileSize, a->storage.head + offset};
+    f = load_file_str(key.path, buf);
+    if (f.size != fileSize)
+    {
+        // Don't cache a failed or short read, the next acquire tries again.
+        a->stats.failures++;
+        File empty = {0, 0};
+        return empty;
+    }
+    a->stats.loads++;
+    slot->used = true;
+    slot->key = key;
+    slot->file = f;
+    slot->offset = offset;
+    slot->size = size;
+    slot->refs = 1;
+    slot->last_used = a->clock;
+    a->stats.used += size;
+    a->stats.high_water = a->stats.used > a->stats.high_water ? a->stats.used : a->stats.high_water;
+    return f;
+}
+
+/// @brief Release the asset returned by asset_acquire.
+/// @details The asset stays in memory and can be acquired again without loading
+/// until its memory is needed for another asset.
+void asset_release(Assets *a, File f)
+{
+    for (int32_t i = 0; i < ASSETS_MAX; i++)
+    {
+        AssetEntry *e = &a->entries[i];
+        if (e->used && e->file.head == f.head && e->refs > 0)
+        {
+            e->refs--;
+            return;
+        }
+    }
+}
+
+/// @brief Evict all released assets right away.
+void assets_evict(Assets *a)
+{
+    while (_ff_assets_evict_one(a))
+    {
+    }
+}
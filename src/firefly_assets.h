@@ -0,0 +1,107 @@
+/// @file
+/// @brief Loading every asset only once and sharing it between modules.
+///
+/// @details Assets are identified by an AssetKey, the file path with its hash
+/// computed in advance (see asset_key). The first asset_acquire of a path
+/// loads the file into the manager storage, sized with get_file_size;
+/// later calls return the same memory and increment the reference count.
+///
+/// Released assets (no references left) stay in memory until the storage
+/// is needed for another asset. Then the least recently used released
+/// assets are evicted. Acquired assets never move or get evicted.
+///
+/// ```c
+/// static AssetKey FONT_KEY;
+/// FONT_KEY = asset_key(STR("font"));
+/// Font font = asset_acquire(&assets, FONT_KEY);
+/// ```
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The maximum number of assets kept at once.
+#define ASSETS_MAX 64
+
+/// @brief An asset path with its precomputed hash.
+struct AssetKey
+{
+    uint32_t hash;
+    /// @brief The path. It must stay alive while the asset is cached.
+    Str path;
+};
+typedef struct AssetKey AssetKey;
+
+/// @brief Counters of the asset manager work.
+struct AssetStats
+{
+    /// @brief The number of acquires served from memory.
+    uint32_t hits;
+    /// @brief The number of files loaded from the host.
+    uint32_t loads;
+    /// @brief The number of released assets evicted to free memory.
+    uint32_t evictions;
+    /// @brief The number of acquires that failed: no file, no memory, or no free slot.
+    uint32_t failures;
+    /// @brief The number of bytes of storage used by cached assets.
+    size_t used;
+    /// @brief The largest number of bytes used at once.
+    size_t high_water;
+};
+typedef struct AssetStats AssetStats;
+
+/// @private
+struct AssetEntry
+{
+    AssetKey key;
+    File file;
+    /// @brief The offset and the size of the reserved storage.
+    size_t offset;
+    size_t size;
+    uint32_t refs;
+    uint32_t last_used;
+    bool used;
+};
+typedef struct AssetEntry AssetEntry;
+
+/// @brief A cache of loaded files under a fixed memory budget.
+struct Assets
+{
+    /// @private
+    Buffer storage;
+    /// @private
+    uint32_t clock;
+    /// @private
+    AssetEntry entries[ASSETS_MAX];
+    /// @brief Statistics accumulated since new_assets.
+    AssetStats stats;
+};
+typedef struct Assets Assets;
+
+AssetKey asset_key(Str path);
+Assets new_assets(Buffer storage);
+File asset_acquire(Assets *a, AssetKey key);
+void asset_release(Assets *a, File f);
+void assets_evict(Assets *a);
+
+#ifdef __cplusplus
+namespace ff
+{
+/// @brief The AssetKey of a path, computed at compile time for constant paths.
+constexpr AssetKey asset_key(const char *path, size_t len) noexcept
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ static_cast<uint8_t>(path[i])) * 16777619u;
+    }
+    return AssetKey{h, Str{path, len}};
+}
+
+template <size_t N>
+constexpr AssetKey asset_key(const char (&path)[N]) noexcept
+{
+    return asset_key(path, N - 1);
+}
+} // namespace ff
+#endif
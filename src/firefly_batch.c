@@ -0,0 +1,390 @@
+/// @file
+/// @brief The implementation of drawing batches. See firefly_batch.h.
+
+#include "firefly_batch.h"
+#include <string.h>
+
+/// @private
+/// @brief A recorded command and the canvas it targets.
+struct _ffBatchEntry
+{
+    DrawCmd cmd;
+    /// @brief The target canvas, NULL for the screen, _FF_BATCH_START if unknown.
+    char *target;
+};
+
+/// @private
+/// @brief The target of commands recorded before the first set_canvas or unset_canvas.
+static char _ff_batch_start_target;
+#define _FF_BATCH_START (&_ff_batch_start_target)
+
+/// @private
+/// @brief The marker of commands dropped by the optimizer.
+#define _FF_DROPPED ((DrawOp)-1)
+
+/// @private
+/// @brief How many targets the overdraw pass tracks at once.
+#define _FF_BATCH_TARGETS 4
+
+/// @private
+/// @brief How many opaque rectangles per target the overdraw pass tracks at once.
+#define _FF_BATCH_COVERS 8
+
+/// @private
+/// @brief How far back the deduplication pass looks for an identical command.
+#define _FF_BATCH_DEDUP_WINDOW 16
+
+/// @private
+static DrawBatch *_ff_batch = 0;
+
+/// @private
+/// @brief The current target while recording.
+static char *_ff_batch_target = _FF_BATCH_START;
+
+/// @private
+static bool _ff_batch_invisible(int32_t fill, int32_t stroke, int32_t width)
+{
+    return fill == NONE && (stroke == NONE || width <= 0);
+}
+
+/// @private
+/// @brief Check if the command is known not to change any pixel.
+static bool _ff_batch_is_dead(const DrawCmd *cmd)
+{
+    const int32_t *a = cmd->args;
+    switch (cmd->op)
+    {
+    case DRAW_POINT:
+        return a[2] == NONE;
+    case DRAW_LINE:
+        return a[4] == NONE || a[5] <= 0;
+    case DRAW_RECT:
+    case DRAW_ELLIPSE:
+        return a[2] <= 0 || a[3] <= 0 || _ff_batch_invisible(a[4], a[5], a[6]);
+    case DRAW_ROUNDED_RECT:
+        return a[2] <= 0 || a[3] <= 0 || _ff_batch_invisible(a[6], a[7], a[8]);
+    case DRAW_CIRCLE:
+        return a[2] <= 0 || _ff_batch_invisible(a[3], a[4], a[5]);
+    case DRAW_TRIANGLE:
+        return _ff_batch_invisible(a[6], a[7], a[8]);
+    case DRAW_ARC:
+        return a[2] <= 0 || a[6] == NONE || a[7] <= 0;
+    case DRAW_SECTOR:
+        return a[2] <= 0 || _ff_batch_invisible(a[5], a[6], a[7]);
+    case DRAW_TEXT:
+        return a[3] == 0 || a[2] == NONE;
+    case DRAW_QR:
+        return a[2] == NONE && a[3] == NONE;
+    case DRAW_IMAGE:
+        return a[2] == 0;
+    case DRAW_SUB_IMAGE:
+        return a[4] <= 0 || a[5] <= 0;
+    default:
+        return false;
+    }
+}
+
+/// @private
+/// @brief Check if the command paints every pixel of its bounding box.
+static bool _ff_batch_is_opaque(const DrawCmd *cmd)
+{
+    const int32_t *a = cmd->args;
+    return cmd->op == DRAW_RECT && a[4] != NONE && (a[6] <= 0 || a[5] != NONE);
+}
+
+/// @private
+static bool _ff_batch_is_target_switch(const DrawCmd *cmd)
+{
+    return cmd->op == DRAW_SET_CANVAS || cmd->op == DRAW_UNSET_CANVAS;
+}
+
+/// @private
+/// @brief Known occluders of a single target, collected while walking backwards.
+struct _ffBatchTarget
+{
+    char *target;
+    bool cleared;
+    int32_t covers_len;
+    Rect covers[_FF_BATCH_COVERS];
+};
+
+/// @private
+/// @brief Drop commands that are drawn over later on the same target.
+static void _ff_batch_drop_overdrawn(DrawBatch *b)
+{
+    struct _ffBatchEntry *entries = (struct _ffBatchEntry *)b->cmds;
+    struct _ffBatchTarget targets[_FF_BATCH_TARGETS];
+    int32_t targets_len = 0;
+    for (size_t i = b->len; i-- > 0;)
+    {
+        struct _ffBatchEntry *e = &entries[i];
+        DrawCmd *cmd = &e->cmd;
+        if (cmd->op == _FF_DROPPED || _ff_batch_is_target_switch(cmd))
+        {
+            continue;
+        }
+
+        // Reading a canvas makes its earlier content observable.
+        if (cmd->op == DRAW_IMAGE || cmd->op == DRAW_SUB_IMAGE)
+        {
+            for (int32_t t = 0; t < targets_len; t++)
+            {
+                if (targets[t].target == cmd->ptr)
+                {
+                    targets[t].cleared = false;
+                    targets[t].covers_len = 0;
+                }
+            }
+        }
+
+        struct _ffBatchTarget *target = 0;
+        for (int32_t t = 0; t < targets_len; t++)
+        {
+            if (targets[t].target == e->target)
+            {
+                target = &targets[t];
+            }
+        }
+        if (target == 0)
+        {
+            if (targets_len == _FF_BATCH_TARGETS)
+            {
+                continue;
+            }
+            target = &targets[targets_len++];
+            target->target = e->target;
+            target->cleared = false;
+            target->covers_len = 0;
+        }
+
+        if (target->cleared)
+        {
+            cmd->op = _FF_DROPPED;
+            b->stats.overdrawn++;
+            continue;
+        }
+        Rect bounds;
+        bool bounded = draw_cmd_bounds(cmd, &bounds);
+        if (bounded)
+        {
+            bool covered = false;
+            for (int32_t c = 0; c < target->covers_len && !covered; c++)
+            {
+                covered = rect_contains(target->covers[c], bounds);
+            }
+            if (covered)
+            {
+                cmd->op = _FF_DROPPED;
+                b->stats.overdrawn++;
+                continue;
+            }
+        }
+
+        if (cmd->op == DRAW_CLEAR_SCREEN && cmd->args[0] != NONE)
+        {
+            target->cleared = true;
+        }
+        else if (bounded && _ff_batch_is_opaque(cmd))
+        {
+            // When full, replace the smallest known cover.
+            int32_t slot = target->covers_len;
+            if (slot == _FF_BATCH_COVERS)
+            {
+                slot = 0;
+                for (int32_t c = 1; c < _FF_BATCH_COVERS; c++)
+                {
+                    Size s = target->covers[c].size;
+                    Size m = target->covers[slot].size;
+                    if (s.width * s.height < m.width * m.height)
+                    {
+                        slot = c;
+                    }
+                }
+            }
+            else
+            {
+                target->covers_len++;
+            }
+            target->covers[slot] = bounds;
+        }
+    }
+}
+
+/// @private
+static bool _ff_batch_same(const DrawCmd *a, const DrawCmd *b)
+{
+    return a->op == b->op && a->ptr == b->ptr && a->ptr2 == b->ptr2 &&
+           memcmp(a->args, b->args, sizeof(a->args)) == 0;
+}
+
+/// @private
+/// @brief Drop commands that repeat an earlier command not drawn over since.
+static void _ff_batch_drop_duplicates(DrawBatch *b)
+{
+    struct _ffBatchEntry *entries = (struct _ffBatchEntry *)b->cmds;
+    for (size_t j = 1; j < b->len; j++)
+    {
+        struct _ffBatchEntry *e = &entries[j];
+        Rect bounds;
+        if (e->cmd.op == _FF_DROPPED || !draw_cmd_bounds(&e->cmd, &bounds))
+        {
+            continue;
+        }
+        int32_t seen = 0;
+        for (size_t i = j; i-- > 0 && seen < _FF_BATCH_DEDUP_WINDOW;)
+        {
+            struct _ffBatchEntry *prev = &entries[i];
+            if (prev->cmd.op == _FF_DROPPED || _ff_batch_is_target_switch(&prev->cmd))
+            {
+                continue;
+            }
+            // The canvas drawn by the command has changed since.
+            if (prev->target == e->cmd.ptr && e->cmd.ptr != 0)
+            {
+                break;
+            }
+            if (prev->target != e->target)
+            {
+                continue;
+            }
+            seen++;
+            if (_ff_batch_same(&prev->cmd, &e->cmd))
+            {
+                e->cmd.op = _FF_DROPPED;
+                b->stats.duplicates++;
+                break;
+            }
+            Rect other;
+            if (!draw_cmd_bounds(&prev->cmd, &other) || rect_intersects(other, bounds))
+            {
+                break;
+            }
+        }
+    }
+}
+
+/// @private
+static void _ff_batch_exec(DrawBatch *b, const DrawCmd *cmd)
+{
+    if (b->prev)
+    {
+        b->prev(cmd);
+    }
+    else
+    {
+        exec_draw_cmd(cmd);
+    }
+}
+
+/// @private
+static void _ff_batch_hook(const DrawCmd *cmd)
+{
+    DrawBatch *b = _ff_batch;
+    if (b->len == b->cap)
+    {
+        batch_flush(b);
+    }
+    b->stats.recorded++;
+    if (_ff_batch_is_dead(cmd))
+    {
+        b->stats.dead++;
+        return;
+    }
+    if (cmd->op == DRAW_SET_CANVAS)
+    {
+        _ff_batch_target = cmd->ptr;
+    }
+    else if (cmd->op == DRAW_UNSET_CANVAS)
+    {
+        _ff_batch_target = 0;
+    }
+    if (b->cap == 0)
+    {
+        _ff_batch_exec(b, cmd);
+        b->stats.replayed++;
+        return;
+    }
+    struct _ffBatchEntry *entries = (struct _ffBatchEntry *)b->cmds;
+    entries[b->len].cmd = *cmd;
+    entries[b->len].target = _ff_batch_target;
+    b->len++;
+}
+
+/// @brief Start recording all drawing operations into the given storage.
+///
+/// @details The storage must stay alive until batch_end.
+/// If it gets full, the recorded commands are flushed automatically.
+/// Only one batch can be active at a time.
+void batch_begin(DrawBatch *b, Buffer storage)
+{
+    uintptr_t head = (uintptr_t)storage.head;
+    uintptr_t align = _Alignof(struct _ffBatchEntry);
+    uintptr_t aligned = (head + align - 1) & ~(align - 1);
+    size_t skip = aligned - head;
+    b->cmds = (DrawCmd *)aligned;
+    b->cap = storage.size > skip ? (storage.size - skip) / sizeof(struct _ffBatchEntry) : 0;
+    b->len = 0;
+    memset(&b->stats, 0, sizeof(b->stats));
+    _ff_batch = b;
+    _ff_batch_target = _FF_BATCH_START;
+    b->prev = set_draw_hook(_ff_batch_hook);
+}
+
+/// @brief Optimize the recorded commands and send them to the host.
+///
+/// @details The batch stays active, following drawing operations
+/// will be recorded again.
+void batch_flush(DrawBatch *b)
+{
+    struct _ffBatchEntry *entries = (struct _ffBatchEntry *)b->cmds;
+    _ff_batch_drop_overdrawn(b);
+    _ff_batch_drop_duplicates(b);
+
+    // Switch the target lazily to skip canvases nothing is drawn on.
+    char *host = _FF_BATCH_START;
+    const DrawCmd *pending = 0;
+    for (size_t i = 0; i < b->len; i++)
+    {
+        const DrawCmd *cmd = &entries[i].cmd;
+        if (cmd->op == _FF_DROPPED)
+        {
+            continue;
+        }
+        if (_ff_batch_is_target_switch(cmd))
+        {
+            pending = cmd;
+            continue;
+        }
+        if (pending != 0 && entries[i].target != host)
+        {
+            _ff_batch_exec(b, pending);
+            b->stats.replayed++;
+            host = entries[i].target;
+        }
+        pending = 0;
+        _ff_batch_exec(b, cmd);
+        b->stats.replayed++;
+    }
+    if (pending != 0 && _ff_batch_target != host)
+    {
+        _ff_batch_exec(b, pending);
+        b->stats.replayed++;
+    }
+    b->len = 0;
+    b->stats.flushes++;
+    _ff_batch_target = _FF_BATCH_START;
+}
+
+/// @brief Flush the recorded commands and stop recording.
+void batch_end(DrawBatch *b)
+{
+    batch_flush(b);
+    set_draw_hook(b->prev);
+    _ff_batch = 0;
+}
+
+/// @brief Reset the batch statistics, typically at the start of a frame.
+void batch_reset_stats(DrawBatch *b)
+{
+    memset(&b->stats, 0, sizeof(b->stats));
+}
@@ -0,0 +1,59 @@
+/// @file
+/// @brief Recording, optimizing, and replaying drawing operations in batches.
+///
+/// @details While a DrawBatch is active, all drawing functions
+/// (draw_rect, clear_screen, etc) append a DrawCmd into the batch storage
+/// instead of calling the host. On flush, the batch drops the commands
+/// that cannot change the frame and replays the rest:
+///
+/// * dead commands: zero-size shapes, transparent (NONE) styles, empty text;
+/// * overdrawn commands: everything drawn before a later clear_screen
+///   or fully covered by a later opaque rectangle on the same target;
+/// * duplicates: a command identical to an earlier one with nothing
+///   drawn over it in between.
+///
+/// Text, font, and image buffers passed into drawing functions
+/// must stay alive and unchanged until the batch is flushed.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief Counters of what happened to the recorded commands.
+struct BatchStats
+{
+    /// @brief The number of commands recorded.
+    uint32_t recorded;
+    /// @brief The number of commands dropped because they don't draw anything.
+    uint32_t dead;
+    /// @brief The number of commands dropped because they are drawn over later.
+    uint32_t overdrawn;
+    /// @brief The number of commands dropped as duplicates of an earlier command.
+    uint32_t duplicates;
+    /// @brief The number of commands sent to the host.
+    uint32_t replayed;
+    /// @brief The number of flushes, including ones caused by a full storage.
+    uint32_t flushes;
+};
+typedef struct BatchStats BatchStats;
+
+/// @brief A recording of drawing operations.
+struct DrawBatch
+{
+    /// @private
+    DrawCmd *cmds;
+    /// @private
+    size_t len;
+    /// @private
+    size_t cap;
+    /// @private
+    DrawHook prev;
+    /// @brief Statistics accumulated since batch_begin or batch_reset_stats.
+    BatchStats stats;
+};
+typedef struct DrawBatch DrawBatch;
+
+void batch_begin(DrawBatch *b, Buffer storage);
+void batch_flush(DrawBatch *b);
+void batch_end(DrawBatch *b);
+void batch_reset_stats(DrawBatch *b);
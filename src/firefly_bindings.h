@@ -5,7 +5,24 @@
 
 #include <stdint.h>
 
+#ifdef __wasm__
 #define WASM_IMPORT(MOD, NAME) __attribute__((import_module(MOD), import_name(NAME)))
+#define WASM_EXPORT(NAME) __attribute__((export_name(NAME)))
+#else
+// Native builds (see firefly_native.c) resolve the imports at link time
+// and look up the callbacks by their C function names.
+#define WASM_IMPORT(MOD, NAME)
+#ifdef __cplusplus
+#define WASM_EXPORT(NAME) extern "C"
+#else
+#define WASM_EXPORT(NAME)
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
 
 // -- GRAPHICS -- //
 
@@ -224,3 +241,7 @@ void _ffba_reset_all(uint32_t nodeID);
 
 WASM_IMPORT("audio", "clear")
 void _ffba_clear(uint32_t nodeID);
+
+#ifdef __cplusplus
+}
+#endif
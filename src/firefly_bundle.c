@@ -0,0 +1,88 @@
+/// @file
+/// @brief The implementation of asset bundles. See firefly_bundle.h.
+
+#include "firefly_bundle.h"
+
+/// @private
+static uint32_t _ff_bundle_u32(const char *p)
+{
+    const uint8_t *b = (const uint8_t *)p;
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+/// @brief Check the bundle loaded into memory and prepare it for lookups.
+/// @details The data must stay alive while the bundle and the assets from it are used.
+/// For an invalid bundle, the count is zero and all lookups fail.
+Bundle open_bundle(File data)
+{
+    Bundle b = {data, 0};
+    if (data.head == 0 || data.size < BUNDLE_HEADER_SIZE)
+    {
+        return b;
+    }
+    const char *h = data.head;
+    if (h[0] != 'F' || h[1] != 'F' || h[2] != 'B' || h[3] != '1')
+    {
+        return b;
+    }
+    uint32_t count = _ff_bundle_u32(h + 4);
+    if (count > (data.size - BUNDLE_HEADER_SIZE) / BUNDLE_ENTRY_SIZE)
+    {
+        return b;
+    }
+    // Validate all entries once, so lookups don't need to.
+    const char *index = h + BUNDLE_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const char *e = index + i * BUNDLE_ENTRY_SIZE;
+        uint32_t offset = _ff_bundle_u32(e + 4);
+        uint32_t size = _ff_bundle_u32(e + 8);
+        if (offset > data.size || size > data.size - offset)
+        {
+            return b;
+        }
+        if (i > 0 && _ff_bundle_u32(e - BUNDLE_ENTRY_SIZE) >= _ff_bundle_u32(e))
+        {
+            return b;
+        }
+    }
+    b.count = count;
+    return b;
+}
+
+/// @brief Get the asset with the given path hash. Returns an empty file if there is none.
+File bundle_get_hash(const Bundle *b, uint32_t hash)
+{
+    File f = {0, 0};
+    const char *index = b->data.head + BUNDLE_HEADER_SIZE;
+    uint32_t lo = 0;
+    uint32_t hi = b->count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const char *e = index + mid * BUNDLE_ENTRY_SIZE;
+        uint32_t h = _ff_bundle_u32(e);
+        if (h == hash)
+        {
+            f.head = b->data.head + _ff_bundle_u32(e + 4);
+            f.size = _ff_bundle_u32(e + 8);
+            return f;
+        }
+        if (h < hash)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return f;
+}
+
+/// @brief Get the asset at the given path. Returns an empty file if there is none.
+/// @details The returned File (or Image, or Font) points into the bundle memory.
+File bundle_get(const Bundle *b, AssetKey key)
+{
+    return bundle_get_hash(b, key.hash);
+}
@@ -0,0 +1,43 @@
+/// @file
+/// @brief Many assets packed into a single ROM file.
+///
+/// @details A bundle is loaded with a single load_file call, and the assets
+/// in it are returned as buffers pointing straight into the bundle memory,
+/// without copying. Build bundles with the packer in tools/ffpack.c.
+///
+/// The format, all numbers are little-endian uint32:
+///
+/// * header: magic "FFB1", the number of assets;
+/// * index: for every asset, its path hash, offset, and size,
+///   sorted by the hash. The offset is from the bundle start;
+/// * payloads: the asset contents, each aligned to 4 bytes.
+///
+/// The hash is the FNV-1a of the path, the same as asset_key computes.
+/// Paths themselves are not stored, the packer rejects hash collisions.
+///
+/// Build firefly_assets.c as well.
+
+#pragma once
+
+#include "firefly.h"
+#include "firefly_assets.h"
+
+/// @brief The size of the bundle header, in bytes.
+#define BUNDLE_HEADER_SIZE 8
+
+/// @brief The size of a single index entry, in bytes.
+#define BUNDLE_ENTRY_SIZE 12
+
+/// @brief A loaded bundle.
+struct Bundle
+{
+    /// @brief The whole bundle file.
+    File data;
+    /// @brief The number of assets in the bundle. Zero if the bundle is invalid.
+    uint32_t count;
+};
+typedef struct Bundle Bundle;
+
+Bundle open_bundle(File data);
+File bundle_get(const Bundle *b, AssetKey key);
+File bundle_get_hash(const Bundle *b, uint32_t hash);
@@ -0,0 +1,127 @@
+/// @file
+/// @brief The implementation of the camera. See firefly_camera.h.
+
+#include "firefly_camera.h"
+#include <string.h>
+
+/// @private
+static Camera *_ff_camera = 0;
+
+/// @private
+static void _ff_camera_hook(const DrawCmd *cmd)
+{
+    Camera *c = _ff_camera;
+    DrawCmd moved = *cmd;
+    switch (cmd->op)
+    {
+    case DRAW_SET_CANVAS:
+        c->on_canvas = true;
+        break;
+    case DRAW_UNSET_CANVAS:
+        c->on_canvas = false;
+        break;
+    case DRAW_CLEAR_SCREEN:
+        break;
+    default:
+    {
+        if (c->on_canvas)
+        {
+            break;
+        }
+        int32_t dx = c->viewport.point.x - c->position.x;
+        int32_t dy = c->viewport.point.y - c->position.y;
+        int32_t points = 1;
+        if (cmd->op == DRAW_LINE)
+        {
+            points = 2;
+        }
+        else if (cmd->op == DRAW_TRIANGLE)
+        {
+            points = 3;
+        }
+        for (int32_t i = 0; i < points; i++)
+        {
+            moved.args[2 * i] += dx;
+            moved.args[2 * i + 1] += dy;
+        }
+        c->stats.submitted++;
+        Rect bounds;
+        if (draw_cmd_bounds(&moved, &bounds) && !rect_intersects(bounds, c->viewport))
+        {
+            c->stats.culled++;
+            c->stats.culled_by_op[cmd->op]++;
+            return;
+        }
+    }
+    }
+    if (c->prev)
+    {
+        c->prev(&moved);
+    }
+    else
+    {
+        exec_draw_cmd(&moved);
+    }
+}
+
+/// @brief Create a camera looking at the given world point and covering the whole screen.
+Camera new_camera(Point position)
+{
+    Camera c;
+    memset(&c, 0, sizeof(c));
+    c.position = position;
+    c.viewport.size.width = WIDTH;
+    c.viewport.size.height = HEIGHT;
+    return c;
+}
+
+/// @brief Make all subsequent drawing operations use world coordinates.
+///
+/// @details The camera position and viewport can be changed while it is active.
+/// Only one camera can be active at a time.
+void camera_begin(Camera *c)
+{
+    _ff_camera = c;
+    c->on_canvas = false;
+    c->prev = set_draw_hook(_ff_camera_hook);
+}
+
+/// @brief Make all subsequent drawing operations use screen coordinates again.
+/// @details Useful for drawing HUD on top of the world.
+void camera_end(Camera *c)
+{
+    set_draw_hook(c->prev);
+    _ff_camera = 0;
+}
+
+/// @brief Reset the camera statistics, typically at the start of a frame.
+void camera_reset_stats(Camera *c)
+{
+    memset(&c->stats, 0, sizeof(c->stats));
+}
+
+/// @brief Convert a point in the world into a point on the screen.
+Point world_to_screen(const Camera *c, Point p)
+{
+    Point r = {
+        .x = p.x - c->position.x + c->viewport.point.x,
+        .y = p.y - c->position.y + c->viewport.point.y};
+    return r;
+}
+
+/// @brief Convert a point on the screen (like a touch) into a point in the world.
+Point screen_to_world(const Camera *c, Point p)
+{
+    Point r = {
+        .x = p.x + c->position.x - c->viewport.point.x,
+        .y = p.y + c->position.y - c->viewport.point.y};
+    return r;
+}
+
+/// @brief Check if any part of the given world region is visible.
+/// @details Useful to skip updating or assembling whole groups of objects.
+bool camera_sees(const Camera *c, Rect world)
+{
+    Rect screen = {world_to_screen(c, world.point), world.size};
+    return rect_intersects(screen, c->viewport);
+}
@@ -0,0 +1,51 @@
+/// @file
+/// @brief A camera mapping world coordinates to the screen and culling invisible primitives.
+///
+/// @details While a Camera is active, all drawing functions take world coordinates.
+/// The camera moves every primitive into screen space and skips
+/// the host call for primitives that are fully outside of the viewport.
+///
+/// Only the drawing on the screen is affected. Between set_canvas and unset_canvas
+/// the coordinates are passed to the host as is.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief Counters of primitives seen by the camera.
+struct CameraStats
+{
+    /// @brief The number of primitives submitted while the camera was active.
+    uint32_t submitted;
+    /// @brief The number of primitives skipped because they are not in the viewport.
+    uint32_t culled;
+    /// @brief The number of culled primitives of each kind, indexed by DrawOp.
+    uint32_t culled_by_op[DRAW_UNSET_CANVAS + 1];
+};
+typedef struct CameraStats CameraStats;
+
+/// @brief A view into a world bigger than the screen.
+struct Camera
+{
+    /// @brief The world point shown in the upper-left corner of the viewport.
+    Point position;
+    /// @brief The region of the screen the world is shown in.
+    /// @details Use the whole screen ({0, 0}, {WIDTH, HEIGHT}) unless
+    /// a part of it is reserved for HUD.
+    Rect viewport;
+    /// @brief Statistics accumulated since camera_begin or camera_reset_stats.
+    CameraStats stats;
+    /// @private
+    DrawHook prev;
+    /// @private
+    bool on_canvas;
+};
+typedef struct Camera Camera;
+
+Camera new_camera(Point position);
+void camera_begin(Camera *c);
+void camera_end(Camera *c);
+void camera_reset_stats(Camera *c);
+Point world_to_screen(const Camera *c, Point p);
+Point screen_to_world(const Camera *c, Point p);
+bool camera_sees(const Camera *c, Rect world);
@@ -0,0 +1,482 @@
+/// @file
+/// @brief The implementation of the software rasterizer. See firefly_canvas.h.
+
+#include "firefly_canvas.h"
+#include "firefly_simd.h"
+#include <string.h>
+
+/// @private
+/// @brief The size of the header of a 4 BPP image: magic, BPP, width, transparency, swaps.
+#define _FF_CANVAS_HEADER 13
+
+/// @private
+/// @brief The pixel data of a canvas.
+struct _ffCanvasView
+{
+    uint8_t *pixels;
+    int32_t width;
+    int32_t height;
+    /// @brief The number of bytes in a row.
+    int32_t stride;
+};
+
+/// @private
+static bool _ff_canvas_view(Canvas c, struct _ffCanvasView *v)
+{
+    uint8_t *raw = (uint8_t *)c.head;
+    if (c.size < _FF_CANVAS_HEADER || raw[0] != 0x21 || raw[1] != 4)
+    {
+        return false;
+    }
+    Size s = image_size(c);
+    // Rows are byte-aligned only for even widths.
+    if (s.width == 0 || s.width % 2 != 0)
+    {
+        return false;
+    }
+    v->pixels = raw + _FF_CANVAS_HEADER;
+    v->width = s.width;
+    v->height = s.height;
+    v->stride = s.width / 2;
+    return true;
+}
+
+/// @private
+static void _ff_canvas_put(const struct _ffCanvasView *v, int32_t x, int32_t y, uint8_t value)
+{
+    uint8_t *byte = v->pixels + y * v->stride + x / 2;
+    if (x % 2 == 0)
+    {
+        *byte = (*byte & 0x0f) | (value << 4);
+    }
+    else
+    {
+        *byte = (*byte & 0xf0) | value;
+    }
+}
+
+/// @private
+/// @brief Fill a clipped horizontal span from x0 to x1 (exclusive).
+static void _ff_canvas_span(const struct _ffCanvasView *v, int32_t x0, int32_t x1, int32_t y, uint8_t value)
+{
+    x0 = x0 < 0 ? 0 : x0;
+    x1 = x1 > v->width ? v->width : x1;
+    if (y < 0 || y >= v->height || x0 >= x1)
+    {
+        return;
+    }
+    if (x0 % 2 != 0)
+    {
+        _ff_canvas_put(v, x0, y, value);
+        x0++;
+    }
+    if (x1 % 2 != 0 && x1 > x0)
+    {
+        x1--;
+        _ff_canvas_put(v, x1, y, value);
+    }
+    if (x1 > x0)
+    {
+        packed_fill(v->pixels + y * v->stride + x0 / 2, (x1 - x0) / 2, value);
+    }
+}
+
+/// @private
+/// @brief The integer square root, rounded down.
+static int32_t _ff_isqrt(int64_t n)
+{
+    int64_t r = 0;
+    int64_t bit = (int64_t)1 << 40;
+    while (bit > n)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (n >= r + bit)
+        {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (int32_t)r;
+}
+
+/// @brief The number of bytes needed for a canvas of the given size.
+size_t canvas_buffer_size(Size s)
+{
+    return _FF_CANVAS_HEADER + (size_t)s.width * s.height / 2;
+}
+
+/// @brief Create a canvas of the given size in the given buffer.
+///
+/// @details The width must be even and the buffer must be at least
+/// canvas_buffer_size bytes long. Otherwise, an empty Canvas is returned.
+/// The canvas has the default palette, no transparency, and all pixels black.
+Canvas new_canvas(Buffer buf, Size s)
+{
+    Canvas c = {0, buf.head};
+    size_t size = canvas_buffer_size(s);
+    if (s.width <= 0 || s.height <= 0 || s.width % 2 != 0 || s.width > 0xffff || buf.size < size)
+    {
+        return c;
+    }
+    uint8_t *raw = (uint8_t *)buf.head;
+    raw[0] = 0x21;
+    raw[1] = 4;
+    raw[2] = (uint8_t)s.width;
+    raw[3] = (uint8_t)(s.width >> 8);
+    raw[4] = 0xff;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        raw[5 + i] = ((i * 2) << 4) | (i * 2 + 1);
+    }
+    memset(raw + _FF_CANVAS_HEADER, 0, size - _FF_CANVAS_HEADER);
+    c.size = size;
+    return c;
+}
+
+/// @brief Set the color that is not drawn when the canvas is drawn as an image.
+/// @details Pass NONE to make the canvas fully opaque.
+void canvas_set_transparent(Canvas c, Color t)
+{
+    if (c.size >= _FF_CANVAS_HEADER)
+    {
+        c.head[4] = t == NONE ? 0xff : t - 1;
+    }
+}
+
+/// @brief Fill the whole canvas with the given color.
+void canvas_clear(Canvas c, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    packed_fill(v.pixels, (size_t)v.stride * v.height, color - 1);
+}
+
+/// @brief Set a single pixel.
+void canvas_point(Canvas c, Point p, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    if (p.x >= 0 && p.y >= 0 && p.x < v.width && p.y < v.height)
+    {
+        _ff_canvas_put(&v, p.x, p.y, color - 1);
+    }
+}
+
+/// @brief Set many pixels of the same color, like particles.
+void canvas_points(Canvas c, const Point *points, size_t len, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    uint8_t value = color - 1;
+    for (size_t i = 0; i < len; i++)
+    {
+        // Negative coordinates become huge when unsigned, so one check covers both sides.
+        Point p = points[i];
+        if ((uint32_t)p.x < (uint32_t)v.width && (uint32_t)p.y < (uint32_t)v.height)
+        {
+            _ff_canvas_put(&v, p.x, p.y, value);
+        }
+    }
+}
+
+/// @brief Draw a horizontal line of the given length starting at the given point.
+void canvas_hline(Canvas c, Point p, int32_t len, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || len <= 0 || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    _ff_canvas_span(&v, p.x, p.x + len, p.y, color - 1);
+}
+
+/// @brief Fill a rectangle.
+void canvas_rect(Canvas c, Point p, Size s, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    int32_t y0 = p.y < 0 ? 0 : p.y;
+    int32_t y1 = p.y + s.height > v.height ? v.height : p.y + s.height;
+    for (int32_t y = y0; y < y1; y++)
+    {
+        _ff_canvas_span(&v, p.x, p.x + s.width, y, color - 1);
+    }
+}
+
+/// @brief Draw a 1 pixel wide straight line from point a to point b.
+void canvas_line(Canvas c, Point a, Point b, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    if (a.y == b.y)
+    {
+        int32_t x0 = a.x < b.x ? a.x : b.x;
+        int32_t x1 = a.x < b.x ? b.x : a.x;
+        _ff_canvas_span(&v, x0, x1 + 1, a.y, color - 1);
+        return;
+    }
+    int32_t dx = b.x > a.x ? b.x - a.x : a.x - b.x;
+    int32_t dy = b.y > a.y ? a.y - b.y : b.y - a.y;
+    int32_t sx = a.x < b.x ? 1 : -1;
+    int32_t sy = a.y < b.y ? 1 : -1;
+    int32_t err = dx + dy;
+    int32_t x = a.x;
+    int32_t y = a.y;
+    for (;;)
+    {
+        if ((uint32_t)x < (uint32_t)v.width && (uint32_t)y < (uint32_t)v.height)
+        {
+            _ff_canvas_put(&v, x, y, color - 1);
+        }
+        if (x == b.x && y == b.y)
+        {
+            return;
+        }
+        int32_t e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+/// @brief Fill a circle with the given diameter.
+/// @details Like with draw_circle, the point is the upper-left corner of the bounding box.
+void canvas_circle(Canvas c, Point p, int32_t d, Color color)
+{
+    struct _ffCanvasView v;
+    if (color == NONE || d <= 0 || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    // In doubled coordinates, the pixel i of a row is inside
+    // if (2i + 1 - d)^2 + dy^2 <= d^2.
+    int64_t r2 = (int64_t)d * d;
+    for (int32_t row = 0; row < d; row++)
+    {
+        int32_t y = p.y + row;
+        if (y < 0 || y >= v.height)
+        {
+            continue;
+        }
+        int64_t dy = 2 * row + 1 - d;
+        int32_t s = _ff_isqrt(r2 - dy * dy);
+        int32_t skip = (d - s) / 2;
+        _ff_canvas_span(&v, p.x + skip, p.x + d - skip, y, color - 1);
+    }
+}
+
+/// @private
+/// @brief Copy a region of an image into the canvas, skipping transparent pixels.
+static void _ff_canvas_blit(Canvas c, Image i, Point p, Point src, Size size)
+{
+    struct _ffCanvasView v;
+    uint8_t *raw = (uint8_t *)i.head;
+    Size is = image_size(i);
+    if (is.width == 0 || !_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    int32_t bpp = raw[1];
+    uint8_t transparent = raw[4];
+    uint8_t *swaps = raw + 5;
+    uint8_t *pixels = raw + 5 + (1 << bpp) / 2;
+    uint8_t mask = (1 << bpp) - 1;
+
+    // The palette index for every pixel value, 0xff for transparent.
+    uint8_t colors[16];
+    bool identity = true;
+    for (int32_t value = 0; value <= mask; value++)
+    {
+        uint8_t swap = swaps[value / 2];
+        uint8_t color = value % 2 == 0 ? swap >> 4 : swap & 0xf;
+        identity = identity && color == value;
+        colors[value] = color == transparent ? 0xff : color;
+    }
+
+    // Clip the source region to the image and the destination to the canvas.
+    if (src.x < 0 || src.y < 0)
+    {
+        return;
+    }
+    int32_t w = size.width;
+    int32_t h = size.height;
+    w = src.x + w > is.width ? is.width - src.x : w;
+    h = src.y + h > is.height ? is.height - src.y : h;
+    int32_t skipX = p.x < 0 ? -p.x : 0;
+    int32_t skipY = p.y < 0 ? -p.y : 0;
+    w = p.x + w > v.width ? v.width - p.x : w;
+    h = p.y + h > v.height ? v.height - p.y : h;
+
+    // If both sides are byte-aligned, whole bytes can be blitted at once.
+    // Rows of images with odd width start mid-byte on every other row.
+    int32_t x0 = skipX;
+    if (bpp == 4 && is.width % 2 == 0 && src.x % 2 == 0 && p.x % 2 == 0 && w - skipX >= 2)
+    {
+        size_t bytes = (size_t)(w - skipX) / 2;
+        uint8_t lut[16];
+        for (int32_t value = 0; value < 16; value++)
+        {
+            lut[value] = colors[value] == 0xff ? transparent : colors[value];
+        }
+        for (int32_t y = skipY; y < h; y++)
+        {
+            uint8_t *from = pixels + ((size_t)(src.y + y) * is.width + src.x + skipX) / 2;
+            uint8_t *to = v.pixels + (size_t)(p.y + y) * v.stride + (p.x + skipX) / 2;
+            if (identity)
+            {
+                packed_blit(to, from, bytes, transparent);
+                continue;
+            }
+            uint8_t chunk[64];
+            for (size_t done = 0; done < bytes; done += sizeof(chunk))
+            {
+                size_t n = bytes - done < sizeof(chunk) ? bytes - done : sizeof(chunk);
+                packed_remap(chunk, from + done, n, lut);
+                packed_blit(to + done, chunk, n, transparent);
+            }
+        }
+        x0 = skipX + (int32_t)bytes * 2;
+    }
+
+    for (int32_t y = skipY; y < h; y++)
+    {
+        size_t bit = ((size_t)(src.y + y) * is.width + src.x + x0) * bpp;
+        for (int32_t x = x0; x < w; x++)
+        {
+            uint8_t value = (pixels[bit / 8] >> (8 - bpp - bit % 8)) & mask;
+            bit += bpp;
+            uint8_t color = colors[value];
+            if (color != 0xff)
+            {
+                _ff_canvas_put(&v, p.x + x, p.y + y, color);
+            }
+        }
+    }
+}
+
+/// @brief Draw an image on the canvas.
+/// @details The image may have any bits per pixel. Transparent pixels are skipped.
+void canvas_blit(Canvas c, Image i, Point p)
+{
+    Point src = {0, 0};
+    _ff_canvas_blit(c, i, p, src, image_size(i));
+}
+
+/// @brief Draw an image subregion on the canvas.
+void canvas_blit_sub(Canvas c, SubImage s, Point p)
+{
+    _ff_canvas_blit(c, s.image, p, s.point, s.size);
+}
+
+/// @brief Copy a region of another canvas into this canvas, including transparent pixels.
+void canvas_copy(Canvas c, Point p, Canvas src, Rect r)
+{
+    struct _ffCanvasView to;
+    struct _ffCanvasView from;
+    if (!_ff_canvas_view(c, &to) || !_ff_canvas_view(src, &from))
+    {
+        return;
+    }
+    // Clip the region to both canvases.
+    if (r.point.x < 0)
+    {
+        p.x -= r.point.x;
+        r.size.width += r.point.x;
+        r.point.x = 0;
+    }
+    if (r.point.y < 0)
+    {
+        p.y -= r.point.y;
+        r.size.height += r.point.y;
+        r.point.y = 0;
+    }
+    if (p.x < 0)
+    {
+        r.point.x -= p.x;
+        r.size.width += p.x;
+        p.x = 0;
+    }
+    if (p.y < 0)
+    {
+        r.point.y -= p.y;
+        r.size.height += p.y;
+        p.y = 0;
+    }
+    int32_t w = r.size.width;
+    int32_t h = r.size.height;
+    w = r.point.x + w > from.width ? from.width - r.point.x : w;
+    w = p.x + w > to.width ? to.width - p.x : w;
+    h = r.point.y + h > from.height ? from.height - r.point.y : h;
+    h = p.y + h > to.height ? to.height - p.y : h;
+    if (w <= 0 || h <= 0)
+    {
+        return;
+    }
+    bool aligned = r.point.x % 2 == 0 && p.x % 2 == 0;
+    for (int32_t y = 0; y < h; y++)
+    {
+        uint8_t *srcRow = from.pixels + (size_t)(r.point.y + y) * from.stride;
+        int32_t x = 0;
+        if (aligned)
+        {
+            uint8_t *dstRow = to.pixels + (size_t)(p.y + y) * to.stride;
+            packed_copy(dstRow + p.x / 2, srcRow + r.point.x / 2, (size_t)w / 2);
+            x = w / 2 * 2;
+        }
+        for (; x < w; x++)
+        {
+            int32_t sx = r.point.x + x;
+            uint8_t byte = srcRow[sx / 2];
+            uint8_t value = sx % 2 == 0 ? byte >> 4 : byte & 0xf;
+            _ff_canvas_put(&to, p.x + x, p.y + y, value);
+        }
+    }
+}
+
+/// @brief Replace colors on the whole canvas.
+/// @details The color `c` is replaced by `map[c - 1]`. NONE in the map keeps the color.
+void canvas_remap(Canvas c, const Color map[16])
+{
+    struct _ffCanvasView v;
+    if (!_ff_canvas_view(c, &v))
+    {
+        return;
+    }
+    uint8_t lut[16];
+    for (int32_t i = 0; i < 16; i++)
+    {
+        lut[i] = map[i] == NONE ? (uint8_t)i : (uint8_t)(map[i] - 1);
+    }
+    size_t len = (size_t)v.stride * v.height;
+    packed_remap(v.pixels, v.pixels, len, lut);
+}
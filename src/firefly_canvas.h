@@ -0,0 +1,34 @@
+/// @file
+/// @brief Software rendering into a Canvas without calling the host.
+///
+/// @details The functions here write pixels straight into the Canvas buffer.
+/// That is much faster than drawing thousands of small primitives
+/// with set_canvas and the draw_* functions. When done, the canvas
+/// can be shown on the screen with a single draw_image call.
+///
+/// The canvas must be created with new_canvas: 4 bits per pixel,
+/// two pixels per byte with the left one in the high bits,
+/// and the pixel value being the palette index (Color minus one).
+/// Drawing with the NONE color does nothing.
+///
+/// The inner loops use the kernels from firefly_simd.c, so build it as well.
+
+#pragma once
+
+#include "firefly.h"
+
+size_t canvas_buffer_size(Size s);
+Canvas new_canvas(Buffer buf, Size s);
+void canvas_set_transparent(Canvas c, Color t);
+
+void canvas_clear(Canvas c, Color color);
+void canvas_point(Canvas c, Point p, Color color);
+void canvas_points(Canvas c, const Point *points, size_t len, Color color);
+void canvas_hline(Canvas c, Point p, int32_t len, Color color);
+void canvas_rect(Canvas c, Point p, Size s, Color color);
+void canvas_line(Canvas c, Point a, Point b, Color color);
+void canvas_circle(Canvas c, Point p, int32_t d, Color color);
+void canvas_blit(Canvas c, Image i, Point p);
+void canvas_blit_sub(Canvas c, SubImage s, Point p);
+void canvas_copy(Canvas c, Point p, Canvas src, Rect r);
+void canvas_remap(Canvas c, const Color map[16]);
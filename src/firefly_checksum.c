@@ -0,0 +1,377 @@
+/// @file
+/// @brief The implementation of state checksums. See firefly_checksum.h.
+
+#include "firefly_checksum.h"
+#include <string.h>
+
+#if defined(FIREFLY_NO_SIMD)
+#define _FF_HASH_SCALAR
+#elif defined(__wasm_simd128__)
+#define _FF_HASH_WASM
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#define _FF_HASH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define _FF_HASH_NEON
+#include <arm_neon.h>
+#else
+#define _FF_HASH_SCALAR
+#endif
+
+// -- HASH -- //
+
+/// @private
+#define _FF_HASH_P32_1 0x9E3779B1u
+/// @private
+#define _FF_HASH_P64_1 0x9E3779B185EBCA87ull
+/// @private
+#define _FF_HASH_P64_2 0xC2B2AE3D27D4EB4Full
+/// @private
+#define _FF_HASH_P64_3 0x165667B19E3779F9ull
+
+/// @private
+/// @brief The bytes processed at once, one 64-bit value per lane.
+#define _FF_HASH_STRIPE 64
+
+/// @private
+/// @brief The stripes between two scrambles of the accumulators.
+#define _FF_HASH_BLOCK 16
+
+/// @private
+/// @brief Per-lane keys, mixed with the seed.
+static const uint64_t _ff_hash_secret[8] = {
+    0x97e56b819b81786cull,
+    0x1f90b940684e89f6ull,
+    0xbf749aa164d21d40ull,
+    0xbc22f95ba193485dull,
+    0xa5476f8dd6df9763ull,
+    0x46f4301bfc83116eull,
+    0x65661ef7d46118bcull,
+    0x21b4176e8d566c73ull,
+};
+
+/// @private
+/// @brief Mix a stripe into the accumulators.
+/// @details For every lane: acc[i ^ 1] += data, acc[i] += lo32(data ^ key) * hi32(data ^ key).
+static void _ff_hash_stripe(uint64_t *acc, const uint8_t *p, const uint64_t *key)
+{
+#if defined(_FF_HASH_WASM)
+    for (int32_t i = 0; i < 8; i += 2)
+    {
+        v128_t d = wasm_v128_load(p + i * 8);
+        v128_t dk = wasm_v128_xor(d, wasm_v128_load(key + i));
+        v128_t lo = wasm_i32x4_shuffle(dk, dk, 0, 2, 0, 2);
+        v128_t hi = wasm_i32x4_shuffle(dk, dk, 1, 3, 1, 3);
+        v128_t product = wasm_u64x2_extmul_low_u32x4(lo, hi);
+        v128_t swapped = wasm_i64x2_shuffle(d, d, 1, 0);
+        v128_t a = wasm_v128_load(acc + i);
+        wasm_v128_store(acc + i, wasm_i64x2_add(a, wasm_i64x2_add(product, swapped)));
+    }
+#elif defined(_FF_HASH_SSE2)
+    for (int32_t i = 0; i < 8; i += 2)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(p + i * 8));
+        __m128i dk = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)(key + i)));
+        __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi64(a, _mm_add_epi64(product, swapped)));
+    }
+#elif defined(_FF_HASH_NEON)
+    for (int32_t i = 0; i < 8; i += 2)
+    {
+        uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(p + i * 8));
+        uint64x2_t dk = veorq_u64(d, vld1q_u64(key + i));
+        uint64x2_t a = vaddq_u64(vld1q_u64(acc + i), vextq_u64(d, d, 1));
+        vst1q_u64(acc + i, vmlal_u32(a, vmovn_u64(dk), vshrn_n_u64(dk, 32)));
+    }
+#else
+    for (int32_t i = 0; i < 8; i++)
+    {
+        uint64_t d;
+        memcpy(&d, p + i * 8, 8);
+        uint64_t dk = d ^ key[i];
+        acc[i ^ 1] += d;
+        acc[i] += (dk & 0xffffffff) * (dk >> 32);
+    }
+#endif
+}
+
+/// @private
+static void _ff_hash_scramble(uint64_t *acc, const uint64_t *key)
+{
+    for (int32_t i = 0; i < 8; i++)
+    {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * _FF_HASH_P32_1;
+    }
+}
+
+/// @private
+static uint64_t _ff_hash_rotl(uint64_t v, int32_t r)
+{
+    return (v << r) | (v >> (64 - r));
+}
+
+/// @brief Hash the bytes into a 64-bit value.
+///
+/// @details A fast non-cryptographic hash for checksums and hash tables,
+/// not suitable for anything security-related. Different seeds give
+/// independent hashes of the same data.
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t key[8];
+    for (int32_t i = 0; i < 8; i++)
+    {
+        key[i] = i % 2 == 0 ? _ff_hash_secret[i] + seed : _ff_hash_secret[i] - seed;
+    }
+    uint64_t acc[8] = {
+        _FF_HASH_P32_1, _FF_HASH_P64_1, _FF_HASH_P64_2, _FF_HASH_P64_3,
+        _FF_HASH_P64_1 ^ seed, _FF_HASH_P64_2 ^ seed, _FF_HASH_P64_3 ^ seed, _FF_HASH_P32_1 ^ seed};
+
+    size_t stripes = len / _FF_HASH_STRIPE;
+    for (size_t s = 0; s < stripes; s++)
+    {
+        _ff_hash_stripe(acc, p + s * _FF_HASH_STRIPE, key);
+        if (s % _FF_HASH_BLOCK == _FF_HASH_BLOCK - 1)
+        {
+            _ff_hash_scramble(acc, key);
+        }
+    }
+    size_t rest = len % _FF_HASH_STRIPE;
+    if (rest != 0)
+    {
+        uint8_t last[_FF_HASH_STRIPE];
+        memset(last, 0, sizeof(last));
+        memcpy(last, p + stripes * _FF_HASH_STRIPE, rest);
+        _ff_hash_stripe(acc, last, key);
+    }
+
+    uint64_t h = (uint64_t)len * _FF_HASH_P64_1 + seed;
+    for (int32_t i = 0; i < 8; i += 2)
+    {
+        h += ((acc[i] ^ key[i + 1]) * _FF_HASH_P64_2) ^ _ff_hash_rotl(acc[i + 1] ^ key[i], 31);
+        h = _ff_hash_rotl(h, 27) * _FF_HASH_P64_1;
+    }
+    h ^= h >> 33;
+    h *= _FF_HASH_P64_2;
+    h ^= h >> 29;
+    h *= _FF_HASH_P64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// -- CHECKSUM -- //
+
+/// @brief An empty checksum with no regions.
+Checksum new_checksum()
+{
+    Checksum c;
+    memset(&c, 0, sizeof(c));
+    c.frame = -1;
+    return c;
+}
+
+/// @brief Register a memory region as a part of the state.
+/// @details Returns the region ID or -1 if there are too many regions.
+/// The region is hashed in the next checksum_update.
+int32_t checksum_add_region(Checksum *c, const void *ptr, size_t size)
+{
+    if (c->regions_len == CHECKSUM_MAX_REGIONS)
+    {
+        return -1;
+    }
+    ChecksumRegion *r = &c->regions[c->regions_len];
+    r->ptr = (const uint8_t *)ptr;
+    r->size = size;
+    r->hash = 0;
+    r->dirty = true;
+    return c->regions_len++;
+}
+
+/// @brief Mark the region as written in this frame.
+void checksum_touch(Checksum *c, int32_t region)
+{
+    if (region >= 0 && region < c->regions_len)
+    {
+        c->regions[region].dirty = true;
+    }
+}
+
+/// @brief Mark the region containing the pointer as written in this frame.
+void checksum_touch_ptr(Checksum *c, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    for (int32_t i = 0; i < c->regions_len; i++)
+    {
+        ChecksumRegion *r = &c->regions[i];
+        if (p >= r->ptr && p < r->ptr + r->size)
+        {
+            r->dirty = true;
+        }
+    }
+}
+
+/// @brief Mark all regions as written in this frame.
+void checksum_touch_all(Checksum *c)
+{
+    for (int32_t i = 0; i < c->regions_len; i++)
+    {
+        c->regions[i].dirty = true;
+    }
+}
+
+/// @brief Hash the touched regions and compute the checksum of the frame.
+/// @details Call it once at the end of every update. Going back to an earlier
+/// frame (after a rollback) drops the checksums of the frames after it.
+uint64_t checksum_update(Checksum *c, int32_t frame)
+{
+    uint64_t hashes[CHECKSUM_MAX_REGIONS];
+    for (int32_t i = 0; i < c->regions_len; i++)
+    {
+        ChecksumRegion *r = &c->regions[i];
+        if (r->dirty)
+        {
+            // The region index as the seed, so that swapped regions don't cancel out.
+            r->hash = hash_bytes(r->ptr, r->size, (uint64_t)i);
+            r->dirty = false;
+            c->stats.rehashed++;
+            c->stats.bytes += r->size;
+        }
+        hashes[i] = r->hash;
+    }
+    uint64_t sum = hash_bytes(hashes, (size_t)c->regions_len * sizeof(uint64_t), (uint64_t)frame);
+
+    // history[i] is the checksum of the frame `c->frame - i`. Frames skipped
+    // since the last update are unknown (0), and after a rollback the
+    // checksums of the abandoned frames are dropped.
+    uint64_t old[CHECKSUM_HISTORY];
+    memcpy(old, c->history, sizeof(old));
+    int32_t shift = c->frame < 0 ? CHECKSUM_HISTORY : frame - c->frame;
+    int32_t len = 1;
+    for (int32_t i = 1; i < CHECKSUM_HISTORY; i++)
+    {
+        int32_t j = i - shift;
+        bool known = j >= 0 && j < c->history_len;
+        c->history[i] = known ? old[j] : 0;
+        if (known)
+        {
+            len = i + 1;
+        }
+    }
+    c->history[0] = sum;
+    c->history_len = len;
+    c->frame = frame;
+    c->stats.frames++;
+    return sum;
+}
+
+/// @private
+static void _ff_checksum_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/// @private
+static uint32_t _ff_checksum_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/// @brief Pack the latest checksums into the buffer.
+///
+/// @details The packet has the magic "FC", the number of frames and regions,
+/// the latest frame, the low 32 bits of the checksums of the last 12 frames,
+/// and the low 16 bits of the checksums of the first 12 regions.
+/// It takes at most CHECKSUM_PACKET_SIZE bytes, which fits into a Stash.
+/// Returns an empty Stash if the buffer is too small.
+Stash checksum_pack(const Checksum *c, Buffer buf)
+{
+    Stash s = {0, buf.head};
+    int32_t frames = c->history_len < CHECKSUM_PACKET_FRAMES ? c->history_len : CHECKSUM_PACKET_FRAMES;
+    int32_t regions = c->regions_len < CHECKSUM_PACKET_REGIONS ? c->regions_len : CHECKSUM_PACKET_REGIONS;
+    size_t size = 8 + (size_t)frames * 4 + (size_t)regions * 2;
+    if (buf.size < size)
+    {
+        return s;
+    }
+    uint8_t *p = (uint8_t *)buf.head;
+    p[0] = 'F';
+    p[1] = 'C';
+    p[2] = (uint8_t)frames;
+    p[3] = (uint8_t)regions;
+    _ff_checksum_put32(p + 4, (uint32_t)c->frame);
+    for (int32_t i = 0; i < frames; i++)
+    {
+        _ff_checksum_put32(p + 8 + i * 4, (uint32_t)c->history[i]);
+    }
+    uint8_t *r = p + 8 + frames * 4;
+    for (int32_t i = 0; i < regions; i++)
+    {
+        r[i * 2] = (uint8_t)c->regions[i].hash;
+        r[i * 2 + 1] = (uint8_t)(c->regions[i].hash >> 8);
+    }
+    s.size = size;
+    return s;
+}
+
+/// @brief Compare the local checksums with a packet from another peer.
+///
+/// @details Only the frames known to both sides are compared. The region is
+/// reported only if both sides are at the same frame, since only the checksums
+/// of the latest regions are in the packet. Skipped frames are never reported.
+ChecksumDiff checksum_verify(const Checksum *c, Stash remote)
+{
+    ChecksumDiff diff = {-1, -1};
+    const uint8_t *p = (const uint8_t *)remote.head;
+    if (remote.size < 8 || p[0] != 'F' || p[1] != 'C')
+    {
+        return diff;
+    }
+    int32_t frames = p[2];
+    int32_t regions = p[3];
+    if (remote.size < 8 + (size_t)frames * 4 + (size_t)regions * 2)
+    {
+        return diff;
+    }
+    int32_t latest = (int32_t)_ff_checksum_get32(p + 4);
+    for (int32_t j = 0; j < frames; j++)
+    {
+        int32_t i = c->frame - (latest - j);
+        if (i < 0 || i >= c->history_len || c->history[i] == 0)
+        {
+            continue;
+        }
+        if ((uint32_t)c->history[i] != _ff_checksum_get32(p + 8 + j * 4))
+        {
+            diff.frame = latest - j;
+        }
+    }
+    if (latest == c->frame)
+    {
+        const uint8_t *r = p + 8 + frames * 4;
+        int32_t n = regions < c->regions_len ? regions : c->regions_len;
+        for (int32_t i = 0; i < n && diff.region < 0; i++)
+        {
+            uint16_t theirs = (uint16_t)(r[i * 2] | (r[i * 2 + 1] << 8));
+            if ((uint16_t)c->regions[i].hash != theirs)
+            {
+                diff.region = i;
+            }
+        }
+    }
+    return diff;
+}
+
+/// @brief Reset the hashing statistics.
+void checksum_reset_stats(Checksum *c)
+{
+    memset(&c->stats, 0, sizeof(c->stats));
+}
@@ -0,0 +1,112 @@
+/// @file
+/// @brief Per-frame checksums of the game state for detecting multiplayer desyncs.
+///
+/// @details Register the memory regions holding the simulated state, mark
+/// the regions written during the frame with checksum_touch, and call
+/// checksum_update at the end of every update. Only the touched regions
+/// are hashed again, the others keep their hash from earlier frames.
+///
+/// The checksums of the last frames (and of every region in the latest one)
+/// are packed into at most 80 bytes, the size of a Stash, to be exchanged
+/// with other peers and compared with checksum_verify:
+///
+/// ```c
+/// checksum_touch_ptr(&sum, &state.players);
+/// checksum_update(&sum, frame);
+/// Stash mine = checksum_pack(&sum, buf);
+/// ...
+/// ChecksumDiff diff = checksum_verify(&sum, theirs);
+/// if (diff.frame >= 0)
+/// {
+///     log_error("desync");
+/// }
+/// ```
+///
+/// The hash is a non-cryptographic XXH3-style hash processing 64 bytes
+/// at a time in 8 independent 64-bit lanes, vectorized with the same
+/// backends as firefly_simd.h. It's not compatible with XXH3 itself.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The maximum number of registered regions.
+#define CHECKSUM_MAX_REGIONS 16
+
+/// @brief The number of frame checksums remembered for verification.
+#define CHECKSUM_HISTORY 32
+
+/// @brief The size of a packed checksum, fits into a Stash.
+#define CHECKSUM_PACKET_SIZE 80
+
+/// @brief The number of frame checksums in a packet.
+#define CHECKSUM_PACKET_FRAMES 12
+
+/// @brief The number of region checksums in a packet.
+#define CHECKSUM_PACKET_REGIONS 12
+
+/// @brief A registered memory region.
+struct ChecksumRegion
+{
+    /// @private
+    const uint8_t *ptr;
+    /// @private
+    size_t size;
+    /// @private
+    uint64_t hash;
+    /// @private
+    bool dirty;
+};
+typedef struct ChecksumRegion ChecksumRegion;
+
+/// @brief Counters of the hashing work.
+struct ChecksumStats
+{
+    /// @brief The number of checksum_update calls.
+    uint32_t frames;
+    /// @brief The number of regions hashed again.
+    uint32_t rehashed;
+    /// @brief The number of bytes hashed.
+    uint64_t bytes;
+};
+typedef struct ChecksumStats ChecksumStats;
+
+/// @brief The checksums of the registered regions and of the last frames.
+struct Checksum
+{
+    /// @private
+    ChecksumRegion regions[CHECKSUM_MAX_REGIONS];
+    /// @private
+    int32_t regions_len;
+    /// @private
+    uint64_t history[CHECKSUM_HISTORY];
+    /// @private
+    int32_t history_len;
+    /// @brief The frame of the latest checksum_update.
+    int32_t frame;
+    /// @brief Statistics accumulated since new_checksum or checksum_reset_stats.
+    ChecksumStats stats;
+};
+typedef struct Checksum Checksum;
+
+/// @brief The result of comparing checksums with another peer.
+struct ChecksumDiff
+{
+    /// @brief The earliest frame with a different checksum, or -1 if all known frames match.
+    int32_t frame;
+    /// @brief The first region with a different checksum in the latest common frame, or -1.
+    int32_t region;
+};
+typedef struct ChecksumDiff ChecksumDiff;
+
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed);
+
+Checksum new_checksum();
+int32_t checksum_add_region(Checksum *c, const void *ptr, size_t size);
+void checksum_touch(Checksum *c, int32_t region);
+void checksum_touch_ptr(Checksum *c, const void *ptr);
+void checksum_touch_all(Checksum *c);
+uint64_t checksum_update(Checksum *c, int32_t frame);
+Stash checksum_pack(const Checksum *c, Buffer buf);
+ChecksumDiff checksum_verify(const Checksum *c, Stash remote);
+void checksum_reset_stats(Checksum *c);
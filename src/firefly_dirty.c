@@ -0,0 +1,367 @@
+/// @file
+/// @brief The implementation of frame diffing. See firefly_dirty.h.
+
+#include "firefly_dirty.h"
+#include <string.h>
+
+/// @private
+/// @brief How far ahead in the previous frame to look for a matching command.
+#define _FF_DIRTY_MATCH_WINDOW 64
+
+/// @private
+static DirtyFrame *_ff_dirty = 0;
+
+/// @private
+static void _ff_dirty_exec(DirtyFrame *d, const DrawCmd *cmd)
+{
+    if (d->hook)
+    {
+        d->hook(cmd);
+    }
+    else
+    {
+        exec_draw_cmd(cmd);
+    }
+    d->stats.replayed++;
+}
+
+/// @private
+/// @brief FNV-1a hash of the memory the command reads.
+static uint32_t _ff_dirty_hash(const DrawCmd *cmd)
+{
+    size_t len = 0;
+    switch (cmd->op)
+    {
+    case DRAW_TEXT:
+        len = (size_t)cmd->args[3];
+        break;
+    case DRAW_QR:
+        len = (size_t)cmd->args[4];
+        break;
+    case DRAW_IMAGE:
+        len = (size_t)cmd->args[2];
+        break;
+    case DRAW_SUB_IMAGE:
+        len = (size_t)cmd->args[6];
+        break;
+    default:
+        return 0;
+    }
+    uint32_t h = 2166136261u;
+    const uint8_t *p = (const uint8_t *)cmd->ptr;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+/// @private
+static bool _ff_dirty_same(const DirtyEntry *a, const DirtyEntry *b)
+{
+    return a->cmd.op == b->cmd.op && a->hash == b->hash &&
+           a->cmd.ptr == b->cmd.ptr && a->cmd.ptr2 == b->cmd.ptr2 &&
+           memcmp(a->cmd.args, b->cmd.args, sizeof(a->cmd.args)) == 0;
+}
+
+/// @private
+/// @brief Send the recorded commands as they are and stop diffing until the next frame.
+static void _ff_dirty_flush(DirtyFrame *d)
+{
+    for (size_t i = 0; i < d->len; i++)
+    {
+        _ff_dirty_exec(d, &d->cur[i].cmd);
+    }
+    d->len = 0;
+    d->overflow = true;
+}
+
+/// @private
+static void _ff_dirty_hook(const DrawCmd *cmd)
+{
+    DirtyFrame *d = _ff_dirty;
+    d->stats.recorded++;
+    if (d->overflow)
+    {
+        _ff_dirty_exec(d, cmd);
+        return;
+    }
+    if (d->len == d->cap)
+    {
+        _ff_dirty_flush(d);
+        _ff_dirty_exec(d, cmd);
+        return;
+    }
+    DirtyEntry *e = &d->cur[d->len++];
+    e->cmd = *cmd;
+    e->bounded = draw_cmd_bounds(cmd, &e->bounds);
+    e->hash = _ff_dirty_hash(cmd);
+    e->matched = false;
+    e->replay = false;
+}
+
+/// @brief Create a frame differ keeping the recordings in the given storage.
+///
+/// @details The storage is split in two halves, one for the current
+/// and one for the previous frame. It must stay alive while the differ is used.
+/// Frames with more commands than fit into a half are drawn in full.
+DirtyFrame new_dirty_frame(Buffer storage)
+{
+    uintptr_t head = (uintptr_t)storage.head;
+    uintptr_t align = _Alignof(DirtyEntry);
+    uintptr_t aligned = (head + align - 1) & ~(align - 1);
+    size_t skip = aligned - head;
+    DirtyFrame d;
+    memset(&d, 0, sizeof(d));
+    d.cap = storage.size > skip ? (storage.size - skip) / sizeof(DirtyEntry) / 2 : 0;
+    d.cur = (DirtyEntry *)aligned;
+    d.prev = d.cur + d.cap;
+    return d;
+}
+
+/// @brief Start recording the frame.
+/// @details Only one differ can be active at a time.
+void dirty_begin(DirtyFrame *d)
+{
+    d->len = 0;
+    d->overflow = false;
+    _ff_dirty = d;
+    d->hook = set_draw_hook(_ff_dirty_hook);
+}
+
+/// @private
+/// @brief Clip the rectangle to the screen. Returns false if nothing is left.
+static bool _ff_dirty_clip(Rect *r)
+{
+    int32_t x0 = r->point.x < 0 ? 0 : r->point.x;
+    int32_t y0 = r->point.y < 0 ? 0 : r->point.y;
+    int32_t x1 = r->point.x + r->size.width;
+    int32_t y1 = r->point.y + r->size.height;
+    x1 = x1 > WIDTH ? WIDTH : x1;
+    y1 = y1 > HEIGHT ? HEIGHT : y1;
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return false;
+    }
+    *r = (Rect){{x0, y0}, {x1 - x0, y1 - y0}};
+    return true;
+}
+
+/// @private
+static Rect _ff_dirty_union(Rect a, Rect b)
+{
+    int32_t x0 = a.point.x < b.point.x ? a.point.x : b.point.x;
+    int32_t y0 = a.point.y < b.point.y ? a.point.y : b.point.y;
+    int32_t ax1 = a.point.x + a.size.width;
+    int32_t bx1 = b.point.x + b.size.width;
+    int32_t ay1 = a.point.y + a.size.height;
+    int32_t by1 = b.point.y + b.size.height;
+    int32_t x1 = ax1 > bx1 ? ax1 : bx1;
+    int32_t y1 = ay1 > by1 ? ay1 : by1;
+    return (Rect){{x0, y0}, {x1 - x0, y1 - y0}};
+}
+
+/// @private
+static int32_t _ff_dirty_area(Rect r)
+{
+    return r.size.width * r.size.height;
+}
+
+/// @private
+/// @brief Add the rectangle into the dirty set, merging when it is full.
+/// @details Returns false if the rectangle was already covered.
+static bool _ff_dirty_add(DirtyFrame *d, Rect r)
+{
+    if (!_ff_dirty_clip(&r))
+    {
+        return false;
+    }
+    for (int32_t i = 0; i < d->rects_len; i++)
+    {
+        if (rect_contains(d->rects[i], r))
+        {
+            return false;
+        }
+    }
+    if (d->rects_len < DIRTY_MAX_RECTS)
+    {
+        d->rects[d->rects_len++] = r;
+        return true;
+    }
+    // Merge into the rectangle growing the least.
+    int32_t best = 0;
+    int32_t bestGrowth = INT32_MAX;
+    for (int32_t i = 0; i < d->rects_len; i++)
+    {
+        Rect u = _ff_dirty_union(d->rects[i], r);
+        int32_t growth = _ff_dirty_area(u) - _ff_dirty_area(d->rects[i]);
+        if (growth < bestGrowth)
+        {
+            best = i;
+            bestGrowth = growth;
+        }
+    }
+    d->rects[best] = _ff_dirty_union(d->rects[best], r);
+    return true;
+}
+
+/// @private
+static bool _ff_dirty_hits(const DirtyFrame *d, Rect r)
+{
+    for (int32_t i = 0; i < d->rects_len; i++)
+    {
+        if (rect_intersects(d->rects[i], r))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @private
+/// @brief Match the commands of both frames in order. Returns false if a full redraw is needed.
+static bool _ff_dirty_diff(DirtyFrame *d)
+{
+    if (!d->prev_valid || d->len == 0 || d->prev_len == 0)
+    {
+        return false;
+    }
+    // The frame must start with the same clear_screen to know what is under the dirty rects.
+    if (d->cur[0].cmd.op != DRAW_CLEAR_SCREEN || d->cur[0].cmd.args[0] == NONE ||
+        !_ff_dirty_same(&d->cur[0], &d->prev[0]))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < d->prev_len; i++)
+    {
+        d->prev[i].matched = false;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < d->len; i++)
+    {
+        DirtyEntry *e = &d->cur[i];
+        size_t end = j + _FF_DIRTY_MATCH_WINDOW;
+        end = end > d->prev_len ? d->prev_len : end;
+        for (size_t k = j; k < end; k++)
+        {
+            if (_ff_dirty_same(e, &d->prev[k]))
+            {
+                e->matched = true;
+                d->prev[k].matched = true;
+                j = k + 1;
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i < d->prev_len; i++)
+    {
+        DirtyEntry *e = &d->prev[i];
+        if (!e->matched)
+        {
+            if (!e->bounded)
+            {
+                return false;
+            }
+            _ff_dirty_add(d, e->bounds);
+        }
+    }
+    for (size_t i = 1; i < d->len; i++)
+    {
+        // Includes clear_screen and canvas switches.
+        DirtyEntry *e = &d->cur[i];
+        if (!e->bounded)
+        {
+            return false;
+        }
+        if (!e->matched)
+        {
+            _ff_dirty_add(d, e->bounds);
+        }
+    }
+    return true;
+}
+
+/// @brief Stop recording and draw what changed since the previous frame.
+void dirty_end(DirtyFrame *d)
+{
+    set_draw_hook(d->hook);
+    _ff_dirty = 0;
+    d->stats.frames++;
+    d->rects_len = 0;
+    if (d->overflow)
+    {
+        d->stats.full++;
+        d->prev_valid = false;
+        return;
+    }
+
+    if (!_ff_dirty_diff(d))
+    {
+        d->rects_len = 1;
+        d->rects[0] = (Rect){{0, 0}, {WIDTH, HEIGHT}};
+        d->stats.full++;
+        d->stats.dirty_area += WIDTH * HEIGHT;
+        for (size_t i = 0; i < d->len; i++)
+        {
+            _ff_dirty_exec(d, &d->cur[i].cmd);
+        }
+    }
+    else if (d->rects_len == 0)
+    {
+        d->stats.skipped++;
+    }
+    else
+    {
+        // Everything drawn over a dirty rect must be drawn again,
+        // which in turn makes its whole bounding box dirty.
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = 1; i < d->len; i++)
+            {
+                DirtyEntry *e = &d->cur[i];
+                if (!e->replay && _ff_dirty_hits(d, e->bounds))
+                {
+                    e->replay = true;
+                    changed |= _ff_dirty_add(d, e->bounds);
+                }
+            }
+        }
+        int32_t color = d->cur[0].cmd.args[0];
+        for (int32_t i = 0; i < d->rects_len; i++)
+        {
+            Rect r = d->rects[i];
+            d->stats.dirty_area += _ff_dirty_area(r);
+            DrawCmd cmd = {DRAW_RECT, 0, 0, {r.point.x, r.point.y, r.size.width, r.size.height, color, NONE, 0}};
+            _ff_dirty_exec(d, &cmd);
+        }
+        for (size_t i = 1; i < d->len; i++)
+        {
+            if (d->cur[i].replay)
+            {
+                _ff_dirty_exec(d, &d->cur[i].cmd);
+            }
+        }
+    }
+
+    DirtyEntry *swap = d->prev;
+    d->prev = d->cur;
+    d->cur = swap;
+    d->prev_len = d->len;
+    d->prev_valid = true;
+    d->len = 0;
+}
+
+/// @brief Draw the next frame in full.
+/// @details Call it when something else has drawn on the screen.
+void dirty_invalidate(DirtyFrame *d)
+{
+    d->prev_valid = false;
+}
+
+/// @brief Reset the frame diffing statistics.
+void dirty_reset_stats(DirtyFrame *d)
+{
+    memset(&d->stats, 0, sizeof(d->stats));
+}
@@ -0,0 +1,92 @@
+/// @file
+/// @brief Redrawing only the parts of the screen that changed since the last frame.
+///
+/// @details While a DirtyFrame is active, all drawing functions are recorded
+/// instead of being sent to the host. At the end of the frame, the recording
+/// is compared with the one from the previous frame:
+///
+/// * if nothing changed, nothing is sent to the host at all;
+/// * otherwise, the bounding boxes of the commands that were added, removed,
+///   or changed are merged into a few dirty rectangles, the dirty rectangles
+///   are filled with the clear_screen color, and only the commands
+///   intersecting them are drawn again.
+///
+/// For that to work, the frame must start with clear_screen and must not
+/// draw on canvases. Frames that don't follow it are drawn in full.
+/// The host must keep the previous frame on the screen between updates.
+///
+/// Text and image contents are hashed, so changing a text buffer in place
+/// is detected. Hashing is linear in the image size, so the diffing
+/// is best suited for screens made mostly of shapes, text, and small images.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The maximum number of dirty rectangles tracked per frame.
+#define DIRTY_MAX_RECTS 8
+
+/// @brief Counters of the frame diffing work.
+struct DirtyStats
+{
+    /// @brief The number of frames ended.
+    uint32_t frames;
+    /// @brief The number of frames that didn't change and were skipped.
+    uint32_t skipped;
+    /// @brief The number of frames drawn in full.
+    uint32_t full;
+    /// @brief The number of commands recorded.
+    uint32_t recorded;
+    /// @brief The number of commands sent to the host.
+    uint32_t replayed;
+    /// @brief The total area of dirty rectangles, in pixels.
+    uint32_t dirty_area;
+};
+typedef struct DirtyStats DirtyStats;
+
+/// @private
+/// @brief A recorded command with its cached bounds and content hash.
+struct DirtyEntry
+{
+    DrawCmd cmd;
+    Rect bounds;
+    uint32_t hash;
+    bool bounded;
+    bool matched;
+    bool replay;
+};
+typedef struct DirtyEntry DirtyEntry;
+
+/// @brief The recordings of the current and the previous frame.
+struct DirtyFrame
+{
+    /// @private
+    DirtyEntry *cur;
+    /// @private
+    DirtyEntry *prev;
+    /// @private
+    size_t cap;
+    /// @private
+    size_t len;
+    /// @private
+    size_t prev_len;
+    /// @private
+    bool prev_valid;
+    /// @private
+    bool overflow;
+    /// @private
+    DrawHook hook;
+    /// @brief The dirty rectangles of the last frame, in screen coordinates.
+    Rect rects[DIRTY_MAX_RECTS];
+    /// @brief The number of dirty rectangles of the last frame.
+    int32_t rects_len;
+    /// @brief Statistics accumulated since new_dirty_frame or dirty_reset_stats.
+    DirtyStats stats;
+};
+typedef struct DirtyFrame DirtyFrame;
+
+DirtyFrame new_dirty_frame(Buffer storage);
+void dirty_begin(DirtyFrame *d);
+void dirty_end(DirtyFrame *d);
+void dirty_invalidate(DirtyFrame *d);
+void dirty_reset_stats(DirtyFrame *d);
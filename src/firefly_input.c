@@ -0,0 +1,136 @@
+/// @file
+/// @brief The implementation of the input snapshot. See firefly_input.h.
+
+#include "firefly_input.h"
+#include <string.h>
+
+/// @private
+/// @brief The raw pad value of an untouched pad.
+#define _FF_PAD_UNTOUCHED 0xffff
+
+/// @brief An empty snapshot, with no peers online and nothing pressed.
+InputSnapshot new_input_snapshot()
+{
+    InputSnapshot in;
+    memset(&in, 0, sizeof(in));
+    return in;
+}
+
+/// @brief Read the input of all online peers and compute the edges.
+///
+/// @details Call it once at the start of every update. Makes one host call
+/// for the peers and two for every online peer. The calls go through
+/// the input hook, so the snapshot works with recorded input.
+void input_update(InputSnapshot *in)
+{
+    uint32_t prev = in->peers.online;
+    uint32_t online = (uint32_t)submit_input(INPUT_GET_PEERS, 0);
+    in->peers.online = online;
+    in->joined.online = online & ~prev;
+    in->left.online = prev & ~online;
+    in->touched.online = 0;
+    in->any_held = 0;
+    in->any_pressed = 0;
+    in->any_released = 0;
+    in->host_calls = 1;
+    memset(in->pressed, 0, sizeof(in->pressed));
+    memset(in->released, 0, sizeof(in->released));
+
+    for (uint32_t bits = in->left.online; bits != 0; bits &= bits - 1)
+    {
+        int32_t p = __builtin_ctz(bits);
+        in->released[p] = in->held[p];
+        in->any_released |= in->held[p];
+        in->held[p] = 0;
+        memset(&in->pads[p], 0, sizeof(Pad));
+    }
+
+    for (uint32_t bits = online; bits != 0; bits &= bits - 1)
+    {
+        int32_t p = __builtin_ctz(bits);
+        uint8_t old = in->held[p];
+        uint8_t now = (uint8_t)(submit_input(INPUT_READ_BUTTONS, p) & BUTTON_ANY);
+        in->held[p] = now;
+        in->pressed[p] = now & ~old;
+        in->released[p] = old & ~now;
+        in->any_held |= now;
+        in->any_pressed |= in->pressed[p];
+        in->any_released |= in->released[p];
+
+        int32_t raw = (int32_t)submit_input(INPUT_READ_PAD, p);
+        Pad *pad = &in->pads[p];
+        if (raw == _FF_PAD_UNTOUCHED)
+        {
+            memset(pad, 0, sizeof(Pad));
+        }
+        else
+        {
+            pad->x = raw >> 16;
+            pad->y = raw;
+            pad->touched = true;
+            in->touched.online |= 1u << p;
+        }
+        in->host_calls += 2;
+    }
+}
+
+/// @private
+static uint8_t _ff_input_bits(const uint8_t *perPeer, uint8_t any, Peer p)
+{
+    if (p == COMBINED)
+    {
+        return any;
+    }
+    if (p < 0 || p >= INPUT_MAX_PEERS)
+    {
+        return 0;
+    }
+    return perPeer[p];
+}
+
+/// @brief The buttons from the mask that the peer holds.
+uint8_t input_held(const InputSnapshot *in, Peer p, uint8_t mask)
+{
+    return _ff_input_bits(in->held, in->any_held, p) & mask;
+}
+
+/// @brief The buttons from the mask that the peer pressed in this frame.
+uint8_t input_pressed(const InputSnapshot *in, Peer p, uint8_t mask)
+{
+    return _ff_input_bits(in->pressed, in->any_pressed, p) & mask;
+}
+
+/// @brief The buttons from the mask that the peer released in this frame.
+uint8_t input_released(const InputSnapshot *in, Peer p, uint8_t mask)
+{
+    return _ff_input_bits(in->released, in->any_released, p) & mask;
+}
+
+/// @brief The pad of the peer.
+/// @details For COMBINED, the pad of the first peer touching it.
+Pad input_pad(const InputSnapshot *in, Peer p)
+{
+    if (p == COMBINED && in->touched.online != 0)
+    {
+        return in->pads[__builtin_ctz(in->touched.online)];
+    }
+    if (p < 0 || p >= INPUT_MAX_PEERS)
+    {
+        Pad pad = {0};
+        return pad;
+    }
+    return in->pads[p];
+}
+
+/// @brief The held buttons of the peer in the format of read_buttons.
+Buttons input_buttons(const InputSnapshot *in, Peer p)
+{
+    uint8_t raw = input_held(in, p, BUTTON_ANY);
+    Buttons buttons = {
+        .s = (raw & BUTTON_S) != 0,
+        .e = (raw & BUTTON_E) != 0,
+        .w = (raw & BUTTON_W) != 0,
+        .n = (raw & BUTTON_N) != 0,
+        .menu = (raw & BUTTON_MENU) != 0};
+    return buttons;
+}
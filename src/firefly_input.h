@@ -0,0 +1,83 @@
+/// @file
+/// @brief A per-frame snapshot of the input of all online peers.
+///
+/// @details Call input_update once at the start of every update. It walks
+/// the bitmap of online peers and reads the pad and buttons of each of them
+/// exactly once, then computes which buttons were pressed or released
+/// since the previous frame. Everything else reads the snapshot
+/// without calling the host:
+///
+/// ```c
+/// static InputSnapshot input;
+///
+/// void update()
+/// {
+///     input_update(&input);
+///     if (input_pressed(&input, COMBINED, BUTTON_S))
+///     {
+///         jump();
+///     }
+/// }
+/// ```
+///
+/// Buttons are kept as bitmasks, one byte per peer. COMBINED is accepted
+/// in place of a peer and means "any online peer".
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The number of peers the snapshot can hold, one per bit of Peers.
+#define INPUT_MAX_PEERS 32
+
+/// @brief Bits of a button bitmask, in the same order as the host uses.
+enum ButtonMask
+{
+    BUTTON_S = 0b1,
+    BUTTON_E = 0b10,
+    BUTTON_W = 0b100,
+    BUTTON_N = 0b1000,
+    BUTTON_MENU = 0b10000,
+    /// @brief All buttons.
+    BUTTON_ANY = 0b11111,
+};
+typedef enum ButtonMask ButtonMask;
+
+/// @brief The input of all online peers in the current frame.
+struct InputSnapshot
+{
+    /// @brief The peers online in this frame.
+    Peers peers;
+    /// @brief The peers that went online since the previous frame.
+    Peers joined;
+    /// @brief The peers that went offline since the previous frame.
+    /// @details Their buttons are reported as released.
+    Peers left;
+    /// @brief The peers touching the pad.
+    Peers touched;
+    /// @brief The buttons currently pressed, per peer.
+    uint8_t held[INPUT_MAX_PEERS];
+    /// @brief The buttons pressed in this frame but not in the previous one.
+    uint8_t pressed[INPUT_MAX_PEERS];
+    /// @brief The buttons pressed in the previous frame but not in this one.
+    uint8_t released[INPUT_MAX_PEERS];
+    /// @brief The pad state, per peer.
+    Pad pads[INPUT_MAX_PEERS];
+    /// @brief The union of held of all peers.
+    uint8_t any_held;
+    /// @brief The union of pressed of all peers.
+    uint8_t any_pressed;
+    /// @brief The union of released of all peers.
+    uint8_t any_released;
+    /// @brief The number of host calls made by the last input_update.
+    uint32_t host_calls;
+};
+typedef struct InputSnapshot InputSnapshot;
+
+InputSnapshot new_input_snapshot();
+void input_update(InputSnapshot *in);
+uint8_t input_held(const InputSnapshot *in, Peer p, uint8_t mask);
+uint8_t input_pressed(const InputSnapshot *in, Peer p, uint8_t mask);
+uint8_t input_released(const InputSnapshot *in, Peer p, uint8_t mask);
+Pad input_pad(const InputSnapshot *in, Peer p);
+Buttons input_buttons(const InputSnapshot *in, Peer p);
@@ -0,0 +1,103 @@
+/// @file
+/// @brief The implementation of the layer compositor. See firefly_layers.h.
+
+#include "firefly_layers.h"
+#include "firefly_canvas.h"
+#include <string.h>
+
+/// @brief Create an empty compositor.
+Compositor new_compositor()
+{
+    Compositor c;
+    memset(&c, 0, sizeof(c));
+    return c;
+}
+
+/// @brief Add a layer on top of all existing layers.
+///
+/// @details The layer content is cached in a canvas of the given size
+/// placed in the storage (see canvas_buffer_size). The storage must stay alive
+/// while the compositor is used. If the storage is empty, the layer is live.
+/// Returns NULL if the compositor is full, the storage is too small,
+/// or the size is not valid for a canvas.
+Layer *compositor_add_layer(Compositor *c, Buffer storage, Size size, LayerRender render, void *ctx)
+{
+    if (c->len == COMPOSITOR_MAX_LAYERS)
+    {
+        return 0;
+    }
+    Canvas canvas = {0, 0};
+    if (storage.size != 0)
+    {
+        if (storage.size < canvas_buffer_size(size))
+        {
+            return 0;
+        }
+        canvas = new_canvas(storage, size);
+        if (canvas.size == 0)
+        {
+            return 0;
+        }
+    }
+    Layer *l = &c->layers[c->len++];
+    memset(l, 0, sizeof(*l));
+    l->canvas = canvas;
+    l->background = BLACK;
+    l->visible = true;
+    l->render = render;
+    l->ctx = ctx;
+    l->dirty = true;
+    return l;
+}
+
+/// @brief Render the layer again before it is drawn next time.
+void layer_invalidate(Layer *l)
+{
+    l->dirty = true;
+}
+
+/// @brief Render all layers again before they are drawn next time.
+void compositor_invalidate(Compositor *c)
+{
+    for (int32_t i = 0; i < c->len; i++)
+    {
+        c->layers[i].dirty = true;
+    }
+}
+
+/// @brief Draw all visible layers, rendering the invalidated ones first.
+void compositor_draw(Compositor *c)
+{
+    for (int32_t i = 0; i < c->len; i++)
+    {
+        Layer *l = &c->layers[i];
+        if (!l->visible)
+        {
+            continue;
+        }
+        if (l->canvas.size == 0)
+        {
+            l->render(l->ctx);
+            c->stats.live_renders++;
+            continue;
+        }
+        if (l->dirty)
+        {
+            canvas_clear(l->canvas, l->background);
+            canvas_set_transparent(l->canvas, l->transparent ? l->background : NONE);
+            set_canvas(l->canvas);
+            l->render(l->ctx);
+            unset_canvas();
+            l->dirty = false;
+            c->stats.renders++;
+        }
+        draw_image(l->canvas, l->point);
+        c->stats.blits++;
+    }
+}
+
+/// @brief Reset the compositor statistics, typically at the start of a frame.
+void compositor_reset_stats(Compositor *c)
+{
+    memset(&c->stats, 0, sizeof(c->stats));
+}
@@ -0,0 +1,77 @@
+/// @file
+/// @brief Composing the frame from retained layers cached in canvases.
+///
+/// @details Each layer is drawn by its own render callback into its own Canvas.
+/// The canvas is kept between frames and the callback is called again
+/// only after the layer is invalidated. Every frame, the Compositor draws
+/// the cached canvases with a single draw_image per layer, from the bottom up.
+///
+/// A layer without a canvas (added with an empty storage) is live:
+/// its callback is called every frame and draws straight on the screen.
+/// Use it for a small, constantly changing foreground.
+///
+/// Build firefly_canvas.c and firefly_simd.c as well.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The maximum number of layers in a compositor.
+#define COMPOSITOR_MAX_LAYERS 8
+
+/// @brief A callback drawing the layer content using the regular drawing functions.
+typedef void (*LayerRender)(void *ctx);
+
+/// @brief Counters of the compositor work.
+struct CompositorStats
+{
+    /// @brief The number of render callbacks called for cached layers.
+    uint32_t renders;
+    /// @brief The number of render callbacks called for live layers.
+    uint32_t live_renders;
+    /// @brief The number of cached layers drawn on the screen.
+    uint32_t blits;
+};
+typedef struct CompositorStats CompositorStats;
+
+/// @brief A single layer of the frame.
+struct Layer
+{
+    /// @brief The cached layer content. Empty for live layers.
+    Canvas canvas;
+    /// @brief Where the layer is drawn on the screen.
+    Point point;
+    /// @brief The color the canvas is filled with before rendering.
+    Color background;
+    /// @brief If true, the background is not drawn, so lower layers show through.
+    /// @details The layer content must not use the background color then.
+    bool transparent;
+    /// @brief If false, the layer is neither rendered nor drawn.
+    bool visible;
+    /// @private
+    LayerRender render;
+    /// @private
+    void *ctx;
+    /// @private
+    bool dirty;
+};
+typedef struct Layer Layer;
+
+/// @brief A stack of layers drawn from the bottom up.
+struct Compositor
+{
+    /// @private
+    Layer layers[COMPOSITOR_MAX_LAYERS];
+    /// @private
+    int32_t len;
+    /// @brief Statistics accumulated since new_compositor or compositor_reset_stats.
+    CompositorStats stats;
+};
+typedef struct Compositor Compositor;
+
+Compositor new_compositor();
+Layer *compositor_add_layer(Compositor *c, Buffer storage, Size size, LayerRender render, void *ctx);
+void layer_invalidate(Layer *l);
+void compositor_invalidate(Compositor *c);
+void compositor_draw(Compositor *c);
+void compositor_reset_stats(Compositor *c);
@@ -0,0 +1,260 @@
+/// @file
+/// @brief The implementation of the loading scheduler. See firefly_loader.h.
+
+#include "firefly_loader.h"
+#include <string.h>
+
+/// @brief Create a loader allocating the loaded data in the arena.
+/// @details The arena must stay alive while the loaded data is used.
+Loader new_loader(Arena *arena, size_t budget)
+{
+    Loader l;
+    memset(&l, 0, sizeof(l));
+    l.arena = arena;
+    l.budget = budget;
+    return l;
+}
+
+/// @private
+static int32_t _ff_loader_add(Loader *l, enum _ffLoadKind kind, int32_t after, LoadPriority p)
+{
+    if (l->len == LOADER_MAX_JOBS || after < -1 || after >= l->len)
+    {
+        return -1;
+    }
+    LoadJob *j = &l->jobs[l->len];
+    memset(j, 0, sizeof(*j));
+    j->kind = kind;
+    j->priority = p;
+    j->after = after;
+    return l->len++;
+}
+
+/// @brief Queue loading the file into the arena.
+/// @details The loaded file is written into `out` when the job is done.
+/// Returns the job ID to make other jobs depend on, or -1 if the queue is full.
+int32_t loader_load(Loader *l, Str path, File *out, LoadPriority p)
+{
+    int32_t id = _ff_loader_add(l, _FF_LOAD_FILE, -1, p);
+    if (id >= 0)
+    {
+        l->jobs[id].path = path;
+        l->jobs[id].out = out;
+    }
+    return id;
+}
+
+/// @brief Queue decompressing the file (see firefly_lz.h) into the arena.
+/// @details `src` is read when the job starts, so it can be the output
+/// of the job given as `after`. Pass -1 for no dependency.
+int32_t loader_decompress(Loader *l, const File *src, File *out, int32_t after, LoadPriority p)
+{
+    int32_t id = _ff_loader_add(l, _FF_LOAD_DECOMPRESS, after, p);
+    if (id >= 0)
+    {
+        l->jobs[id].src = src;
+        l->jobs[id].out = out;
+    }
+    return id;
+}
+
+/// @brief Queue a custom job. Pass -1 as `after` for no dependency.
+int32_t loader_call(Loader *l, LoadStep step, void *ctx, int32_t after, LoadPriority p)
+{
+    int32_t id = _ff_loader_add(l, _FF_LOAD_CALL, after, p);
+    if (id >= 0)
+    {
+        l->jobs[id].step = step;
+        l->jobs[id].ctx = ctx;
+    }
+    return id;
+}
+
+/// @private
+/// @brief Pick the next job to run, at or above the given priority. Returns NULL if none.
+static LoadJob *_ff_loader_next(Loader *l, LoadPriority min)
+{
+    LoadJob *best = 0;
+    for (int32_t i = 0; i < l->len; i++)
+    {
+        LoadJob *j = &l->jobs[i];
+        if (!j->done && j->priority >= min && (best == 0 || j->priority > best->priority))
+        {
+            best = j;
+        }
+    }
+    // Dependencies go first, whatever their priority.
+    while (best != 0 && best->after >= 0 && !l->jobs[best->after].done)
+    {
+        best = &l->jobs[best->after];
+    }
+    return best;
+}
+
+/// @private
+static void _ff_loader_finish(Loader *l, LoadJob *j, bool ok)
+{
+    j->done = true;
+    l->done++;
+    if (!ok)
+    {
+        l->errors++;
+        if (j->out != 0)
+        {
+            j->out->head = 0;
+            j->out->size = 0;
+        }
+    }
+}
+
+/// @private
+/// @brief The size of the file to load, asking the host only once.
+static size_t _ff_loader_file_size(LoadJob *j)
+{
+    if (!j->started)
+    {
+        j->started = true;
+        j->file_size = get_file_size_str(j->path);
+    }
+    return j->file_size;
+}
+
+/// @private
+/// @brief Run one step of the job within the budget.
+/// @details Returns false if a custom step did nothing and didn't finish.
+static bool _ff_loader_step(Loader *l, LoadJob *j, size_t *budget)
+{
+    switch (j->kind)
+    {
+    case _FF_LOAD_FILE:
+    {
+        size_t size = _ff_loader_file_size(j);
+        Buffer buf = size == 0 ? (Buffer){0, 0} : arena_alloc(l->arena, size);
+        if (buf.head == 0)
+        {
+            _ff_loader_finish(l, j, false);
+            return true;
+        }
+        *j->out = load_file_str(j->path, buf);
+        *budget = size > *budget ? 0 : *budget - size;
+        l->bytes += size;
+        _ff_loader_finish(l, j, true);
+        return true;
+    }
+    case _FF_LOAD_DECOMPRESS:
+    {
+        if (!j->started)
+        {
+            j->started = true;
+            size_t size = lz_decompressed_size(*j->src);
+            Buffer buf = size == 0 ? (Buffer){0, 0} : arena_alloc(l->arena, size);
+            if (buf.head == 0)
+            {
+                _ff_loader_finish(l, j, false);
+                return true;
+            }
+            j->stream = new_lz_stream(*j->src, buf);
+        }
+        size_t before = j->stream.dst_pos;
+        bool finished = lz_stream_step(&j->stream, *budget == 0 ? 1 : *budget);
+        size_t did = j->stream.dst_pos - before;
+        *budget = did > *budget ? 0 : *budget - did;
+        l->bytes += did;
+        if (finished)
+        {
+            j->out->head = j->stream.dst.head;
+            j->out->size = j->stream.total;
+            _ff_loader_finish(l, j, !j->stream.error);
+        }
+        return true;
+    }
+    case _FF_LOAD_CALL:
+    {
+        size_t before = *budget;
+        bool finished = j->step(j->ctx, budget);
+        l->bytes += before - *budget;
+        if (finished)
+        {
+            _ff_loader_finish(l, j, true);
+        }
+        else if (*budget == before)
+        {
+            // The step did nothing, don't spin on it until the next update.
+            *budget = 0;
+            return false;
+        }
+        return true;
+    }
+    }
+    return true;
+}
+
+/// @brief Run the queued jobs until the budget for this update is spent.
+void loader_update(Loader *l)
+{
+    size_t budget = l->budget;
+    bool first = true;
+    while (first || budget > 0)
+    {
+        LoadJob *j = _ff_loader_next(l, LOAD_NORMAL);
+        if (j == 0)
+        {
+            return;
+        }
+        // Don't start a file bigger than what's left, unless nothing ran yet.
+        if (!first && j->kind == _FF_LOAD_FILE && _ff_loader_file_size(j) > budget)
+        {
+            return;
+        }
+        _ff_loader_step(l, j, &budget);
+        first = false;
+    }
+}
+
+/// @brief Run all critical jobs (and their dependencies) right now, ignoring the budget.
+/// @details Stops at a custom step that makes no progress even with
+/// an unlimited budget, leaving it and the jobs after it to loader_update.
+void loader_finish_critical(Loader *l)
+{
+    LoadJob *j;
+    while ((j = _ff_loader_next(l, LOAD_CRITICAL)) != 0)
+    {
+        size_t budget = SIZE_MAX;
+        if (!_ff_loader_step(l, j, &budget))
+        {
+            return;
+        }
+    }
+}
+
+/// @brief The share of finished jobs, from 0.0 to 1.0, for a loading screen.
+/// @details A running decompression counts partially.
+float loader_progress(const Loader *l)
+{
+    if (l->len == 0)
+    {
+        return 1.0f;
+    }
+    float done = (float)l->done;
+    for (int32_t i = 0; i < l->len; i++)
+    {
+        const LoadJob *j = &l->jobs[i];
+        if (!j->done && j->started && j->stream.total > 0)
+        {
+            done += (float)j->stream.dst_pos / (float)j->stream.total;
+        }
+    }
+    return done / (float)l->len;
+}
+
+/// @brief Check if all jobs are finished.
+bool loader_is_done(const Loader *l)
+{
+    return l->done == l->len;
+}
+
+/// @brief Check if the job with the given ID is finished.
+bool loader_job_done(const Loader *l, int32_t job)
+{
+    return job >= 0 && job < l->len && l->jobs[job].done;
+}
@@ -0,0 +1,102 @@
+/// @file
+/// @brief Loading assets over multiple updates instead of stalling in boot.
+///
+/// @details Queue the jobs in boot and call loader_update at the start
+/// of every update. Each call runs jobs until the per-update budget is spent.
+/// The budget is in bytes: loading a file costs its size, decompressing
+/// costs the decompressed bytes, and custom steps report their own cost.
+/// At least one step runs per update, so a job bigger than the budget
+/// still makes progress.
+///
+/// Jobs run in the order they were added, critical jobs first. A job
+/// can depend on another one (decompress what was loaded, pre-render what
+/// was decompressed), then the dependency always runs first.
+///
+/// ```c
+/// Loader loader = new_loader(&arena, 16 * 1024);
+/// int32_t packed = loader_load(&loader, STR("level1"), &levelPacked, LOAD_NORMAL);
+/// loader_decompress(&loader, &levelPacked, &level, packed, LOAD_NORMAL);
+/// loader_load(&loader, STR("font"), &font, LOAD_CRITICAL);
+/// ```
+///
+/// Build firefly_alloc.c and firefly_lz.c as well.
+
+#pragma once
+
+#include "firefly.h"
+#include "firefly_alloc.h"
+#include "firefly_lz.h"
+
+/// @brief The maximum number of jobs in a loader.
+#define LOADER_MAX_JOBS 64
+
+/// @brief How urgent the job is.
+enum LoadPriority
+{
+    /// @brief Run in the order the jobs were added.
+    LOAD_NORMAL = 0,
+    /// @brief Run before all normal jobs, like the font for the loading screen.
+    LOAD_CRITICAL = 1,
+};
+typedef enum LoadPriority LoadPriority;
+
+/// @brief A custom job step, like pre-rendering a canvas.
+/// @details Do at most `*budget` bytes worth of work and subtract what was done.
+/// Return true when the job is finished.
+typedef bool (*LoadStep)(void *ctx, size_t *budget);
+
+/// @private
+enum _ffLoadKind
+{
+    _FF_LOAD_FILE,
+    _FF_LOAD_DECOMPRESS,
+    _FF_LOAD_CALL,
+};
+
+/// @private
+struct LoadJob
+{
+    enum _ffLoadKind kind;
+    LoadPriority priority;
+    int32_t after;
+    bool done;
+    bool started;
+    Str path;
+    size_t file_size;
+    const File *src;
+    File *out;
+    LzStream stream;
+    LoadStep step;
+    void *ctx;
+};
+typedef struct LoadJob LoadJob;
+
+/// @brief A queue of loading jobs run under a per-update budget.
+struct Loader
+{
+    /// @private
+    Arena *arena;
+    /// @private
+    LoadJob jobs[LOADER_MAX_JOBS];
+    /// @private
+    int32_t len;
+    /// @brief The number of bytes of work to do per loader_update.
+    size_t budget;
+    /// @brief The number of finished jobs.
+    int32_t done;
+    /// @brief The number of jobs that failed: missing files, broken data, or no memory.
+    int32_t errors;
+    /// @brief The number of bytes of work done so far.
+    size_t bytes;
+};
+typedef struct Loader Loader;
+
+Loader new_loader(Arena *arena, size_t budget);
+int32_t loader_load(Loader *l, Str path, File *out, LoadPriority p);
+int32_t loader_decompress(Loader *l, const File *src, File *out, int32_t after, LoadPriority p);
+int32_t loader_call(Loader *l, LoadStep step, void *ctx, int32_t after, LoadPriority p);
+void loader_update(Loader *l);
+void loader_finish_critical(Loader *l);
+float loader_progress(const Loader *l);
+bool loader_is_done(const Loader *l);
+bool loader_job_done(const Loader *l, int32_t job);
@@ -0,0 +1,175 @@
+/// @file
+/// @brief The implementation of LZ4 decompression. See firefly_lz.h.
+
+#include "firefly_lz.h"
+#include <string.h>
+
+/// @brief Check if the file has the compressed file header.
+bool lz_is_compressed(File src)
+{
+    return src.head != 0 && src.size >= LZ_HEADER_SIZE &&
+           memcmp(src.head, "FFZ1", 4) == 0;
+}
+
+/// @brief Get the size of the decompressed data. Returns 0 for an invalid file.
+size_t lz_decompressed_size(File src)
+{
+    if (!lz_is_compressed(src))
+    {
+        return 0;
+    }
+    const uint8_t *h = (const uint8_t *)src.head + 4;
+    return (size_t)h[0] | (size_t)h[1] << 8 | (size_t)h[2] << 16 | (size_t)h[3] << 24;
+}
+
+/// @brief Start a decompression into the given buffer.
+/// @details The buffer must be at least lz_decompressed_size bytes.
+/// Both the source and the buffer must stay alive until it is done.
+LzStream new_lz_stream(File src, Buffer dst)
+{
+    LzStream s;
+    memset(&s, 0, sizeof(s));
+    s.src = src;
+    s.src_pos = LZ_HEADER_SIZE;
+    s.dst = dst;
+    s.total = lz_decompressed_size(src);
+    s.error = s.total == 0 || s.total > dst.size;
+    return s;
+}
+
+/// @private
+/// @brief Read an extended LZ4 length. Returns false if the input ends.
+static bool _ff_lz_length(const uint8_t *src, size_t len, size_t *pos, size_t *value)
+{
+    uint8_t b;
+    do
+    {
+        if (*pos >= len)
+        {
+            return false;
+        }
+        b = src[(*pos)++];
+        *value += b;
+    } while (b == 255);
+    return true;
+}
+
+/// @brief Decompress whole sequences until at least the given number of bytes is produced.
+///
+/// @details Returns true when the stream is finished, either successfully
+/// or with an error (check `error`). Pass SIZE_MAX to decompress everything.
+bool lz_stream_step(LzStream *s, size_t max_out)
+{
+    if (s->error)
+    {
+        return true;
+    }
+    const uint8_t *src = (const uint8_t *)s->src.head;
+    uint8_t *dst = (uint8_t *)s->dst.head;
+    size_t srcLen = s->src.size;
+    size_t ip = s->src_pos;
+    size_t op = s->dst_pos;
+    size_t end = s->total;
+    size_t stop = max_out > end - op ? end : op + max_out;
+    while (op < stop)
+    {
+        if (ip >= srcLen)
+        {
+            s->error = true;
+            return true;
+        }
+        uint8_t token = src[ip++];
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !_ff_lz_length(src, srcLen, &ip, &lit))
+        {
+            s->error = true;
+            return true;
+        }
+        if (lit > srcLen - ip || lit > end - op)
+        {
+            s->error = true;
+            return true;
+        }
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+        // The last sequence has only literals.
+        if (op == end)
+        {
+            break;
+        }
+
+        if (srcLen - ip < 2)
+        {
+            s->error = true;
+            return true;
+        }
+        size_t offset = (size_t)src[ip] | (size_t)src[ip + 1] << 8;
+        ip += 2;
+        size_t match = token & 15;
+        if (match == 15 && !_ff_lz_length(src, srcLen, &ip, &match))
+        {
+            s->error = true;
+            return true;
+        }
+        match += 4;
+        if (offset == 0 || offset > op || match > end - op)
+        {
+            s->error = true;
+            return true;
+        }
+        uint8_t *out = dst + op;
+        const uint8_t *from = out - offset;
+        if (offset >= match)
+        {
+            memcpy(out, from, match);
+        }
+        else
+        {
+            // Overlapping match: repeats the last `offset` bytes.
+            for (size_t i = 0; i < match; i++)
+            {
+                out[i] = from[i];
+            }
+        }
+        op += match;
+    }
+    s->src_pos = ip;
+    s->dst_pos = op;
+    return op == end;
+}
+
+/// @brief Decompress the whole file into the given buffer.
+/// @details Returns the decompressed data in the buffer memory or an empty file on error.
+File lz_decompress(File src, Buffer dst)
+{
+    File f = {0, 0};
+    LzStream s = new_lz_stream(src, dst);
+    lz_stream_step(&s, SIZE_MAX);
+    if (s.error)
+    {
+        return f;
+    }
+    f.head = dst.head;
+    f.size = s.total;
+    return f;
+}
+
+/// @brief Decompress the whole file into a buffer allocated in the arena.
+/// @details Returns an empty file on error or if out of memory.
+File lz_decompress_arena(Arena *a, File src)
+{
+    File f = {0, 0};
+    size_t size = lz_decompressed_size(src);
+    if (size == 0)
+    {
+        return f;
+    }
+    Buffer dst = arena_alloc(a, size);
+    if (dst.head == 0)
+    {
+        return f;
+    }
+    return lz_decompress(src, dst);
+}
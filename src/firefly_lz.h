@@ -0,0 +1,48 @@
+/// @file
+/// @brief Decompressing LZ4-compressed assets.
+///
+/// @details Compress files with tools/fflz.c. A compressed file is:
+///
+/// * the magic "FFZ1";
+/// * the decompressed size, a little-endian uint32;
+/// * a single LZ4 block (the raw block format, without the LZ4 frame).
+///
+/// Compressed files can be loaded with load_file or stored in a bundle.
+/// Decompress them all at once with lz_decompress, or a bit per update
+/// with LzStream to spread the work over several frames.
+///
+/// The decompressor checks all bounds, so a broken file results
+/// in an error and not in memory corruption.
+
+#pragma once
+
+#include "firefly.h"
+#include "firefly_alloc.h"
+
+/// @brief The size of the compressed file header, in bytes.
+#define LZ_HEADER_SIZE 8
+
+/// @brief The state of a decompression spread over multiple steps.
+struct LzStream
+{
+    /// @private
+    File src;
+    /// @private
+    size_t src_pos;
+    /// @brief The decompressed data, growing with every step.
+    Buffer dst;
+    /// @brief How many bytes are decompressed so far.
+    size_t dst_pos;
+    /// @brief The decompressed size from the header.
+    size_t total;
+    /// @brief True if the file is invalid, corrupted, or doesn't fit into the buffer.
+    bool error;
+};
+typedef struct LzStream LzStream;
+
+bool lz_is_compressed(File src);
+size_t lz_decompressed_size(File src);
+File lz_decompress(File src, Buffer dst);
+File lz_decompress_arena(Arena *a, File src);
+LzStream new_lz_stream(File src, Buffer dst);
+bool lz_stream_step(LzStream *s, size_t max_out);
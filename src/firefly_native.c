@@ -0,0 +1,1860 @@
+/// @file
+/// @brief The native host runtime implementing firefly_bindings.h.
+///
+/// @details See firefly_native.h for how to build and run an app with it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "firefly_native.h"
+#include "firefly_bindings.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PEERS 32
+#define MAX_PATH 512
+#define MAX_STASH 80
+#define MAX_STATS 256
+#define MAX_AUDIO_NODES 1024
+#define MAX_SCRIPT_EVENTS 4096
+#define PAD_UNTOUCHED 0xffff
+#define COMBINED_PEER 0xFF
+#define PI_F 3.14159265358979323846f
+
+// The app callbacks. Any of them may be missing.
+__attribute__((weak)) void boot();
+__attribute__((weak)) void update();
+__attribute__((weak)) void render();
+__attribute__((weak)) int32_t cheat(int32_t cmd, int32_t val);
+__attribute__((weak)) void before_exit();
+
+// -- STATE -- //
+
+struct Stat
+{
+    bool used;
+    bool score;
+    int32_t peer;
+    uint32_t id;
+    int32_t value;
+    uint16_t goal;
+};
+
+struct ScriptEvent
+{
+    uint32_t frame;
+    int32_t peer;
+    uint32_t buttons;
+    int32_t pad;
+};
+
+static struct
+{
+    const char *rom_dir;
+    const char *data_dir;
+    uint32_t online;
+    int32_t me;
+    bool quit;
+    bool restart;
+    uintptr_t seed;
+
+    uint8_t frame[NATIVE_HEIGHT * NATIVE_WIDTH];
+    uint8_t palette[16 * 3];
+    uint8_t *canvas;
+    size_t canvas_size;
+
+    int32_t pads[MAX_PEERS];
+    uint32_t buttons[MAX_PEERS];
+    NativeInputSource input;
+    void *input_ctx;
+    struct ScriptEvent *script;
+    size_t script_len;
+    size_t script_pos;
+
+    uint8_t stash[MAX_PEERS][MAX_STASH];
+    size_t stash_size[MAX_PEERS];
+    struct Stat stats[MAX_STATS];
+    uint16_t badge_goals[MAX_STATS];
+
+    bool audio;
+    float audio_frame[NATIVE_AUDIO_FRAMES * 2];
+
+    NativeStats timings;
+} rt = {
+    .rom_dir = ".",
+    .data_dir = "data",
+    .online = 1,
+    .me = 0,
+    .seed = 0x2545F491,
+    .pads = {[0 ... MAX_PEERS - 1] = PAD_UNTOUCHED},
+    .audio = true,
+    .palette = {
+        0x1A, 0x1C, 0x2C, // black
+        0x5D, 0x27, 0x5D, // purple
+        0xB1, 0x3E, 0x53, // red
+        0xEF, 0x7D, 0x57, // orange
+        0xFF, 0xCD, 0x75, // yellow
+        0xA7, 0xF0, 0x70, // light green
+        0x38, 0xB7, 0x64, // green
+        0x25, 0x71, 0x79, // dark green
+        0x29, 0x36, 0x6F, // dark blue
+        0x3B, 0x5D, 0xC9, // blue
+        0x41, 0xA6, 0xF6, // light blue
+        0x73, 0xEF, 0xF7, // cyan
+        0xF4, 0xF4, 0xF4, // white
+        0x94, 0xB0, 0xC2, // light gray
+        0x56, 0x6C, 0x86, // gray
+        0x33, 0x3C, 0x57, // dark gray
+    },
+};
+
+// -- TARGET -- //
+
+// Parsed header of an image in the Firefly Zero format.
+//
+// Layout: magic (0x21), bits per pixel (1, 2, or 4), width (u16 LE),
+// transparent color, color swaps (2 per byte), packed pixels (high bits first).
+struct ImageInfo
+{
+    const uint8_t *pixels;
+    int32_t bpp;
+    int32_t width;
+    int32_t height;
+    int32_t transparent;
+    const uint8_t *swaps;
+};
+
+static bool parse_image(const uint8_t *raw, size_t len, struct ImageInfo *info)
+{
+    if (len < 5 || raw[0] != 0x21)
+    {
+        return false;
+    }
+    int32_t bpp = raw[1];
+    if (bpp != 1 && bpp != 2 && bpp != 4)
+    {
+        return false;
+    }
+    size_t header = 5 + (1u << bpp) / 2;
+    int32_t width = raw[2] | (raw[3] << 8);
+    if (len < header || width == 0)
+    {
+        return false;
+    }
+    info->bpp = bpp;
+    info->width = width;
+    info->height = (int32_t)((len - header) * 8 / bpp / width);
+    info->transparent = raw[4];
+    info->swaps = raw + 5;
+    info->pixels = raw + header;
+    return true;
+}
+
+static int32_t image_color(const struct ImageInfo *info, int32_t x, int32_t y)
+{
+    size_t bit = ((size_t)y * info->width + x) * info->bpp;
+    uint8_t byte = info->pixels[bit / 8];
+    uint8_t mask = (1u << info->bpp) - 1;
+    uint8_t value = (byte >> (8 - info->bpp - bit % 8)) & mask;
+    uint8_t swap = info->swaps[value / 2];
+    return value % 2 == 0 ? swap >> 4 : swap & 0xf;
+}
+
+// Set a pixel on the current target. The color is a Color (1-16), 0 is ignored.
+static void put(int32_t x, int32_t y, int32_t c)
+{
+    if (c <= 0 || c > 16)
+    {
+        return;
+    }
+    if (rt.canvas == NULL)
+    {
+        if (x >= 0 && y >= 0 && x < NATIVE_WIDTH && y < NATIVE_HEIGHT)
+        {
+            rt.frame[y * NATIVE_WIDTH + x] = (uint8_t)(c - 1);
+        }
+        return;
+    }
+    struct ImageInfo info;
+    if (!parse_image(rt.canvas, rt.canvas_size, &info))
+    {
+        return;
+    }
+    if (x < 0 || y < 0 || x >= info.width || y >= info.height)
+    {
+        return;
+    }
+    size_t bit = ((size_t)y * info.width + x) * info.bpp;
+    uint8_t *byte = (uint8_t *)info.pixels + bit / 8;
+    uint8_t mask = (1u << info.bpp) - 1;
+    uint8_t shift = 8 - info.bpp - bit % 8;
+    *byte = (*byte & ~(mask << shift)) | (((c - 1) & mask) << shift);
+}
+
+static void target_size(int32_t *w, int32_t *h)
+{
+    struct ImageInfo info;
+    if (rt.canvas != NULL && parse_image(rt.canvas, rt.canvas_size, &info))
+    {
+        *w = info.width;
+        *h = info.height;
+        return;
+    }
+    *w = NATIVE_WIDTH;
+    *h = NATIVE_HEIGHT;
+}
+
+// -- SHAPES -- //
+
+enum ShapeKind
+{
+    SHAPE_RECT,
+    SHAPE_ROUNDED_RECT,
+    SHAPE_ELLIPSE,
+    SHAPE_SECTOR,
+};
+
+struct Shape
+{
+    enum ShapeKind kind;
+    int32_t x, y, w, h;
+    // Corner size for rounded rects.
+    int32_t cw, ch;
+    // Angles for sectors.
+    float start, sweep;
+};
+
+// Check if the pixel center is inside the ellipse inscribed in the box.
+static bool in_ellipse(int32_t px, int32_t py, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    if (w <= 0 || h <= 0)
+    {
+        return false;
+    }
+    int64_t dx = 2 * (int64_t)px + 1 - (2 * (int64_t)x + w);
+    int64_t dy = 2 * (int64_t)py + 1 - (2 * (int64_t)y + h);
+    int64_t ww = (int64_t)w * w;
+    int64_t hh = (int64_t)h * h;
+    return dx * dx * hh + dy * dy * ww <= ww * hh;
+}
+
+static bool in_angle(int32_t px, int32_t py, const struct Shape *s)
+{
+    float dx = (float)px + 0.5f - ((float)s->x + (float)s->w / 2);
+    float dy = (float)py + 0.5f - ((float)s->y + (float)s->h / 2);
+    float sweep = s->sweep;
+    float start = s->start;
+    if (sweep < 0)
+    {
+        start += sweep;
+        sweep = -sweep;
+    }
+    if (sweep >= 2 * PI_F)
+    {
+        return true;
+    }
+    float a = atan2f(dy, dx) - start;
+    a = fmodf(a, 2 * PI_F);
+    if (a < 0)
+    {
+        a += 2 * PI_F;
+    }
+    return a <= sweep;
+}
+
+static bool in_shape(int32_t px, int32_t py, const struct Shape *s)
+{
+    if (px < s->x || py < s->y || px >= s->x + s->w || py >= s->y + s->h)
+    {
+        return false;
+    }
+    switch (s->kind)
+    {
+    case SHAPE_RECT:
+        return true;
+    case SHAPE_ROUNDED_RECT:
+    {
+        int32_t cw = s->cw < s->w / 2 ? s->cw : s->w / 2;
+        int32_t ch = s->ch < s->h / 2 ? s->ch : s->h / 2;
+        if (cw <= 0 || ch <= 0)
+        {
+            return true;
+        }
+        int32_t left = s->x + cw;
+        int32_t right = s->x + s->w - cw;
+        int32_t top = s->y + ch;
+        int32_t bottom = s->y + s->h - ch;
+        if ((px >= left && px < right) || (py >= top && py < bottom))
+        {
+            return true;
+        }
+        int32_t cx = px < left ? s->x : right - cw;
+        int32_t cy = py < top ? s->y : bottom - ch;
+        return in_ellipse(px, py, cx, cy, 2 * cw, 2 * ch);
+    }
+    case SHAPE_ELLIPSE:
+        return in_ellipse(px, py, s->x, s->y, s->w, s->h);
+    case SHAPE_SECTOR:
+        return in_ellipse(px, py, s->x, s->y, s->w, s->h) && in_angle(px, py, s);
+    }
+    return false;
+}
+
+// Draw a shape with the given fill and a stroke inside of its bounds.
+static void draw_shape(const struct Shape *s, int32_t fc, int32_t sc, int32_t sw)
+{
+    int32_t tw, th;
+    target_size(&tw, &th);
+    int32_t x0 = s->x < 0 ? 0 : s->x;
+    int32_t y0 = s->y < 0 ? 0 : s->y;
+    int32_t x1 = s->x + s->w > tw ? tw : s->x + s->w;
+    int32_t y1 = s->y + s->h > th ? th : s->y + s->h;
+    struct Shape inner = *s;
+    inner.x += sw;
+    inner.y += sw;
+    inner.w -= 2 * sw;
+    inner.h -= 2 * sw;
+    inner.cw -= sw;
+    inner.ch -= sw;
+    for (int32_t py = y0; py < y1; py++)
+    {
+        for (int32_t px = x0; px < x1; px++)
+        {
+            if (!in_shape(px, py, s))
+            {
+                continue;
+            }
+            bool filled = sw <= 0 || in_shape(px, py, &inner);
+            put(px, py, filled ? fc : sc);
+        }
+    }
+}
+
+static void stamp(int32_t x, int32_t y, int32_t c, int32_t w)
+{
+    if (w <= 1)
+    {
+        put(x, y, c);
+        return;
+    }
+    for (int32_t dy = -w / 2; dy < w - w / 2; dy++)
+    {
+        for (int32_t dx = -w / 2; dx < w - w / 2; dx++)
+        {
+            put(x + dx, y + dy, c);
+        }
+    }
+}
+
+static void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t c, int32_t w)
+{
+    int32_t dx = abs(x2 - x1);
+    int32_t dy = -abs(y2 - y1);
+    int32_t sx = x1 < x2 ? 1 : -1;
+    int32_t sy = y1 < y2 ? 1 : -1;
+    int32_t err = dx + dy;
+    for (;;)
+    {
+        stamp(x1, y1, c, w);
+        if (x1 == x2 && y1 == y2)
+        {
+            return;
+        }
+        int32_t e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x1 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+static int64_t edge(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t px, int32_t py)
+{
+    return (int64_t)(bx - ax) * (py - ay) - (int64_t)(by - ay) * (px - ax);
+}
+
+// -- GRAPHICS -- //
+
+void _ffb_clear_screen(int32_t c)
+{
+    int32_t w, h;
+    target_size(&w, &h);
+    if (rt.canvas == NULL && c > 0 && c <= 16)
+    {
+        memset(rt.frame, c - 1, sizeof(rt.frame));
+        return;
+    }
+    for (int32_t y = 0; y < h; y++)
+    {
+        for (int32_t x = 0; x < w; x++)
+        {
+            put(x, y, c);
+        }
+    }
+}
+
+void _ffb_set_color(int32_t c, int32_t r, int32_t g, int32_t b)
+{
+    if (c <= 0 || c > 16)
+    {
+        return;
+    }
+    rt.palette[(c - 1) * 3 + 0] = (uint8_t)r;
+    rt.palette[(c - 1) * 3 + 1] = (uint8_t)g;
+    rt.palette[(c - 1) * 3 + 2] = (uint8_t)b;
+}
+
+void _ffb_draw_point(int32_t x, int32_t y, int32_t c)
+{
+    put(x, y, c);
+}
+
+void _ffb_draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t color, int32_t stroke_width)
+{
+    line(x1, y1, x2, y2, color, stroke_width);
+}
+
+void _ffb_draw_rect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t fc, int32_t sc, int32_t sw)
+{
+    struct Shape s = {.kind = SHAPE_RECT, .x = x, .y = y, .w = w, .h = h};
+    draw_shape(&s, fc, sc, sw);
+}
+
+void _ffb_draw_rounded_rect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t cw, int32_t ch, int32_t fc, int32_t sc, int32_t sw)
+{
+    struct Shape s = {.kind = SHAPE_ROUNDED_RECT, .x = x, .y = y, .w = w, .h = h, .cw = cw, .ch = ch};
+    draw_shape(&s, fc, sc, sw);
+}
+
+void _ffb_draw_circle(int32_t x, int32_t y, int32_t d, int32_t fc, int32_t sc, int32_t sw)
+{
+    struct Shape s = {.kind = SHAPE_ELLIPSE, .x = x, .y = y, .w = d, .h = d};
+    draw_shape(&s, fc, sc, sw);
+}
+
+void _ffb_draw_ellipse(int32_t x, int32_t y, int32_t w, int32_t h, int32_t fc, int32_t sc, int32_t sw)
+{
+    struct Shape s = {.kind = SHAPE_ELLIPSE, .x = x, .y = y, .w = w, .h = h};
+    draw_shape(&s, fc, sc, sw);
+}
+
+void _ffb_draw_triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, int32_t fc, int32_t sc, int32_t sw)
+{
+    if (edge(x1, y1, x2, y2, x3, y3) < 0)
+    {
+        int32_t tx = x2, ty = y2;
+        x2 = x3, y2 = y3;
+        x3 = tx, y3 = ty;
+    }
+    int32_t w, h;
+    target_size(&w, &h);
+    int32_t minX = x1 < x2 ? (x1 < x3 ? x1 : x3) : (x2 < x3 ? x2 : x3);
+    int32_t minY = y1 < y2 ? (y1 < y3 ? y1 : y3) : (y2 < y3 ? y2 : y3);
+    int32_t maxX = x1 > x2 ? (x1 > x3 ? x1 : x3) : (x2 > x3 ? x2 : x3);
+    int32_t maxY = y1 > y2 ? (y1 > y3 ? y1 : y3) : (y2 > y3 ? y2 : y3);
+    minX = minX < 0 ? 0 : minX;
+    minY = minY < 0 ? 0 : minY;
+    maxX = maxX >= w ? w - 1 : maxX;
+    maxY = maxY >= h ? h - 1 : maxY;
+    if (fc != 0)
+    {
+        for (int32_t py = minY; py <= maxY; py++)
+        {
+            for (int32_t px = minX; px <= maxX; px++)
+            {
+                if (edge(x1, y1, x2, y2, px, py) >= 0 &&
+                    edge(x2, y2, x3, y3, px, py) >= 0 &&
+                    edge(x3, y3, x1, y1, px, py) >= 0)
+                {
+                    put(px, py, fc);
+                }
+            }
+        }
+    }
+    if (sw > 0)
+    {
+        line(x1, y1, x2, y2, sc, sw);
+        line(x2, y2, x3, y3, sc, sw);
+        line(x3, y3, x1, y1, sc, sw);
+    }
+}
+
+void _ffb_draw_arc(int32_t x, int32_t y, int32_t d, float ast, float asw, int32_t fc, int32_t sc, int32_t sw)
+{
+    // An arc has no interior, only the stroke is drawn.
+    (void)fc;
+    struct Shape s = {.kind = SHAPE_SECTOR, .x = x, .y = y, .w = d, .h = d, .start = ast, .sweep = asw};
+    draw_shape(&s, 0, sc, sw > 0 ? sw : 1);
+}
+
+void _ffb_draw_sector(int32_t x, int32_t y, int32_t d, float ast, float asw, int32_t fc, int32_t sc, int32_t sw)
+{
+    struct Shape s = {.kind = SHAPE_SECTOR, .x = x, .y = y, .w = d, .h = d, .start = ast, .sweep = asw};
+    draw_shape(&s, fc, sc, sw);
+    if (sw > 0)
+    {
+        int32_t cx = x + d / 2;
+        int32_t cy = y + d / 2;
+        float r = (float)d / 2;
+        line(cx, cy, cx + (int32_t)(r * cosf(ast)), cy + (int32_t)(r * sinf(ast)), sc, sw);
+        line(cx, cy, cx + (int32_t)(r * cosf(ast + asw)), cy + (int32_t)(r * sinf(ast + asw)), sc, sw);
+    }
+}
+
+// Fonts: magic, encoding, glyph width, glyph height, baseline,
+// followed by a 1-bit glyph atlas for ASCII starting from space,
+// 16 glyphs per row, most significant bit first.
+void _ffb_draw_text(uintptr_t textPtr, int32_t textLen, uintptr_t fontPtr, int32_t fontLen, int32_t x, int32_t y, int32_t color)
+{
+    const uint8_t *text = (const uint8_t *)textPtr;
+    const uint8_t *font = (const uint8_t *)fontPtr;
+    if (fontLen < 5)
+    {
+        return;
+    }
+    int32_t gw = font[2];
+    int32_t gh = font[3];
+    int32_t top = y - font[4];
+    int32_t stride = 16 * gw;
+    const uint8_t *atlas = font + 5;
+    size_t atlasBits = (size_t)(fontLen - 5) * 8;
+    int32_t cx = x;
+    for (int32_t i = 0; i < textLen; i++)
+    {
+        uint8_t ch = text[i];
+        if (ch == '\n')
+        {
+            cx = x;
+            top += gh;
+            continue;
+        }
+        int32_t glyph = ch >= 32 && ch < 128 ? ch - 32 : '?' - 32;
+        int32_t gx = (glyph % 16) * gw;
+        int32_t gy = (glyph / 16) * gh;
+        for (int32_t dy = 0; dy < gh; dy++)
+        {
+            for (int32_t dx = 0; dx < gw; dx++)
+            {
+                size_t bit = (size_t)(gy + dy) * stride + gx + dx;
+                if (bit < atlasBits && (atlas[bit / 8] >> (7 - bit % 8)) & 1)
+                {
+                    put(cx + dx, top + dy, color);
+                }
+            }
+        }
+        cx += gw;
+    }
+}
+
+// The native runtime does not encode real QR codes. It draws a deterministic
+// pattern of the same size as a byte-mode QR code with low error correction.
+void _ffb_draw_qr(uintptr_t ptr, int32_t len, int32_t x, int32_t y, int32_t black, int32_t white)
+{
+    static const int32_t capacity[] = {17, 32, 53, 78, 106, 134, 154, 192, 230, 271};
+    int32_t version = 1;
+    while (version < 10 && capacity[version - 1] < len)
+    {
+        version++;
+    }
+    int32_t size = 17 + 4 * version;
+    const uint8_t *text = (const uint8_t *)ptr;
+    uint32_t hash = 2166136261u;
+    for (int32_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ text[i]) * 16777619u;
+    }
+    for (int32_t py = 0; py < size; py++)
+    {
+        for (int32_t px = 0; px < size; px++)
+        {
+            hash ^= hash << 13;
+            hash ^= hash >> 17;
+            hash ^= hash << 5;
+            put(x + px, y + py, (hash & 1) ? black : white);
+        }
+    }
+}
+
+static void blit(uintptr_t ptr, uintptr_t len, int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw, int32_t sh)
+{
+    struct ImageInfo info;
+    if (!parse_image((const uint8_t *)ptr, len, &info))
+    {
+        return;
+    }
+    if (sw < 0 || sx + sw > info.width)
+    {
+        sw = info.width - sx;
+    }
+    if (sh < 0 || sy + sh > info.height)
+    {
+        sh = info.height - sy;
+    }
+    for (int32_t dy = 0; dy < sh; dy++)
+    {
+        for (int32_t dx = 0; dx < sw; dx++)
+        {
+            int32_t c = image_color(&info, sx + dx, sy + dy);
+            if (c != info.transparent)
+            {
+                put(x + dx, y + dy, c + 1);
+            }
+        }
+    }
+}
+
+void _ffb_draw_image(uintptr_t ptr, int32_t len, int32_t x, int32_t y)
+{
+    blit(ptr, len, x, y, 0, 0, -1, -1);
+}
+
+void _ffb_draw_sub_image(uintptr_t ptr, uintptr_t len, int32_t x, int32_t y, int32_t subX, int32_t subY, int32_t subWidth, int32_t subHeight)
+{
+    if (subX < 0 || subY < 0)
+    {
+        return;
+    }
+    blit(ptr, len, x, y, subX, subY, subWidth, subHeight);
+}
+
+void _ffb_set_canvas(uintptr_t ptr, uintptr_t len)
+{
+    rt.canvas = (uint8_t *)ptr;
+    rt.canvas_size = len;
+}
+
+void _ffb_unset_canvas()
+{
+    rt.canvas = NULL;
+    rt.canvas_size = 0;
+}
+
+// -- INPUT -- //
+
+static bool valid_peer(int32_t peer)
+{
+    return peer >= 0 && peer < MAX_PEERS;
+}
+
+int32_t _ffb_read_pad(int32_t player)
+{
+    return valid_peer(player) ? rt.pads[player] : PAD_UNTOUCHED;
+}
+
+int32_t _ffb_read_buttons(int32_t player)
+{
+    return valid_peer(player) ? (int32_t)rt.buttons[player] : 0;
+}
+
+// -- FS -- //
+
+static void join_path(char *out, const char *dir, uintptr_t pathPtr, uintptr_t pathLen)
+{
+    size_t dirLen = strlen(dir);
+    if (dirLen + 1 + pathLen >= MAX_PATH)
+    {
+        out[0] = 0;
+        return;
+    }
+    memcpy(out, dir, dirLen);
+    out[dirLen] = '/';
+    memcpy(out + dirLen + 1, (const char *)pathPtr, pathLen);
+    out[dirLen + 1 + pathLen] = 0;
+}
+
+// Open a file from the data dir or, if there is none, from the ROM.
+static FILE *open_file(uintptr_t pathPtr, uintptr_t pathLen)
+{
+    char path[MAX_PATH];
+    join_path(path, rt.data_dir, pathPtr, pathLen);
+    FILE *f = path[0] ? fopen(path, "rb") : NULL;
+    if (f != NULL)
+    {
+        return f;
+    }
+    join_path(path, rt.rom_dir, pathPtr, pathLen);
+    return path[0] ? fopen(path, "rb") : NULL;
+}
+
+int32_t _ffb_get_file_size(uintptr_t pathPtr, uintptr_t pathLen)
+{
+    FILE *f = open_file(pathPtr, pathLen);
+    if (f == NULL)
+    {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size < 0 ? 0 : (int32_t)size;
+}
+
+uintptr_t _ffb_load_file(uintptr_t pathPtr, uintptr_t pathLen, uintptr_t bufPtr, uintptr_t bufLen)
+{
+    FILE *f = open_file(pathPtr, pathLen);
+    if (f == NULL)
+    {
+        return 0;
+    }
+    size_t read = fread((void *)bufPtr, 1, bufLen, f);
+    fclose(f);
+    return read;
+}
+
+uintptr_t _ffb_dump_file(uintptr_t pathPtr, uintptr_t pathLen, uintptr_t bufPtr, uintptr_t bufLen)
+{
+    char path[MAX_PATH];
+    join_path(path, rt.data_dir, pathPtr, pathLen);
+    if (path[0] == 0)
+    {
+        return 0;
+    }
+    mkdir(rt.data_dir, 0755);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "[native] cannot write %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    size_t written = fwrite((const void *)bufPtr, 1, bufLen, f);
+    fclose(f);
+    return written;
+}
+
+void _ffb_remove_file(uintptr_t pathPtr, uintptr_t pathLen)
+{
+    char path[MAX_PATH];
+    join_path(path, rt.data_dir, pathPtr, pathLen);
+    if (path[0])
+    {
+        unlink(path);
+    }
+}
+
+// -- NET -- //
+
+int32_t _ffb_get_me()
+{
+    return rt.me;
+}
+
+int32_t _ffb_get_peers()
+{
+    return (int32_t)rt.online;
+}
+
+void _ffb_save_stash(int32_t peerID, uintptr_t bufPtr, uintptr_t bufLen)
+{
+    if (!valid_peer(peerID))
+    {
+        return;
+    }
+    if (bufLen > MAX_STASH)
+    {
+        bufLen = MAX_STASH;
+    }
+    memcpy(rt.stash[peerID], (const void *)bufPtr, bufLen);
+    rt.stash_size[peerID] = bufLen;
+}
+
+int32_t _ffb_load_stash(int32_t peerID, uintptr_t bufPtr, uintptr_t bufLen)
+{
+    if (!valid_peer(peerID))
+    {
+        return 0;
+    }
+    size_t size = rt.stash_size[peerID];
+    if (size > bufLen)
+    {
+        size = bufLen;
+    }
+    memcpy((void *)bufPtr, rt.stash[peerID], size);
+    return (int32_t)size;
+}
+
+// -- STATS -- //
+
+static struct Stat *find_stat(bool score, int32_t peer, uint32_t id)
+{
+    struct Stat *free = NULL;
+    for (size_t i = 0; i < MAX_STATS; i++)
+    {
+        struct Stat *s = &rt.stats[i];
+        if (!s->used)
+        {
+            free = free ? free : s;
+            continue;
+        }
+        if (s->score == score && s->peer == peer && s->id == id)
+        {
+            return s;
+        }
+    }
+    if (free != NULL)
+    {
+        free->used = true;
+        free->score = score;
+        free->peer = peer;
+        free->id = id;
+        free->value = 0;
+        free->goal = id < MAX_STATS && rt.badge_goals[id] ? rt.badge_goals[id] : 1;
+    }
+    return free;
+}
+
+static uint32_t add_progress_one(int32_t peer, uint32_t badge, int32_t val)
+{
+    struct Stat *s = find_stat(false, peer, badge);
+    if (s == NULL)
+    {
+        return 0;
+    }
+    int32_t done = s->value + val;
+    done = done < 0 ? 0 : done > s->goal ? s->goal : done;
+    s->value = done;
+    return ((uint32_t)done << 16) | s->goal;
+}
+
+uintptr_t _ffb_add_progress(int32_t peerID, uintptr_t badgeID, int32_t val)
+{
+    if (peerID != COMBINED_PEER)
+    {
+        return add_progress_one(peerID, badgeID, val);
+    }
+    uint32_t lowest = 0xffffffff;
+    for (int32_t p = 0; p < MAX_PEERS; p++)
+    {
+        if ((rt.online >> p) & 1)
+        {
+            uint32_t r = add_progress_one(p, badgeID, val);
+            lowest = r < lowest ? r : lowest;
+        }
+    }
+    return lowest == 0xffffffff ? 0 : lowest;
+}
+
+static int32_t add_score_one(int32_t peer, uint32_t board, int32_t val)
+{
+    struct Stat *s = find_stat(true, peer, board);
+    if (s == NULL)
+    {
+        return 0;
+    }
+    if (val != 0 && (s->value == 0 || val > s->value))
+    {
+        s->value = val;
+    }
+    return s->value;
+}
+
+int32_t _ffb_add_score(int32_t peerID, uintptr_t badgeID, int32_t val)
+{
+    if (peerID != COMBINED_PEER)
+    {
+        return add_score_one(peerID, badgeID, val);
+    }
+    bool any = false;
+    int32_t lowest = 0;
+    for (int32_t p = 0; p < MAX_PEERS; p++)
+    {
+        if ((rt.online >> p) & 1)
+        {
+            int32_t r = add_score_one(p, badgeID, val);
+            lowest = !any || r < lowest ? r : lowest;
+            any = true;
+        }
+    }
+    return lowest;
+}
+
+// -- MISC -- //
+
+void _ffb_log_debug(uintptr_t ptr, uintptr_t len)
+{
+    fprintf(stderr, "[debug] %.*s\n", (int)len, (const char *)ptr);
+}
+
+void _ffb_log_error(uintptr_t ptr, uintptr_t len)
+{
+    fprintf(stderr, "[error] %.*s\n", (int)len, (const char *)ptr);
+}
+
+void _ffb_set_seed(uintptr_t seed)
+{
+    rt.seed = seed ? seed : 1;
+}
+
+uintptr_t _ffb_get_random()
+{
+    uint32_t x = (uint32_t)rt.seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rt.seed = x;
+    return x;
+}
+
+uintptr_t _ffb_get_name(int32_t peerID, uintptr_t ptr, uintptr_t len)
+{
+    char name[16];
+    int n = snprintf(name, sizeof(name), "native-%d", (int)peerID);
+    size_t size = (size_t)n < len ? (size_t)n : len;
+    memcpy((void *)ptr, name, size);
+    return size;
+}
+
+uint64_t _ffb_get_settings(int32_t peerID)
+{
+    (void)peerID;
+    // English, no flags, the default theme (black, gray, blue, white).
+    uint64_t theme = (0u << 20) | (14u << 16) | (9u << 12) | (12u << 8);
+    return theme << 32;
+}
+
+void _ffb_restart()
+{
+    rt.restart = true;
+}
+
+void _ffb_quit()
+{
+    rt.quit = true;
+}
+
+// -- AUDIO -- //
+
+enum NodeKind
+{
+    NODE_FREE,
+    NODE_SINE,
+    NODE_SQUARE,
+    NODE_SAWTOOTH,
+    NODE_TRIANGLE,
+    NODE_NOISE,
+    NODE_EMPTY,
+    NODE_ZERO,
+    NODE_FILE,
+    NODE_MIX,
+    NODE_ALL_FOR_ONE,
+    NODE_GAIN,
+    NODE_LOOP,
+    NODE_CONCAT,
+    NODE_PAN,
+    NODE_MUTE,
+    NODE_PAUSE,
+    NODE_TRACK_POSITION,
+    NODE_LOW_PASS,
+    NODE_HIGH_PASS,
+    NODE_TAKE_LEFT,
+    NODE_TAKE_RIGHT,
+    NODE_SWAP,
+    NODE_CLIP,
+};
+
+enum ModKind
+{
+    MOD_NONE,
+    MOD_LINEAR,
+    MOD_HOLD,
+    MOD_SINE,
+};
+
+struct AudioNodeState
+{
+    enum NodeKind kind;
+    uint32_t parent;
+    // Children form a singly linked list in the insertion order.
+    uint32_t first;
+    uint32_t last;
+    uint32_t next;
+    float params[3];
+    float phase;
+    uint32_t noise;
+    uint32_t time;
+    uint32_t current;
+    // Biquad filter state.
+    float b0, b1, b2, a1, a2;
+    float x1[2], x2[2], y1[2], y2[2];
+    enum ModKind mod;
+    uint32_t mod_param;
+    float mod_a, mod_b, mod_c;
+    uint32_t mod_t1, mod_t2;
+    uint32_t mod_time;
+};
+
+static struct AudioNodeState nodes[MAX_AUDIO_NODES] = {{.kind = NODE_MIX}};
+
+static void update_filter(struct AudioNodeState *n)
+{
+    float freq = n->params[0];
+    float q = n->params[1] > 0 ? n->params[1] : 0.7071f;
+    float w0 = 2 * PI_F * freq / 44100;
+    float alpha = sinf(w0) / (2 * q);
+    float cw = cosf(w0);
+    float a0 = 1 + alpha;
+    if (n->kind == NODE_LOW_PASS)
+    {
+        n->b0 = (1 - cw) / 2 / a0;
+        n->b1 = (1 - cw) / a0;
+        n->b2 = n->b0;
+    }
+    else
+    {
+        n->b0 = (1 + cw) / 2 / a0;
+        n->b1 = -(1 + cw) / a0;
+        n->b2 = n->b0;
+    }
+    n->a1 = -2 * cw / a0;
+    n->a2 = (1 - alpha) / a0;
+}
+
+static uint32_t add_node(uint32_t parentID, enum NodeKind kind, float p0, float p1)
+{
+    if (parentID >= MAX_AUDIO_NODES || nodes[parentID].kind == NODE_FREE)
+    {
+        return 0;
+    }
+    for (uint32_t id = 1; id < MAX_AUDIO_NODES; id++)
+    {
+        struct AudioNodeState *n = &nodes[id];
+        if (n->kind != NODE_FREE)
+        {
+            continue;
+        }
+        memset(n, 0, sizeof(*n));
+        n->kind = kind;
+        n->parent = parentID;
+        n->params[0] = p0;
+        n->params[1] = p1;
+        n->noise = 0x9E3779B9;
+        if (kind == NODE_LOW_PASS || kind == NODE_HIGH_PASS)
+        {
+            update_filter(n);
+        }
+        struct AudioNodeState *parent = &nodes[parentID];
+        if (parent->first == 0)
+        {
+            parent->first = id;
+        }
+        else
+        {
+            nodes[parent->last].next = id;
+        }
+        parent->last = id;
+        return id;
+    }
+    return 0;
+}
+
+static void free_children(uint32_t id)
+{
+    uint32_t child = nodes[id].first;
+    while (child != 0)
+    {
+        uint32_t next = nodes[child].next;
+        free_children(child);
+        nodes[child].kind = NODE_FREE;
+        child = next;
+    }
+    nodes[id].first = 0;
+    nodes[id].last = 0;
+    nodes[id].current = 0;
+}
+
+static void reset_node(uint32_t id, bool recursive)
+{
+    struct AudioNodeState *n = &nodes[id];
+    n->phase = 0;
+    n->time = 0;
+    n->current = 0;
+    n->mod_time = 0;
+    memset(n->x1, 0, sizeof(n->x1));
+    memset(n->x2, 0, sizeof(n->x2));
+    memset(n->y1, 0, sizeof(n->y1));
+    memset(n->y2, 0, sizeof(n->y2));
+    if (!recursive)
+    {
+        return;
+    }
+    for (uint32_t c = n->first; c != 0; c = nodes[c].next)
+    {
+        reset_node(c, true);
+    }
+}
+
+static void apply_mod(struct AudioNodeState *n)
+{
+    if (n->mod == MOD_NONE)
+    {
+        return;
+    }
+    uint32_t t = n->mod_time++;
+    float v = 0;
+    switch (n->mod)
+    {
+    case MOD_LINEAR:
+        if (t <= n->mod_t1)
+        {
+            v = n->mod_a;
+        }
+        else if (t >= n->mod_t2)
+        {
+            v = n->mod_b;
+        }
+        else
+        {
+            float k = (float)(t - n->mod_t1) / (float)(n->mod_t2 - n->mod_t1);
+            v = n->mod_a + (n->mod_b - n->mod_a) * k;
+        }
+        break;
+    case MOD_HOLD:
+        v = t < n->mod_t1 ? n->mod_a : n->mod_b;
+        break;
+    case MOD_SINE:
+        v = n->mod_b + (n->mod_c - n->mod_b) * (sinf(2 * PI_F * n->mod_a * (float)t / 44100) + 1) / 2;
+        break;
+    case MOD_NONE:
+        break;
+    }
+    if (n->kind == NODE_CLIP && n->mod_param == 0)
+    {
+        float gap = n->params[1] - n->params[0];
+        n->params[0] = v;
+        n->params[1] = v + gap;
+    }
+    else if (n->kind == NODE_CLIP)
+    {
+        n->params[n->mod_param == 1 ? 0 : 1] = v;
+    }
+    else
+    {
+        n->params[0] = v;
+    }
+    if (n->kind == NODE_LOW_PASS || n->kind == NODE_HIGH_PASS)
+    {
+        update_filter(n);
+    }
+}
+
+static bool next_sample(uint32_t id, float *l, float *r);
+
+// Sum all children. Returns the number of children that are still playing.
+static uint32_t mix_children(struct AudioNodeState *n, float *l, float *r, uint32_t *total)
+{
+    uint32_t playing = 0;
+    *total = 0;
+    *l = 0;
+    *r = 0;
+    for (uint32_t c = n->first; c != 0; c = nodes[c].next)
+    {
+        float cl, cr;
+        *total += 1;
+        if (next_sample(c, &cl, &cr))
+        {
+            *l += cl;
+            *r += cr;
+            playing++;
+        }
+    }
+    return playing;
+}
+
+static bool next_sample(uint32_t id, float *l, float *r)
+{
+    struct AudioNodeState *n = &nodes[id];
+    apply_mod(n);
+    float step = n->params[0] / 44100;
+    uint32_t total = 0;
+    bool playing = true;
+    *l = 0;
+    *r = 0;
+    switch (n->kind)
+    {
+    case NODE_FREE:
+    case NODE_EMPTY:
+    case NODE_FILE:
+        return false;
+    case NODE_ZERO:
+        break;
+    case NODE_SINE:
+        *l = sinf(2 * PI_F * (n->phase + n->params[1]));
+        break;
+    case NODE_SQUARE:
+        *l = fmodf(n->phase + n->params[1], 1) < 0.5f ? 1 : -1;
+        break;
+    case NODE_SAWTOOTH:
+        *l = 2 * fmodf(n->phase + n->params[1], 1) - 1;
+        break;
+    case NODE_TRIANGLE:
+        *l = 4 * fabsf(fmodf(n->phase + n->params[1], 1) - 0.5f) - 1;
+        break;
+    case NODE_NOISE:
+        n->noise ^= n->noise << 13;
+        n->noise ^= n->noise >> 17;
+        n->noise ^= n->noise << 5;
+        *l = (float)n->noise / 2147483648.0f - 1;
+        break;
+    case NODE_MIX:
+    case NODE_TRACK_POSITION:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        break;
+    case NODE_ALL_FOR_ONE:
+        playing = mix_children(n, l, r, &total) == total;
+        break;
+    case NODE_GAIN:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        *l *= n->params[0];
+        *r *= n->params[0];
+        break;
+    case NODE_LOOP:
+        if (mix_children(n, l, r, &total) == 0 && total > 0)
+        {
+            reset_node(id, true);
+        }
+        break;
+    case NODE_CONCAT:
+    {
+        uint32_t c = n->current ? n->current : n->first;
+        while (c != 0 && !next_sample(c, l, r))
+        {
+            c = nodes[c].next;
+        }
+        n->current = c;
+        playing = c != 0;
+        break;
+    }
+    case NODE_PAN:
+    {
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        float pan = n->params[0];
+        *l *= pan < 0.5f ? 1 : 2 * (1 - pan);
+        *r *= pan > 0.5f ? 1 : 2 * pan;
+        break;
+    }
+    case NODE_MUTE:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        if (n->params[0] < 0.5f)
+        {
+            *l = 0;
+            *r = 0;
+        }
+        break;
+    case NODE_PAUSE:
+        if (n->params[0] >= 0.5f)
+        {
+            playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        }
+        break;
+    case NODE_LOW_PASS:
+    case NODE_HIGH_PASS:
+    {
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        float *ch[2] = {l, r};
+        for (int i = 0; i < 2; i++)
+        {
+            float x = *ch[i];
+            float y = n->b0 * x + n->b1 * n->x1[i] + n->b2 * n->x2[i] - n->a1 * n->y1[i] - n->a2 * n->y2[i];
+            n->x2[i] = n->x1[i];
+            n->x1[i] = x;
+            n->y2[i] = n->y1[i];
+            n->y1[i] = y;
+            *ch[i] = y;
+        }
+        break;
+    }
+    case NODE_TAKE_LEFT:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        *r = *l;
+        break;
+    case NODE_TAKE_RIGHT:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        *l = *r;
+        break;
+    case NODE_SWAP:
+    {
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        float t = *l;
+        *l = *r;
+        *r = t;
+        break;
+    }
+    case NODE_CLIP:
+        playing = mix_children(n, l, r, &total) > 0 || total == 0;
+        *l = *l < n->params[0] ? n->params[0] : *l > n->params[1] ? n->params[1] : *l;
+        *r = *r < n->params[0] ? n->params[0] : *r > n->params[1] ? n->params[1] : *r;
+        break;
+    }
+    if (n->kind >= NODE_SINE && n->kind <= NODE_NOISE)
+    {
+        // Generators are mono.
+        *r = *l;
+        n->phase = fmodf(n->phase + step, 1);
+    }
+    n->time++;
+    return playing;
+}
+
+uint32_t _ffba_add_sine(uint32_t parentID, float freq, float phase)
+{
+    return add_node(parentID, NODE_SINE, freq, phase);
+}
+
+uint32_t _ffba_add_square(uint32_t parentID, float freq, float phase)
+{
+    return add_node(parentID, NODE_SQUARE, freq, phase);
+}
+
+uint32_t _ffba_add_sawtooth(uint32_t parentID, float freq, float phase)
+{
+    return add_node(parentID, NODE_SAWTOOTH, freq, phase);
+}
+
+uint32_t _ffba_add_triangle(uint32_t parentID, float freq, float phase)
+{
+    return add_node(parentID, NODE_TRIANGLE, freq, phase);
+}
+
+uint32_t _ffba_add_noise(uint32_t parentID, int32_t seed)
+{
+    uint32_t id = add_node(parentID, NODE_NOISE, 0, 0);
+    if (id != 0 && seed != 0)
+    {
+        nodes[id].noise = (uint32_t)seed;
+    }
+    return id;
+}
+
+uint32_t _ffba_add_empty(uint32_t parentID)
+{
+    return add_node(parentID, NODE_EMPTY, 0, 0);
+}
+
+uint32_t _ffba_add_zero(uint32_t parentID)
+{
+    return add_node(parentID, NODE_ZERO, 0, 0);
+}
+
+// Audio files are not decoded by the native runtime and play as silence.
+uint32_t _ffba_add_file(uint32_t parentID, uintptr_t ptr, uintptr_t len)
+{
+    (void)ptr;
+    (void)len;
+    return add_node(parentID, NODE_FILE, 0, 0);
+}
+
+uint32_t _ffba_add_mix(uint32_t parentID)
+{
+    return add_node(parentID, NODE_MIX, 0, 0);
+}
+
+uint32_t _ffba_add_all_for_one(uint32_t parentID)
+{
+    return add_node(parentID, NODE_ALL_FOR_ONE, 0, 0);
+}
+
+uint32_t _ffba_add_gain(uint32_t parentID, float lvl)
+{
+    return add_node(parentID, NODE_GAIN, lvl, 0);
+}
+
+uint32_t _ffba_add_loop(uint32_t parentID)
+{
+    return add_node(parentID, NODE_LOOP, 0, 0);
+}
+
+uint32_t _ffba_add_concat(uint32_t parentID)
+{
+    return add_node(parentID, NODE_CONCAT, 0, 0);
+}
+
+uint32_t _ffba_add_pan(uint32_t parentID, float lvl)
+{
+    return add_node(parentID, NODE_PAN, lvl, 0);
+}
+
+uint32_t _ffba_add_mute(uint32_t parentID)
+{
+    return add_node(parentID, NODE_MUTE, 0, 0);
+}
+
+uint32_t _ffba_add_pause(uint32_t parentID)
+{
+    return add_node(parentID, NODE_PAUSE, 0, 0);
+}
+
+uint32_t _ffba_add_track_position(uint32_t parentID)
+{
+    return add_node(parentID, NODE_TRACK_POSITION, 0, 0);
+}
+
+uint32_t _ffba_add_low_pass(uint32_t parentID, float freq, float q)
+{
+    return add_node(parentID, NODE_LOW_PASS, freq, q);
+}
+
+uint32_t _ffba_add_high_pass(uint32_t parentID, float freq, float q)
+{
+    return add_node(parentID, NODE_HIGH_PASS, freq, q);
+}
+
+uint32_t _ffba_add_take_left(uint32_t parentID)
+{
+    return add_node(parentID, NODE_TAKE_LEFT, 0, 0);
+}
+
+uint32_t _ffba_add_take_right(uint32_t parentID)
+{
+    return add_node(parentID, NODE_TAKE_RIGHT, 0, 0);
+}
+
+uint32_t _ffba_add_swap(uint32_t parentID)
+{
+    return add_node(parentID, NODE_SWAP, 0, 0);
+}
+
+uint32_t _ffba_add_clip(uint32_t parentID, float low, float high)
+{
+    return add_node(parentID, NODE_CLIP, low, high);
+}
+
+static struct AudioNodeState *mod_node(uint32_t nodeID, uint32_t param, enum ModKind kind)
+{
+    if (nodeID >= MAX_AUDIO_NODES || nodes[nodeID].kind == NODE_FREE)
+    {
+        return NULL;
+    }
+    struct AudioNodeState *n = &nodes[nodeID];
+    n->mod = kind;
+    n->mod_param = param;
+    n->mod_time = 0;
+    return n;
+}
+
+void _ffba_mod_linear(uint32_t nodeID, uint32_t param, float x_start, float x_end, uint32_t start_at, uint32_t end_at)
+{
+    struct AudioNodeState *n = mod_node(nodeID, param, MOD_LINEAR);
+    if (n != NULL)
+    {
+        n->mod_a = x_start;
+        n->mod_b = x_end;
+        n->mod_t1 = start_at;
+        n->mod_t2 = end_at;
+    }
+}
+
+void _ffba_mod_hold(uint32_t nodeID, uint32_t param, float before, float after, uint32_t time)
+{
+    struct AudioNodeState *n = mod_node(nodeID, param, MOD_HOLD);
+    if (n != NULL)
+    {
+        n->mod_a = before;
+        n->mod_b = after;
+        n->mod_t1 = time;
+    }
+}
+
+void _ffba_mod_sine(uint32_t nodeID, uint32_t param, float freq, float low, float high)
+{
+    struct AudioNodeState *n = mod_node(nodeID, param, MOD_SINE);
+    if (n != NULL)
+    {
+        n->mod_a = freq;
+        n->mod_b = low;
+        n->mod_c = high;
+    }
+}
+
+void _ffba_reset(uint32_t nodeID)
+{
+    if (nodeID < MAX_AUDIO_NODES)
+    {
+        reset_node(nodeID, false);
+    }
+}
+
+void _ffba_reset_all(uint32_t nodeID)
+{
+    if (nodeID < MAX_AUDIO_NODES)
+    {
+        reset_node(nodeID, true);
+    }
+}
+
+void _ffba_clear(uint32_t nodeID)
+{
+    if (nodeID < MAX_AUDIO_NODES)
+    {
+        free_children(nodeID);
+    }
+}
+
+// -- RUNTIME API -- //
+
+/// @brief Set the directory from which ROM files are loaded.
+void native_set_rom_dir(const char *dir)
+{
+    rt.rom_dir = dir;
+}
+
+/// @brief Set the directory into which dump_file writes.
+/// @details Files in it shadow the ROM files with the same name.
+void native_set_data_dir(const char *dir)
+{
+    rt.data_dir = dir;
+}
+
+/// @brief Set the bitmap of online peers and the ID of the current device.
+void native_set_peers(uint32_t online, int32_t me)
+{
+    rt.online = online;
+    rt.me = me;
+}
+
+/// @brief Set the goal of a badge. Badges without a goal have goal 1.
+void native_set_badge_goal(uint32_t badge, uint16_t goal)
+{
+    if (badge < MAX_STATS)
+    {
+        rt.badge_goals[badge] = goal;
+    }
+}
+
+/// @brief Set the touchpad state of the peer.
+void native_set_pad(int32_t peer, int16_t x, int16_t y, bool touched)
+{
+    if (!valid_peer(peer))
+    {
+        return;
+    }
+    rt.pads[peer] = touched ? (int32_t)(((uint32_t)(uint16_t)x << 16) | (uint16_t)y) : PAD_UNTOUCHED;
+}
+
+/// @brief Set the pressed buttons of the peer.
+/// @details Bits from the lowest: S, E, W, N, menu.
+void native_set_buttons(int32_t peer, uint32_t buttons)
+{
+    if (valid_peer(peer))
+    {
+        rt.buttons[peer] = buttons;
+    }
+}
+
+/// @brief Set the callback that feeds input at the start of every frame.
+void native_set_input_source(NativeInputSource source, void *ctx)
+{
+    rt.input = source;
+    rt.input_ctx = ctx;
+}
+
+/// @brief Load an input script.
+///
+/// @details Each line is `frame peer buttons [pad_x pad_y]`.
+/// The state is applied on the given frame and kept until changed.
+/// If the pad coordinates are omitted, the pad is not touched.
+/// Empty lines and lines starting with `#` are ignored.
+bool native_load_input_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return false;
+    }
+    free(rt.script);
+    rt.script = malloc(sizeof(struct ScriptEvent) * MAX_SCRIPT_EVENTS);
+    rt.script_len = 0;
+    rt.script_pos = 0;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f) != NULL && rt.script_len < MAX_SCRIPT_EVENTS)
+    {
+        unsigned frame, buttons;
+        int peer, x, y;
+        int n = sscanf(buf, "%u %d %u %d %d", &frame, &peer, &buttons, &x, &y);
+        if (buf[0] == '#' || n < 3)
+        {
+            continue;
+        }
+        struct ScriptEvent *e = &rt.script[rt.script_len++];
+        e->frame = frame;
+        e->peer = peer;
+        e->buttons = buttons;
+        e->pad = n == 5 ? (int32_t)(((uint32_t)(uint16_t)x << 16) | (uint16_t)y) : PAD_UNTOUCHED;
+    }
+    fclose(f);
+    return true;
+}
+
+/// @brief Enable or disable rendering audio on every frame.
+void native_set_audio(bool enabled)
+{
+    rt.audio = enabled;
+}
+
+/// @brief Render the given number of interleaved stereo frames from the audio tree.
+void native_render_audio(float *out, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        next_sample(0, &out[2 * i], &out[2 * i + 1]);
+    }
+}
+
+/// @brief The interleaved stereo samples rendered on the last frame.
+const float *native_audio_frame()
+{
+    return rt.audio_frame;
+}
+
+/// @brief The screen pixels as palette indices (Color - 1), row by row.
+const uint8_t *native_framebuffer()
+{
+    return rt.frame;
+}
+
+/// @brief The current palette, 16 RGB triples.
+const uint8_t *native_palette()
+{
+    return rt.palette;
+}
+
+/// @brief Save the screen as a binary PPM image.
+bool native_write_ppm(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", NATIVE_WIDTH, NATIVE_HEIGHT);
+    for (size_t i = 0; i < sizeof(rt.frame); i++)
+    {
+        fwrite(&rt.palette[rt.frame[i] * 3], 1, 3, f);
+    }
+    fclose(f);
+    return true;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void timed(void (*cb)(), NativeTiming *t)
+{
+    if (cb == NULL)
+    {
+        return;
+    }
+    uint64_t start = now_ns();
+    cb();
+    uint64_t took = now_ns() - start;
+    t->min_ns = t->calls == 0 || took < t->min_ns ? took : t->min_ns;
+    t->max_ns = took > t->max_ns ? took : t->max_ns;
+    t->total_ns += took;
+    t->calls++;
+}
+
+/// @brief Call the boot callback.
+void native_boot()
+{
+    timed(boot, &rt.timings.boot);
+}
+
+/// @brief Call the `cheat` callback of the app, like `firefly_cli cheat` does.
+/// @details Returns 0 if the app has no cheat callback.
+int32_t native_cheat(int32_t cmd, int32_t val)
+{
+    if (cheat == NULL)
+    {
+        return 0;
+    }
+    return cheat(cmd, val);
+}
+
+/// @brief Run a single frame: feed input, update, render, and mix audio.
+/// @details Returns false if the app asked to quit.
+bool native_step()
+{
+    uint32_t frame = rt.timings.frames;
+    while (rt.script_pos < rt.script_len && rt.script[rt.script_pos].frame <= frame)
+    {
+        struct ScriptEvent *e = &rt.script[rt.script_pos++];
+        if (valid_peer(e->peer))
+        {
+            rt.buttons[e->peer] = e->buttons;
+            rt.pads[e->peer] = e->pad;
+        }
+    }
+    if (rt.input != NULL)
+    {
+        rt.input(frame, rt.input_ctx);
+    }
+    timed(update, &rt.timings.update);
+    timed(render, &rt.timings.render);
+    if (rt.audio)
+    {
+        native_render_audio(rt.audio_frame, NATIVE_AUDIO_FRAMES);
+    }
+    rt.timings.frames++;
+    if (rt.restart)
+    {
+        rt.restart = false;
+        native_boot();
+    }
+    return !rt.quit;
+}
+
+/// @brief Get the callback timings collected so far.
+NativeStats native_stats()
+{
+    return rt.timings;
+}
+
+static void print_timing(const char *name, const NativeTiming *t)
+{
+    if (t->calls == 0)
+    {
+        return;
+    }
+    fprintf(stderr, "%-8s %8llu %12.3f %10.3f %10.3f %10.3f\n",
+            name,
+            (unsigned long long)t->calls,
+            (double)t->total_ns / 1e6,
+            (double)t->total_ns / (double)t->calls / 1e3,
+            (double)t->min_ns / 1e3,
+            (double)t->max_ns / 1e3);
+}
+
+/// @brief Print the callback timings into stderr.
+void native_print_stats()
+{
+    fprintf(stderr, "%-8s %8s %12s %10s %10s %10s\n", "callback", "calls", "total ms", "avg us", "min us", "max us");
+    print_timing("boot", &rt.timings.boot);
+    print_timing("update", &rt.timings.update);
+    print_timing("render", &rt.timings.render);
+}
+
+#ifndef FIREFLY_NATIVE_NO_MAIN
+
+static void usage(const char *bin)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --frames N       run N frames (default 600)\n"
+            "  --rom DIR        directory with the ROM files (default .)\n"
+            "  --data DIR       directory for dump_file (default data)\n"
+            "  --input FILE     input script, see native_load_input_script\n"
+            "  --peers N        number of online peers (default 1)\n"
+            "  --seed N         random seed\n"
+            "  --cheat CMD,VAL  call the cheat callback after boot (repeatable)\n"
+            "  --screenshot F   save the last frame as a PPM image\n"
+            "  --no-audio       do not render audio\n",
+            bin);
+}
+
+int main(int argc, char **argv)
+{
+    long frames = 600;
+    const char *screenshot = NULL;
+    int32_t cheats[16][2];
+    int cheats_len = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--no-audio") == 0)
+        {
+            native_set_audio(false);
+            continue;
+        }
+        if (val == NULL)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--frames") == 0)
+        {
+            frames = strtol(val, NULL, 10);
+        }
+        else if (strcmp(arg, "--rom") == 0)
+        {
+            native_set_rom_dir(val);
+        }
+        else if (strcmp(arg, "--data") == 0)
+        {
+            native_set_data_dir(val);
+        }
+        else if (strcmp(arg, "--input") == 0)
+        {
+            if (!native_load_input_script(val))
+            {
+                fprintf(stderr, "cannot read %s: %s\n", val, strerror(errno));
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--peers") == 0)
+        {
+            long n = strtol(val, NULL, 10);
+            native_set_peers(n >= 32 ? 0xffffffff : (1u << n) - 1, 0);
+        }
+        else if (strcmp(arg, "--seed") == 0)
+        {
+            _ffb_set_seed(strtoul(val, NULL, 10));
+        }
+        else if (strcmp(arg, "--screenshot") == 0)
+        {
+            screenshot = val;
+        }
+        else if (strcmp(arg, "--cheat") == 0 && cheats_len < 16)
+        {
+            char *end;
+            cheats[cheats_len][0] = (int32_t)strtol(val, &end, 10);
+            cheats[cheats_len][1] = *end == ',' ? (int32_t)strtol(end + 1, NULL, 10) : 0;
+            cheats_len++;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    native_boot();
+    for (int i = 0; i < cheats_len; i++)
+    {
+        int32_t result = native_cheat(cheats[i][0], cheats[i][1]);
+        fprintf(stderr, "cheat %d,%d = %d\n", cheats[i][0], cheats[i][1], result);
+    }
+    for (long i = 0; i < frames; i++)
+    {
+        if (!native_step())
+        {
+            break;
+        }
+    }
+    if (before_exit != NULL)
+    {
+        before_exit();
+    }
+    native_print_stats();
+    if (screenshot != NULL && !native_write_ppm(screenshot))
+    {
+        fprintf(stderr, "cannot write %s: %s\n", screenshot, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+#endif
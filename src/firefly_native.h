@@ -0,0 +1,97 @@
+/// @file
+/// @brief A native (non-WASM) host runtime for Firefly Zero apps.
+///
+/// @details Implements every import from firefly_bindings.h as a plain C function
+/// so that an app built on the SDK can be compiled for the desktop and run
+/// under perf, valgrind, or sanitizers.
+///
+/// Graphics are rendered into an in-memory framebuffer, input comes from
+/// scripted sources, the file system is a local directory,
+/// net and stash are kept in memory, and audio is rendered into a sample buffer.
+///
+/// Build the app together with firefly_native.c:
+///
+/// ```bash
+/// cc -O2 -g -Isrc main.c src/firefly_native.c -lm -o app
+/// ./app --frames 600 --rom path/to/rom
+/// ```
+///
+/// The callbacks are looked up by their C names: `boot`, `update`, `render`,
+/// `cheat`, and `before_exit`. `cheat` is called with native_cheat or the
+/// `--cheat CMD,VAL` option. Define `FIREFLY_NATIVE_NO_MAIN` when compiling
+/// firefly_native.c to provide your own `main` and drive the runtime manually.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @brief The framebuffer width, in pixels.
+#define NATIVE_WIDTH 240
+/// @brief The framebuffer height, in pixels.
+#define NATIVE_HEIGHT 160
+/// @brief The number of stereo audio frames rendered per update.
+#define NATIVE_AUDIO_FRAMES (44100 / 60)
+
+/// @brief Timing statistics for one of the app callbacks.
+struct NativeTiming
+{
+    /// @brief How many times the callback was called.
+    uint64_t calls;
+    /// @brief The total time spent in the callback, in nanoseconds.
+    uint64_t total_ns;
+    /// @brief The fastest call, in nanoseconds.
+    uint64_t min_ns;
+    /// @brief The slowest call, in nanoseconds.
+    uint64_t max_ns;
+};
+typedef struct NativeTiming NativeTiming;
+
+/// @brief Timings of all app callbacks collected since the start.
+struct NativeStats
+{
+    NativeTiming boot;
+    NativeTiming update;
+    NativeTiming render;
+    /// @brief The number of frames (update calls) run so far.
+    uint32_t frames;
+};
+typedef struct NativeStats NativeStats;
+
+/// @brief A callback called at the start of every frame to feed input.
+/// @details Use native_set_pad and native_set_buttons from inside of it.
+typedef void (*NativeInputSource)(uint32_t frame, void *ctx);
+
+void native_set_rom_dir(const char *dir);
+void native_set_data_dir(const char *dir);
+void native_set_peers(uint32_t online, int32_t me);
+void native_set_badge_goal(uint32_t badge, uint16_t goal);
+
+void native_set_pad(int32_t peer, int16_t x, int16_t y, bool touched);
+void native_set_buttons(int32_t peer, uint32_t buttons);
+void native_set_input_source(NativeInputSource source, void *ctx);
+bool native_load_input_script(const char *path);
+
+void native_set_audio(bool enabled);
+const float *native_audio_frame();
+void native_render_audio(float *out, size_t frames);
+
+const uint8_t *native_framebuffer();
+const uint8_t *native_palette();
+bool native_write_ppm(const char *path);
+
+void native_boot();
+bool native_step();
+int32_t native_cheat(int32_t cmd, int32_t val);
+NativeStats native_stats();
+void native_print_stats();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,435 @@
+/// @file
+/// @brief The implementation of input recording and replay. See firefly_replay.h.
+///
+/// @details The stream starts with "FFR1" followed by events. Every event
+/// starts with a varint tag: the kind in the lowest 3 bits, a payload above.
+///
+/// * SKIP: the payload is the number of frames that pass before the next event;
+/// * PAD: the payload is the slot, then the zigzag deltas of x and y as varints;
+/// * BUTTONS: the payload is the slot times 256 plus the button bits;
+/// * PEERS: followed by the bitmap of online peers as a varint;
+/// * SEED and RANDOM: followed by the value as a varint.
+///
+/// PAD, BUTTONS, and PEERS update the state at the start of the frame.
+/// SEED and RANDOM are consumed in order by the calls during the frame.
+
+#include "firefly_replay.h"
+#include <string.h>
+
+/// @private
+enum _ffReplayKind
+{
+    _FF_REPLAY_SKIP = 0,
+    _FF_REPLAY_PAD = 1,
+    _FF_REPLAY_BUTTONS = 2,
+    _FF_REPLAY_PEERS = 3,
+    _FF_REPLAY_SEED = 4,
+    _FF_REPLAY_RANDOM = 5,
+};
+
+/// @private
+#define _FF_REPLAY_MAGIC "FFR1"
+
+/// @private
+/// @brief The most bytes a single event can take.
+#define _FF_REPLAY_MAX_EVENT 24
+
+/// @private
+/// @brief The raw pad value of an untouched pad.
+#define _FF_REPLAY_UNTOUCHED 0xffff
+
+/// @private
+static InputRecorder *_ff_recorder = 0;
+
+/// @private
+static InputReplay *_ff_replay = 0;
+
+/// @private
+static void _ff_replay_reset_state(ReplayState *s)
+{
+    for (int32_t i = 0; i < REPLAY_SLOTS; i++)
+    {
+        s->pads[i] = _FF_REPLAY_UNTOUCHED;
+        s->buttons[i] = 0;
+    }
+    s->peers = 0;
+}
+
+/// @private
+/// @brief The state slot of the peer, or -1 for invalid peers.
+static int32_t _ff_replay_slot(uintptr_t peer)
+{
+    if (peer == (uintptr_t)COMBINED)
+    {
+        return REPLAY_SLOTS - 1;
+    }
+    return peer < REPLAY_SLOTS - 1 ? (int32_t)peer : -1;
+}
+
+/// @private
+static uintptr_t _ff_replay_exec(InputHook prev, InputOp op, uintptr_t arg)
+{
+    return prev ? prev(op, arg) : exec_input(op, arg);
+}
+
+/// @private
+static uint32_t _ff_zigzag(int16_t v)
+{
+    return (uint16_t)(((uint16_t)v << 1) ^ (uint16_t)(v >> 15));
+}
+
+/// @private
+static int16_t _ff_unzigzag(uint64_t v)
+{
+    return (int16_t)((v >> 1) ^ (~(v & 1) + 1));
+}
+
+// -- RECORDING -- //
+
+/// @private
+static void _ff_record_varint(InputRecorder *r, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        r->data[r->len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    r->data[r->len++] = (uint8_t)v;
+}
+
+/// @private
+/// @brief Start an event, writing the frames passed since the last one first.
+static bool _ff_record_event(InputRecorder *r, uint64_t payload, enum _ffReplayKind kind)
+{
+    if (r->overflow || r->len + 2 * _FF_REPLAY_MAX_EVENT > r->cap)
+    {
+        r->overflow = true;
+        return false;
+    }
+    if (r->pending != 0)
+    {
+        _ff_record_varint(r, ((uint64_t)r->pending << 3) | _FF_REPLAY_SKIP);
+        r->pending = 0;
+    }
+    _ff_record_varint(r, (payload << 3) | kind);
+    r->stats.events++;
+    return true;
+}
+
+/// @private
+static void _ff_record(InputRecorder *r, InputOp op, uintptr_t arg, uintptr_t v)
+{
+    ReplayState *s = &r->state;
+    int32_t slot = _ff_replay_slot(arg);
+    switch (op)
+    {
+    case INPUT_READ_PAD:
+    {
+        uint32_t now = (uint32_t)v;
+        if (slot < 0 || s->pads[slot] == now || !_ff_record_event(r, slot, _FF_REPLAY_PAD))
+        {
+            return;
+        }
+        uint32_t old = s->pads[slot];
+        _ff_record_varint(r, _ff_zigzag((int16_t)((now >> 16) - (old >> 16))));
+        _ff_record_varint(r, _ff_zigzag((int16_t)(now - old)));
+        s->pads[slot] = now;
+        return;
+    }
+    case INPUT_READ_BUTTONS:
+        if (slot >= 0 && s->buttons[slot] != (uint8_t)v &&
+            _ff_record_event(r, (uint64_t)slot * 256 + (uint8_t)v, _FF_REPLAY_BUTTONS))
+        {
+            s->buttons[slot] = (uint8_t)v;
+        }
+        return;
+    case INPUT_GET_PEERS:
+        if (s->peers != (uint32_t)v && _ff_record_event(r, 0, _FF_REPLAY_PEERS))
+        {
+            _ff_record_varint(r, (uint32_t)v);
+            s->peers = (uint32_t)v;
+        }
+        return;
+    case INPUT_SET_SEED:
+        if (_ff_record_event(r, 0, _FF_REPLAY_SEED))
+        {
+            _ff_record_varint(r, arg);
+        }
+        return;
+    case INPUT_GET_RANDOM:
+        if (_ff_record_event(r, 0, _FF_REPLAY_RANDOM))
+        {
+            _ff_record_varint(r, v);
+        }
+        return;
+    }
+}
+
+/// @private
+static uintptr_t _ff_record_hook(InputOp op, uintptr_t arg)
+{
+    InputRecorder *r = _ff_recorder;
+    uintptr_t v = _ff_replay_exec(r->prev, op, arg);
+    _ff_record(r, op, arg, v);
+    return v;
+}
+
+/// @brief Start recording input and randomness into the given storage.
+///
+/// @details Call it in boot to capture the random numbers used there as well.
+/// The storage must stay alive until input_record_end. When it's full,
+/// the recording stops and overflow is set. Only one recording can be
+/// active at a time.
+void input_record_begin(InputRecorder *r, Buffer storage)
+{
+    r->data = (uint8_t *)storage.head;
+    r->cap = storage.size;
+    r->len = 0;
+    r->pending = 0;
+    r->overflow = storage.size < 4;
+    memset(&r->stats, 0, sizeof(r->stats));
+    _ff_replay_reset_state(&r->state);
+    if (!r->overflow)
+    {
+        memcpy(r->data, _FF_REPLAY_MAGIC, 4);
+        r->len = 4;
+    }
+    _ff_recorder = r;
+    r->prev = set_input_hook(_ff_record_hook);
+}
+
+/// @brief Mark the start of the next frame.
+void input_record_frame(InputRecorder *r)
+{
+    if (!r->overflow)
+    {
+        r->pending++;
+        r->stats.frames++;
+    }
+}
+
+/// @private
+static void _ff_record_flush(InputRecorder *r)
+{
+    if (r->pending != 0 && r->len + _FF_REPLAY_MAX_EVENT <= r->cap)
+    {
+        _ff_record_varint(r, ((uint64_t)r->pending << 3) | _FF_REPLAY_SKIP);
+        r->pending = 0;
+    }
+}
+
+/// @brief Stop recording and return the recorded stream.
+/// @details The stream points into the storage passed into input_record_begin.
+File input_record_end(InputRecorder *r)
+{
+    _ff_record_flush(r);
+    set_input_hook(r->prev);
+    _ff_recorder = 0;
+    File f = {r->len, (char *)r->data};
+    return f;
+}
+
+/// @brief Write everything recorded so far into the file.
+/// @details The recording goes on, call it again later to save more.
+void input_record_save(InputRecorder *r, Str path)
+{
+    _ff_record_flush(r);
+    File f = {r->len, (char *)r->data};
+    dump_file_str(path, f);
+}
+
+// -- REPLAY -- //
+
+/// @private
+static uint64_t _ff_replay_varint(InputReplay *p, size_t *pos)
+{
+    const uint8_t *data = (const uint8_t *)p->stream.head;
+    uint64_t v = 0;
+    for (int32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (*pos >= p->stream.size)
+        {
+            p->done = true;
+            return 0;
+        }
+        uint8_t b = data[(*pos)++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    p->done = true;
+    return v;
+}
+
+/// @private
+/// @brief Apply the state changes of the next frame and find its end.
+static void _ff_replay_load_frame(InputReplay *p)
+{
+    ReplayState *s = &p->state;
+    p->ordered = p->pos;
+    p->skip = 0;
+    while (p->pos < p->stream.size && !p->done)
+    {
+        size_t start = p->pos;
+        uint64_t tag = _ff_replay_varint(p, &p->pos);
+        uint64_t payload = tag >> 3;
+        switch (tag & 7)
+        {
+        case _FF_REPLAY_SKIP:
+            p->frame_end = start;
+            p->skip = (uint32_t)payload;
+            return;
+        case _FF_REPLAY_PAD:
+        {
+            int16_t dx = _ff_unzigzag(_ff_replay_varint(p, &p->pos));
+            int16_t dy = _ff_unzigzag(_ff_replay_varint(p, &p->pos));
+            if (payload < REPLAY_SLOTS)
+            {
+                uint32_t old = s->pads[payload];
+                uint16_t x = (uint16_t)((old >> 16) + dx);
+                uint16_t y = (uint16_t)(old + dy);
+                s->pads[payload] = ((uint32_t)x << 16) | y;
+            }
+            break;
+        }
+        case _FF_REPLAY_BUTTONS:
+            if (payload / 256 < REPLAY_SLOTS)
+            {
+                s->buttons[payload / 256] = (uint8_t)payload;
+            }
+            break;
+        case _FF_REPLAY_PEERS:
+            s->peers = (uint32_t)_ff_replay_varint(p, &p->pos);
+            break;
+        case _FF_REPLAY_SEED:
+        case _FF_REPLAY_RANDOM:
+            _ff_replay_varint(p, &p->pos);
+            break;
+        default:
+            p->done = true;
+            break;
+        }
+        p->stats.events++;
+    }
+    p->frame_end = p->pos;
+}
+
+/// @private
+/// @brief Take the next SEED or RANDOM event of the current frame.
+static bool _ff_replay_next_ordered(InputReplay *p, enum _ffReplayKind kind, uint64_t *value)
+{
+    while (p->ordered < p->frame_end)
+    {
+        uint64_t tag = _ff_replay_varint(p, &p->ordered);
+        switch (tag & 7)
+        {
+        case _FF_REPLAY_PAD:
+            _ff_replay_varint(p, &p->ordered);
+            _ff_replay_varint(p, &p->ordered);
+            break;
+        case _FF_REPLAY_PEERS:
+            _ff_replay_varint(p, &p->ordered);
+            break;
+        case _FF_REPLAY_SEED:
+        case _FF_REPLAY_RANDOM:
+            *value = _ff_replay_varint(p, &p->ordered);
+            if ((tag & 7) == kind)
+            {
+                return true;
+            }
+            p->stats.desyncs++;
+            return false;
+        default:
+            break;
+        }
+    }
+    p->stats.desyncs++;
+    return false;
+}
+
+/// @private
+static uintptr_t _ff_replay_hook(InputOp op, uintptr_t arg)
+{
+    InputReplay *p = _ff_replay;
+    const ReplayState *s = &p->state;
+    int32_t slot = _ff_replay_slot(arg);
+    uint64_t value = 0;
+    switch (op)
+    {
+    case INPUT_READ_PAD:
+        return slot >= 0 ? s->pads[slot] : _ff_replay_exec(p->prev, op, arg);
+    case INPUT_READ_BUTTONS:
+        return slot >= 0 ? s->buttons[slot] : _ff_replay_exec(p->prev, op, arg);
+    case INPUT_GET_PEERS:
+        return s->peers;
+    case INPUT_SET_SEED:
+        if (_ff_replay_next_ordered(p, _FF_REPLAY_SEED, &value) && value != arg)
+        {
+            p->stats.desyncs++;
+        }
+        return _ff_replay_exec(p->prev, op, arg);
+    case INPUT_GET_RANDOM:
+        if (_ff_replay_next_ordered(p, _FF_REPLAY_RANDOM, &value))
+        {
+            return (uintptr_t)value;
+        }
+        return _ff_replay_exec(p->prev, op, arg);
+    }
+    return 0;
+}
+
+/// @brief Start replaying the recorded stream.
+///
+/// @details Call it in boot, at the same point where the recording started.
+/// The stream must stay alive until input_replay_end.
+/// Only one replay can be active at a time.
+void input_replay_begin(InputReplay *p, File stream)
+{
+    p->stream = stream;
+    p->pos = 4;
+    p->done = stream.size < 4 || memcmp(stream.head, _FF_REPLAY_MAGIC, 4) != 0;
+    memset(&p->stats, 0, sizeof(p->stats));
+    _ff_replay_reset_state(&p->state);
+    p->ordered = p->pos;
+    p->frame_end = p->pos;
+    p->skip = 0;
+    if (!p->done)
+    {
+        _ff_replay_load_frame(p);
+    }
+    _ff_replay = p;
+    p->prev = set_input_hook(_ff_replay_hook);
+}
+
+/// @brief Move to the next recorded frame.
+/// @details Returns false when all recorded frames have been replayed.
+/// The input then stays as it was in the last frame.
+bool input_replay_frame(InputReplay *p)
+{
+    if (p->done || p->skip == 0)
+    {
+        p->done = true;
+        return false;
+    }
+    p->skip--;
+    p->stats.frames++;
+    if (p->skip == 0)
+    {
+        _ff_replay_load_frame(p);
+    }
+    else
+    {
+        // Nothing is recorded for the frame in the middle of a run.
+        p->ordered = p->frame_end;
+    }
+    return true;
+}
+
+/// @brief Stop replaying and let the input functions ask the host again.
+void input_replay_end(InputReplay *p)
+{
+    set_input_hook(p->prev);
+    _ff_replay = 0;
+}
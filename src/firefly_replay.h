@@ -0,0 +1,111 @@
+/// @file
+/// @brief Recording input and randomness and replaying them frame for frame.
+///
+/// @details While recording, every value returned by read_pad, read_buttons,
+/// get_peers, and get_random (and every seed passed into set_seed) is captured
+/// through the input hook. While replaying, the same functions return
+/// the recorded values instead of asking the host, so a deterministic game
+/// runs exactly the same frames, under a profiler or in the native runtime.
+///
+/// Call input_record_frame or input_replay_frame at the very start of
+/// every update, before reading any input:
+///
+/// ```c
+/// void update()
+/// {
+///     if (!input_replay_frame(&replay))
+///     {
+///         quit();
+///     }
+///     input_update(&input);
+///     ...
+/// }
+/// ```
+///
+/// The stream is compact: pads and buttons are written only when they change
+/// (pads as deltas), and runs of frames without any change take a single byte.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The number of input slots: one per peer plus one for COMBINED.
+#define REPLAY_SLOTS 33
+
+/// @brief Counters of a recording or a replay.
+struct ReplayStats
+{
+    /// @brief The number of frames recorded or replayed.
+    uint32_t frames;
+    /// @brief The number of events (changes and random numbers) written or read.
+    uint32_t events;
+    /// @brief The number of calls that didn't match the recording while replaying.
+    /// @details Non-zero means the game isn't deterministic or the recording is broken.
+    uint32_t desyncs;
+};
+typedef struct ReplayStats ReplayStats;
+
+/// @private
+/// @brief The last known raw input values.
+struct ReplayState
+{
+    uint32_t pads[REPLAY_SLOTS];
+    uint8_t buttons[REPLAY_SLOTS];
+    uint32_t peers;
+};
+typedef struct ReplayState ReplayState;
+
+/// @brief A recording of input and randomness in progress.
+struct InputRecorder
+{
+    /// @private
+    uint8_t *data;
+    /// @private
+    size_t len;
+    /// @private
+    size_t cap;
+    /// @private
+    uint32_t pending;
+    /// @private
+    ReplayState state;
+    /// @private
+    InputHook prev;
+    /// @brief If the storage got full and the recording stopped early.
+    bool overflow;
+    /// @brief Statistics accumulated since input_record_begin.
+    ReplayStats stats;
+};
+typedef struct InputRecorder InputRecorder;
+
+/// @brief A replay of a recording in progress.
+struct InputReplay
+{
+    /// @private
+    File stream;
+    /// @private
+    size_t pos;
+    /// @private
+    size_t ordered;
+    /// @private
+    size_t frame_end;
+    /// @private
+    uint32_t skip;
+    /// @private
+    ReplayState state;
+    /// @private
+    InputHook prev;
+    /// @brief If the recording is over or broken.
+    bool done;
+    /// @brief Statistics accumulated since input_replay_begin.
+    ReplayStats stats;
+};
+typedef struct InputReplay InputReplay;
+
+void input_record_begin(InputRecorder *r, Buffer storage);
+void input_record_frame(InputRecorder *r);
+File input_record_end(InputRecorder *r);
+void input_record_save(InputRecorder *r, Str path);
+
+void input_replay_begin(InputReplay *p, File stream);
+bool input_replay_frame(InputReplay *p);
+void input_replay_end(InputReplay *p);
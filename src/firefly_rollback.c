@@ -0,0 +1,340 @@
+/// @file
+/// @brief The implementation of rollback support. See firefly_rollback.h.
+
+#include "firefly_rollback.h"
+#include <string.h>
+
+/// @private
+static size_t _ff_rollback_align(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+/// @private
+static size_t _ff_rollback_pages(size_t size)
+{
+    return (size + ROLLBACK_PAGE_SIZE - 1) / ROLLBACK_PAGE_SIZE;
+}
+
+/// @brief The size of the storage needed for the state size and the number of snapshots.
+size_t rollback_storage_size(size_t state_size, int32_t frames)
+{
+    size_t history = (size_t)frames + 1;
+    return 8 + _ff_rollback_align((size_t)frames * state_size) +
+           _ff_rollback_align((size_t)frames * sizeof(int32_t)) +
+           _ff_rollback_align(_ff_rollback_pages(state_size) * sizeof(int32_t)) +
+           3 * _ff_rollback_align(history * sizeof(uint32_t)) +
+           _ff_rollback_align(history * ROLLBACK_MAX_PEERS * sizeof(RollbackInput));
+}
+
+/// @private
+static void *_ff_rollback_take(uint8_t **next, size_t size)
+{
+    void *p = *next;
+    *next += _ff_rollback_align(size);
+    return p;
+}
+
+/// @brief Set up rollback for the state region.
+///
+/// @details Keeps snapshots of the last `frames` frames, which is also
+/// the deepest possible rollback. The storage must have at least
+/// rollback_storage_size bytes and stay alive as long as the rollback is used.
+/// Returns false if the storage is too small.
+bool new_rollback(Rollback *rb, void *state, size_t size, int32_t frames, RollbackMode mode, Buffer storage)
+{
+    memset(rb, 0, sizeof(Rollback));
+    if (frames < 1 || storage.size < rollback_storage_size(size, frames))
+    {
+        return false;
+    }
+    uint8_t *next = (uint8_t *)_ff_rollback_align((uintptr_t)storage.head);
+    rb->state = (uint8_t *)state;
+    rb->size = size;
+    rb->frames = frames;
+    rb->history = frames + 1;
+    rb->mode = mode;
+    rb->slots = _ff_rollback_take(&next, (size_t)frames * size);
+    rb->slot_frames = _ff_rollback_take(&next, (size_t)frames * sizeof(int32_t));
+    rb->page_changed = _ff_rollback_take(&next, _ff_rollback_pages(size) * sizeof(int32_t));
+    rb->input_frames = _ff_rollback_take(&next, (size_t)rb->history * sizeof(int32_t));
+    rb->inputs = _ff_rollback_take(&next, (size_t)rb->history * ROLLBACK_MAX_PEERS * sizeof(RollbackInput));
+    rb->confirmed = _ff_rollback_take(&next, (size_t)rb->history * sizeof(uint32_t));
+    rb->online = _ff_rollback_take(&next, (size_t)rb->history * sizeof(uint32_t));
+    for (int32_t i = 0; i < frames; i++)
+    {
+        rb->slot_frames[i] = -1;
+    }
+    for (int32_t i = 0; i < rb->history; i++)
+    {
+        rb->input_frames[i] = -1;
+    }
+    memset(rb->page_changed, 0, _ff_rollback_pages(size) * sizeof(int32_t));
+    rb->rollback_to = INT32_MAX;
+    return true;
+}
+
+/// @brief Set the function advancing the state by one frame.
+void rollback_set_step(Rollback *rb, RollbackStep step, void *ctx)
+{
+    rb->step = step;
+    rb->ctx = ctx;
+}
+
+// -- INPUT HISTORY -- //
+
+/// @private
+/// @brief The history index of the frame, preparing it on first use.
+static int32_t _ff_rollback_history(Rollback *rb, int32_t frame)
+{
+    int32_t i = frame % rb->history;
+    if (rb->input_frames[i] != frame)
+    {
+        int32_t prev = (frame + rb->history - 1) % rb->history;
+        bool known = frame > 0 && rb->input_frames[prev] == frame - 1;
+        rb->input_frames[i] = frame;
+        rb->confirmed[i] = 0;
+        rb->online[i] = known ? rb->online[prev] : 0;
+    }
+    return i;
+}
+
+/// @brief Set the input of the peer in the frame.
+///
+/// @details The frame can be the current one (rb->frame) or a past one
+/// at most as old as the number of snapshots. If a past input differs from
+/// what was predicted, the next rollback_advance rolls back to that frame.
+/// Returns false if the input is too late or too early to be used.
+bool rollback_set_input(Rollback *rb, int32_t frame, Peer p, RollbackInput input)
+{
+    if (p < 0 || p >= ROLLBACK_MAX_PEERS || frame > rb->frame)
+    {
+        return false;
+    }
+    if (frame < rb->frame - rb->frames || frame < 0)
+    {
+        rb->stats.late_inputs++;
+        return false;
+    }
+    int32_t i = _ff_rollback_history(rb, frame);
+    RollbackInput *used = &rb->inputs[i * ROLLBACK_MAX_PEERS + p];
+    if (frame < rb->frame && *used != input)
+    {
+        rb->stats.mispredictions++;
+        if (frame < rb->rollback_to)
+        {
+            rb->rollback_to = frame;
+        }
+    }
+    *used = input;
+    rb->confirmed[i] |= 1u << p;
+    return true;
+}
+
+/// @brief Set the peers online in the frame.
+/// @details Frames without it keep the peers of the previous frame.
+void rollback_set_peers(Rollback *rb, int32_t frame, Peers peers)
+{
+    if (frame > rb->frame || frame < rb->frame - rb->frames || frame < 0)
+    {
+        return;
+    }
+    int32_t i = _ff_rollback_history(rb, frame);
+    if (frame < rb->frame && rb->online[i] != peers.online && frame < rb->rollback_to)
+    {
+        rb->rollback_to = frame;
+    }
+    rb->online[i] = peers.online;
+}
+
+/// @private
+/// @brief Predict the inputs that haven't arrived by repeating the previous frame.
+static int32_t _ff_rollback_predict(Rollback *rb, int32_t frame)
+{
+    int32_t i = _ff_rollback_history(rb, frame);
+    int32_t prev = (frame + rb->history - 1) % rb->history;
+    bool known = frame > 0 && rb->input_frames[prev] == frame - 1;
+    RollbackInput *inputs = &rb->inputs[i * ROLLBACK_MAX_PEERS];
+    for (uint32_t bits = ~rb->confirmed[i]; bits != 0; bits &= bits - 1)
+    {
+        int32_t p = __builtin_ctz(bits);
+        inputs[p] = known ? rb->inputs[prev * ROLLBACK_MAX_PEERS + p] : 0;
+    }
+    return i;
+}
+
+// -- SNAPSHOTS -- //
+
+/// @brief Snapshot the state as it is at the start of rb->frame.
+///
+/// @details Called by rollback_advance, call it directly only when
+/// driving the simulation without rollback_advance.
+void rollback_save(Rollback *rb)
+{
+    int32_t frame = rb->frame;
+    int32_t slot = frame % rb->frames;
+    uint8_t *dst = rb->slots + (size_t)slot * rb->size;
+    int32_t old = rb->slot_frames[slot];
+    rb->stats.saves++;
+    // A slot from an abandoned future (after a rollback) can't be patched.
+    bool full = rb->mode == ROLLBACK_COPY || old < 0 || old >= frame || rb->frames == 1;
+    if (rb->mode == ROLLBACK_PAGES)
+    {
+        // A page in the slot is up to date if it hasn't changed
+        // in any snapshot taken since the slot was written.
+        // The changes are tracked on full copies too: the snapshots
+        // resimulated after a rollback are all full copies, and the slots
+        // patched later must still see the pages those frames changed.
+        int32_t prevSlot = (frame + rb->frames - 1) % rb->frames;
+        const uint8_t *prev = rb->slots + (size_t)prevSlot * rb->size;
+        bool hasPrev = rb->slot_frames[prevSlot] == frame - 1;
+        size_t pages = _ff_rollback_pages(rb->size);
+        for (size_t i = 0; i < pages; i++)
+        {
+            size_t offset = i * ROLLBACK_PAGE_SIZE;
+            size_t len = rb->size - offset < ROLLBACK_PAGE_SIZE ? rb->size - offset : ROLLBACK_PAGE_SIZE;
+            // Keep the latest frame: after a rollback, changes seen in the
+            // abandoned frames must still be copied over.
+            bool changed = !hasPrev || memcmp(rb->state + offset, prev + offset, len) != 0;
+            if (changed && rb->page_changed[i] < frame)
+            {
+                rb->page_changed[i] = frame;
+            }
+            if (!full && rb->page_changed[i] > old)
+            {
+                memcpy(dst + offset, rb->state + offset, len);
+                rb->stats.bytes_saved += len;
+            }
+        }
+    }
+    if (full)
+    {
+        memcpy(dst, rb->state, rb->size);
+        rb->stats.bytes_saved += rb->size;
+    }
+    rb->slot_frames[slot] = frame;
+}
+
+/// @brief Restore the state from the snapshot of the frame.
+/// @details Returns false if there is no snapshot of the frame anymore.
+/// On success, rb->frame is set to the frame.
+bool rollback_restore(Rollback *rb, int32_t frame)
+{
+    if (frame < 0)
+    {
+        return false;
+    }
+    int32_t slot = frame % rb->frames;
+    if (rb->slot_frames[slot] != frame)
+    {
+        return false;
+    }
+    memcpy(rb->state, rb->slots + (size_t)slot * rb->size, rb->size);
+    rb->frame = frame;
+    rb->stats.restores++;
+    return true;
+}
+
+// -- SIMULATION -- //
+
+/// @private
+/// @brief Drops drawing commands issued by the step during resimulation.
+static void _ff_rollback_drop_draw(const DrawCmd *cmd)
+{
+    (void)cmd;
+}
+
+/// @private
+static void _ff_rollback_step(Rollback *rb)
+{
+    int32_t i = _ff_rollback_predict(rb, rb->frame);
+    Peers peers = {rb->online[i]};
+    if (rb->step)
+    {
+        rb->step(rb->ctx, &rb->inputs[i * ROLLBACK_MAX_PEERS], peers);
+    }
+    rb->frame++;
+}
+
+/// @brief Simulate the current frame, rolling back first if a late input requires it.
+///
+/// @details If an input for a past frame turned out to be mispredicted,
+/// restores the snapshot of that frame and runs the step again for every
+/// frame since, without drawing. Then snapshots the state, runs the step
+/// for the current frame, and moves to the next frame.
+void rollback_advance(Rollback *rb)
+{
+    int32_t target = rb->frame;
+    if (rb->rollback_to < target && rollback_restore(rb, rb->rollback_to))
+    {
+        DrawHook prev = set_draw_hook(_ff_rollback_drop_draw);
+        _ff_rollback_step(rb);
+        while (rb->frame < target)
+        {
+            rollback_save(rb);
+            _ff_rollback_step(rb);
+            rb->stats.resimulated++;
+        }
+        rb->stats.resimulated++;
+        set_draw_hook(prev);
+    }
+    rb->rollback_to = INT32_MAX;
+    rollback_save(rb);
+    _ff_rollback_step(rb);
+}
+
+/// @brief Reset the rollback statistics.
+void rollback_reset_stats(Rollback *rb)
+{
+    memset(&rb->stats, 0, sizeof(rb->stats));
+}
+
+// -- PACKING -- //
+
+/// @private
+#define _FF_ROLLBACK_AXIS_BITS 13
+
+/// @private
+static uint32_t _ff_rollback_pack_axis(int16_t v)
+{
+    int32_t limit = 1 << (_FF_ROLLBACK_AXIS_BITS - 1);
+    int32_t c = v < -limit ? -limit : (v >= limit ? limit - 1 : v);
+    return (uint32_t)c & ((1u << _FF_ROLLBACK_AXIS_BITS) - 1);
+}
+
+/// @private
+static int16_t _ff_rollback_unpack_axis(uint32_t bits)
+{
+    int32_t shift = 32 - _FF_ROLLBACK_AXIS_BITS;
+    return (int16_t)((int32_t)(bits << shift) >> shift);
+}
+
+/// @brief Pack the pad and the button bits (as in read_buttons) into 32 bits.
+/// @details Pad coordinates are clamped to 13 bits, which covers the whole pad.
+RollbackInput rollback_pack_input(Pad pad, uint8_t buttons)
+{
+    RollbackInput input = buttons & 0x1f;
+    if (pad.touched)
+    {
+        input |= 1u << 5;
+        input |= _ff_rollback_pack_axis(pad.x) << 6;
+        input |= _ff_rollback_pack_axis(pad.y) << (6 + _FF_ROLLBACK_AXIS_BITS);
+    }
+    return input;
+}
+
+/// @brief The pad state packed in the input.
+Pad rollback_input_pad(RollbackInput input)
+{
+    Pad pad;
+    pad.touched = (input & (1u << 5)) != 0;
+    pad.x = _ff_rollback_unpack_axis((input >> 6) & ((1u << _FF_ROLLBACK_AXIS_BITS) - 1));
+    pad.y = _ff_rollback_unpack_axis(input >> (6 + _FF_ROLLBACK_AXIS_BITS));
+    return pad;
+}
+
+/// @brief The button bits packed in the input.
+uint8_t rollback_input_buttons(RollbackInput input)
+{
+    return input & 0x1f;
+}
@@ -0,0 +1,130 @@
+/// @file
+/// @brief Rollback support: state snapshots, input history, and resimulation.
+///
+/// @details The game keeps all simulated state in a single memory region and
+/// advances it with a deterministic step function. Every frame, the state is
+/// snapshotted into a ring buffer before the step runs. Inputs of remote peers
+/// that haven't arrived yet are predicted by repeating their last input.
+/// When a late input differs from the prediction, the state is restored
+/// from the snapshot of that frame and the steps since then run again
+/// with the corrected inputs, all inside the next rollback_advance.
+///
+/// ```c
+/// void update()
+/// {
+///     Pad pad = read_pad(me);
+///     rollback_set_input(&rb, rb.frame, me, rollback_pack_input(pad, input.held[me]));
+///     // ...and rollback_set_input for remote inputs as they arrive.
+///     rollback_advance(&rb);
+/// }
+/// ```
+///
+/// The step must depend only on the state and the inputs: no host input,
+/// no get_random (keep a PRNG in the state), and no drawing. Drawing commands
+/// issued by the step during resimulation are dropped.
+///
+/// Snapshots are either full copies of the state or copies of only the pages
+/// changed since the snapshot in the reused ring slot was taken
+/// (found by comparing with the previous snapshot). Run `task bench`
+/// to see which is faster for your state size.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The number of peers in the input history, one per bit of Peers.
+#define ROLLBACK_MAX_PEERS 32
+
+/// @brief The granularity of page snapshots, in bytes.
+#define ROLLBACK_PAGE_SIZE 256
+
+/// @brief How the state is snapshotted.
+enum RollbackMode
+{
+    /// @brief Copy the whole state every frame.
+    ROLLBACK_COPY = 0,
+    /// @brief Copy only the pages that changed since the ring slot was last written.
+    ROLLBACK_PAGES = 1,
+};
+typedef enum RollbackMode RollbackMode;
+
+/// @brief The input of a peer in a single frame, bit-packed into 32 bits.
+/// @details Bits from the lowest: 5 buttons (as in read_buttons), touched,
+/// 13 bits of pad x, and 13 bits of pad y.
+typedef uint32_t RollbackInput;
+
+/// @brief Advance the state by one frame using the inputs of all peers.
+/// @details The inputs are indexed by peer, only online peers are meaningful.
+typedef void (*RollbackStep)(void *ctx, const RollbackInput *inputs, Peers peers);
+
+/// @brief Counters of the rollback machinery.
+struct RollbackStats
+{
+    /// @brief The number of snapshots taken.
+    uint32_t saves;
+    /// @brief The number of times the state was restored from a snapshot.
+    uint32_t restores;
+    /// @brief The number of steps run again after a restore.
+    uint32_t resimulated;
+    /// @brief The number of state bytes copied into snapshots.
+    uint64_t bytes_saved;
+    /// @brief The number of inputs that arrived too late to be used.
+    uint32_t late_inputs;
+    /// @brief The number of inputs that differed from the prediction.
+    uint32_t mispredictions;
+};
+typedef struct RollbackStats RollbackStats;
+
+/// @brief Rollback state: the snapshot ring, the input history, and the step.
+struct Rollback
+{
+    /// @private
+    uint8_t *state;
+    /// @private
+    size_t size;
+    /// @private
+    uint8_t *slots;
+    /// @private
+    int32_t *slot_frames;
+    /// @private
+    int32_t *page_changed;
+    /// @private
+    int32_t *input_frames;
+    /// @private
+    RollbackInput *inputs;
+    /// @private
+    uint32_t *confirmed;
+    /// @private
+    uint32_t *online;
+    /// @private
+    int32_t frames;
+    /// @private
+    int32_t history;
+    /// @private
+    RollbackMode mode;
+    /// @private
+    RollbackStep step;
+    /// @private
+    void *ctx;
+    /// @private
+    int32_t rollback_to;
+    /// @brief The frame the next rollback_advance simulates.
+    int32_t frame;
+    /// @brief Statistics accumulated since new_rollback or rollback_reset_stats.
+    RollbackStats stats;
+};
+typedef struct Rollback Rollback;
+
+size_t rollback_storage_size(size_t state_size, int32_t frames);
+bool new_rollback(Rollback *rb, void *state, size_t size, int32_t frames, RollbackMode mode, Buffer storage);
+void rollback_set_step(Rollback *rb, RollbackStep step, void *ctx);
+bool rollback_set_input(Rollback *rb, int32_t frame, Peer p, RollbackInput input);
+void rollback_set_peers(Rollback *rb, int32_t frame, Peers peers);
+void rollback_advance(Rollback *rb);
+void rollback_save(Rollback *rb);
+bool rollback_restore(Rollback *rb, int32_t frame);
+void rollback_reset_stats(Rollback *rb);
+
+RollbackInput rollback_pack_input(Pad pad, uint8_t buttons);
+Pad rollback_input_pad(RollbackInput input);
+uint8_t rollback_input_buttons(RollbackInput input);
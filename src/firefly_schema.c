@@ -0,0 +1,207 @@
+/// @file
+/// @brief The implementation of the bit writer and reader. See firefly_schema.h.
+
+#include "firefly_schema.h"
+
+// -- WRITER -- //
+
+/// @brief Start writing at the beginning of the buffer.
+BitWriter new_bit_writer(Buffer buf)
+{
+    BitWriter w = {
+        .buf = buf,
+        .pos = 0,
+        .acc = 0,
+        .bits = 0,
+        .overflow = false,
+    };
+    return w;
+}
+
+/// @private
+/// @brief Move `n` whole bytes from the accumulator into the buffer.
+static void _ff_bits_flush(BitWriter *w, uint32_t n)
+{
+    if (w->pos + n > w->buf.size)
+    {
+        w->overflow = true;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            w->buf.head[w->pos + i] = (char)(w->acc >> (i * 8));
+        }
+        w->pos += n;
+    }
+    w->acc = n == 8 ? 0 : w->acc >> (n * 8);
+    w->bits -= n * 8;
+}
+
+/// @brief Write the lowest `bits` bits of the value, at most 32.
+/// @details The bits are collected and written into the buffer 4 bytes at a time.
+void bits_write(BitWriter *w, uint32_t v, uint32_t bits)
+{
+    w->acc |= ((uint64_t)v & (((uint64_t)1 << bits) - 1)) << w->bits;
+    w->bits += bits;
+    if (w->bits >= 32)
+    {
+        _ff_bits_flush(w, 4);
+    }
+}
+
+/// @brief Write a single bit.
+void bits_write_bool(BitWriter *w, bool v)
+{
+    bits_write(w, v ? 1 : 0, 1);
+}
+
+/// @brief Write an integer clamped to the range, in as few bits as the range needs.
+void bits_write_range(BitWriter *w, int32_t v, int32_t min, int32_t max)
+{
+    v = v < min ? min : (v > max ? max : v);
+    uint32_t span = (uint32_t)max - (uint32_t)min;
+    bits_write(w, (uint32_t)v - (uint32_t)min, BITS_FOR(span));
+}
+
+/// @brief Write a float clamped to the range and quantized into `bits` bits, at most 24.
+/// @details NaN is written as `min`.
+void bits_write_float(BitWriter *w, float v, float min, float max, uint32_t bits)
+{
+    uint32_t steps = ((uint32_t)1 << bits) - 1;
+    uint32_t q = 0;
+    if (v >= max)
+    {
+        q = steps;
+    }
+    else if (v > min)
+    {
+        q = (uint32_t)((v - min) / (max - min) * (float)steps + 0.5f);
+    }
+    bits_write(w, q, bits);
+}
+
+/// @brief Write an unsigned integer as groups of 7 bits with a continuation bit.
+void bits_write_varint(BitWriter *w, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        bits_write(w, (v & 0x7f) | 0x80, 8);
+        v >>= 7;
+    }
+    bits_write(w, v, 8);
+}
+
+/// @brief Write a signed integer as a zigzag varint, small magnitudes take fewer bits.
+void bits_write_svarint(BitWriter *w, int32_t v)
+{
+    bits_write_varint(w, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+/// @brief Write out the last partial byte.
+/// @returns The number of bytes written, or 0 if the data didn't fit.
+size_t bits_finish(BitWriter *w)
+{
+    if (w->bits > 0)
+    {
+        _ff_bits_flush(w, (w->bits + 7) / 8);
+        w->bits = 0;
+    }
+    return w->overflow ? 0 : w->pos;
+}
+
+// -- READER -- //
+
+/// @brief Start reading at the beginning of the data.
+BitReader new_bit_reader(Buffer buf)
+{
+    BitReader r = {
+        .buf = buf,
+        .pos = 0,
+        .acc = 0,
+        .bits = 0,
+        .error = false,
+    };
+    return r;
+}
+
+/// @brief Read `bits` bits, at most 32.
+uint32_t bits_read(BitReader *r, uint32_t bits)
+{
+    if (r->bits < bits)
+    {
+        while (r->bits <= 56 && r->pos < r->buf.size)
+        {
+            r->acc |= (uint64_t)(uint8_t)r->buf.head[r->pos++] << r->bits;
+            r->bits += 8;
+        }
+        if (r->bits < bits)
+        {
+            r->error = true;
+            r->acc = 0;
+            r->bits = 0;
+            return 0;
+        }
+    }
+    uint32_t v = (uint32_t)(r->acc & (((uint64_t)1 << bits) - 1));
+    r->acc >>= bits;
+    r->bits -= bits;
+    return v;
+}
+
+/// @brief Read a single bit.
+bool bits_read_bool(BitReader *r)
+{
+    return bits_read(r, 1) != 0;
+}
+
+/// @brief Read an integer written by bits_write_range with the same range.
+/// @details A value outside of the range sets the error and returns `min`.
+int32_t bits_read_range(BitReader *r, int32_t min, int32_t max)
+{
+    uint32_t span = (uint32_t)max - (uint32_t)min;
+    uint32_t v = bits_read(r, BITS_FOR(span));
+    if (v > span)
+    {
+        r->error = true;
+        return min;
+    }
+    return (int32_t)((uint32_t)min + v);
+}
+
+/// @brief Read a float written by bits_write_float with the same range and bits.
+float bits_read_float(BitReader *r, float min, float max, uint32_t bits)
+{
+    uint32_t steps = ((uint32_t)1 << bits) - 1;
+    uint32_t q = bits_read(r, bits);
+    if (q == steps)
+    {
+        return max;
+    }
+    return min + (max - min) * ((float)q / (float)steps);
+}
+
+/// @brief Read an unsigned integer written by bits_write_varint.
+/// @details More than 5 groups set the error.
+uint32_t bits_read_varint(BitReader *r)
+{
+    uint32_t v = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+        uint32_t group = bits_read(r, 8);
+        v |= (group & 0x7f) << shift;
+        if ((group & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    r->error = true;
+    return 0;
+}
+
+/// @brief Read a signed integer written by bits_write_svarint.
+int32_t bits_read_svarint(BitReader *r)
+{
+    uint32_t v = bits_read_varint(r);
+    return (int32_t)((v >> 1) ^ (0 - (v & 1)));
+}
@@ -0,0 +1,257 @@
+/// @file
+/// @brief Bit-packed serialization of structs described by a schema.
+///
+/// @details The fields of a struct are listed once in an X-macro, together
+/// with the schema version they were added in and how they are packed
+/// (line continuations omitted):
+///
+/// ```c
+/// typedef struct
+/// {
+///     uint8_t level;
+///     float x, y;
+///     uint32_t coins;
+///     bool sword;
+///     int16_t hp;
+/// } Player;
+///
+/// #define PLAYER_FIELDS(F)
+///     F(level, 1, SCHEMA_INT(1, 99))
+///     F(x, 1, SCHEMA_FLOAT(0, 240, 12))
+///     F(y, 1, SCHEMA_FLOAT(0, 160, 12))
+///     F(coins, 1, SCHEMA_VARINT())
+///     F(sword, 1, SCHEMA_BOOL())
+///     F(hp, 2, SCHEMA_INT(-100, 100))
+///
+/// SCHEMA_DEFINE(player, Player, 2, PLAYER_FIELDS)
+/// ```
+///
+/// SCHEMA_DEFINE generates `player_encode` and `player_decode` with the bit
+/// widths and ranges passed as constants, and `player_MAX_SIZE`, the most
+/// bytes an encoded value can take. The example above packs into 7 bytes
+/// (11 for big coin counts) and so easily fits into a Stash:
+///
+/// ```c
+/// char buf[player_MAX_SIZE];
+/// size_t size = player_encode(&player, (Buffer){sizeof(buf), buf});
+/// save_stash(me, (Stash){size, buf});
+/// ...
+/// Player player = {.hp = 100};
+/// if (!player_decode(&player, load_stash(me, (Buffer){sizeof(buf), buf})))
+/// {
+///     log_error("bad stash");
+/// }
+/// ```
+///
+/// The encoded data starts with the schema version. Decoding data of an older
+/// version leaves the fields added later untouched, so set the defaults
+/// before decoding. Never change or remove the fields of a released version:
+/// append new fields with a bumped version instead.
+///
+/// Field kinds:
+///
+/// * SCHEMA_BOOL(): a single bit.
+/// * SCHEMA_INT(min, max): an integer clamped to the range, using only as many
+///   bits as the range needs.
+/// * SCHEMA_UINT(bits): the lowest bits of an unsigned integer.
+/// * SCHEMA_FLOAT(min, max, bits): a float clamped to the range and quantized
+///   into the given number of bits, at most 24.
+/// * SCHEMA_VARINT(): an unsigned integer in 7-bit groups, 8 to 40 bits.
+/// * SCHEMA_SVARINT(): a signed integer as a zigzag varint.
+///
+/// The bit writer and reader used by the generated code can also be used
+/// directly for hand-written formats.
+
+#pragma once
+
+#include "firefly.h"
+
+// -- BITS -- //
+
+/// @brief Writes values bit by bit into a Buffer.
+/// @details The bits are packed LSB first. Writing past the end of the buffer
+/// sets `overflow` and the rest of the data is dropped.
+struct BitWriter
+{
+    /// @private
+    Buffer buf;
+    /// @private
+    size_t pos;
+    /// @private
+    uint64_t acc;
+    /// @private
+    uint32_t bits;
+    /// @brief Set if the data didn't fit into the buffer.
+    bool overflow;
+};
+typedef struct BitWriter BitWriter;
+
+/// @brief Reads values bit by bit from a Buffer.
+/// @details Reading past the end of the data or reading an out of range
+/// value sets `error`. The values read after that are meaningless.
+struct BitReader
+{
+    /// @private
+    Buffer buf;
+    /// @private
+    size_t pos;
+    /// @private
+    uint64_t acc;
+    /// @private
+    uint32_t bits;
+    /// @brief Set if the data is truncated or invalid.
+    bool error;
+};
+typedef struct BitReader BitReader;
+
+BitWriter new_bit_writer(Buffer buf);
+void bits_write(BitWriter *w, uint32_t v, uint32_t bits);
+void bits_write_bool(BitWriter *w, bool v);
+void bits_write_range(BitWriter *w, int32_t v, int32_t min, int32_t max);
+void bits_write_float(BitWriter *w, float v, float min, float max, uint32_t bits);
+void bits_write_varint(BitWriter *w, uint32_t v);
+void bits_write_svarint(BitWriter *w, int32_t v);
+size_t bits_finish(BitWriter *w);
+
+BitReader new_bit_reader(Buffer buf);
+uint32_t bits_read(BitReader *r, uint32_t bits);
+bool bits_read_bool(BitReader *r);
+int32_t bits_read_range(BitReader *r, int32_t min, int32_t max);
+float bits_read_float(BitReader *r, float min, float max, uint32_t bits);
+uint32_t bits_read_varint(BitReader *r);
+int32_t bits_read_svarint(BitReader *r);
+
+/// @brief The number of bits needed for values from 0 to `n`, a constant expression.
+#define BITS_FOR(n)                                                                       \
+    ((uint32_t)(n) == 0 ? 0 : (uint32_t)(n) < 2 ? 1                                       \
+                          : (uint32_t)(n) < 4 ? 2                                         \
+                          : (uint32_t)(n) < 8 ? 3                                         \
+                          : (uint32_t)(n) < 16 ? 4                                        \
+                          : (uint32_t)(n) < 32 ? 5                                        \
+                          : (uint32_t)(n) < 64 ? 6                                        \
+                          : (uint32_t)(n) < 128 ? 7                                       \
+                          : (uint32_t)(n) < 256 ? 8                                       \
+                          : (uint32_t)(n) < 0x200 ? 9                                     \
+                          : (uint32_t)(n) < 0x400 ? 10                                    \
+                          : (uint32_t)(n) < 0x800 ? 11                                    \
+                          : (uint32_t)(n) < 0x1000 ? 12                                   \
+                          : (uint32_t)(n) < 0x2000 ? 13                                   \
+                          : (uint32_t)(n) < 0x4000 ? 14                                   \
+                          : (uint32_t)(n) < 0x8000 ? 15                                   \
+                          : (uint32_t)(n) < 0x10000 ? 16                                  \
+                          : (uint32_t)(n) < 0x20000 ? 17                                  \
+                          : (uint32_t)(n) < 0x40000 ? 18                                  \
+                          : (uint32_t)(n) < 0x80000 ? 19                                  \
+                          : (uint32_t)(n) < 0x100000 ? 20                                 \
+                          : (uint32_t)(n) < 0x200000 ? 21                                 \
+                          : (uint32_t)(n) < 0x400000 ? 22                                 \
+                          : (uint32_t)(n) < 0x800000 ? 23                                 \
+                          : (uint32_t)(n) < 0x1000000 ? 24                                \
+                          : (uint32_t)(n) < 0x2000000 ? 25                                \
+                          : (uint32_t)(n) < 0x4000000 ? 26                                \
+                          : (uint32_t)(n) < 0x8000000 ? 27                                \
+                          : (uint32_t)(n) < 0x10000000 ? 28                               \
+                          : (uint32_t)(n) < 0x20000000 ? 29                               \
+                          : (uint32_t)(n) < 0x40000000 ? 30                               \
+                          : (uint32_t)(n) < 0x80000000 ? 31                               \
+                                                      : 32)
+
+// -- SCHEMA -- //
+
+// Every kind expands into its implementation prefix followed by 3 arguments.
+#define SCHEMA_BOOL() _FF_SCHEMA_BOOL, 0, 0, 0
+#define SCHEMA_INT(min, max) _FF_SCHEMA_INT, min, max, 0
+#define SCHEMA_UINT(bits) _FF_SCHEMA_UINT, 0, 0, bits
+#define SCHEMA_FLOAT(min, max, bits) _FF_SCHEMA_FLOAT, min, max, bits
+#define SCHEMA_VARINT() _FF_SCHEMA_VARINT, 0, 0, 0
+#define SCHEMA_SVARINT() _FF_SCHEMA_SVARINT, 0, 0, 0
+
+/// @private
+#define _FF_SCHEMA_BOOL_ENC(w, x, a, b, n) bits_write_bool(w, (x))
+/// @private
+#define _FF_SCHEMA_BOOL_DEC(r, x, a, b, n) (x) = bits_read_bool(r)
+/// @private
+#define _FF_SCHEMA_BOOL_BITS(a, b, n) 1
+/// @private
+#define _FF_SCHEMA_INT_ENC(w, x, a, b, n) bits_write_range(w, (int32_t)(x), a, b)
+/// @private
+#define _FF_SCHEMA_INT_DEC(r, x, a, b, n) (x) = bits_read_range(r, a, b)
+/// @private
+#define _FF_SCHEMA_INT_BITS(a, b, n) BITS_FOR((uint32_t)(b) - (uint32_t)(a))
+/// @private
+#define _FF_SCHEMA_UINT_ENC(w, x, a, b, n) bits_write(w, (uint32_t)(x), n)
+/// @private
+#define _FF_SCHEMA_UINT_DEC(r, x, a, b, n) (x) = bits_read(r, n)
+/// @private
+#define _FF_SCHEMA_UINT_BITS(a, b, n) (n)
+/// @private
+#define _FF_SCHEMA_FLOAT_ENC(w, x, a, b, n) bits_write_float(w, (float)(x), a, b, n)
+/// @private
+#define _FF_SCHEMA_FLOAT_DEC(r, x, a, b, n) (x) = bits_read_float(r, a, b, n)
+/// @private
+#define _FF_SCHEMA_FLOAT_BITS(a, b, n) (n)
+/// @private
+#define _FF_SCHEMA_VARINT_ENC(w, x, a, b, n) bits_write_varint(w, (uint32_t)(x))
+/// @private
+#define _FF_SCHEMA_VARINT_DEC(r, x, a, b, n) (x) = bits_read_varint(r)
+/// @private
+#define _FF_SCHEMA_VARINT_BITS(a, b, n) 40
+/// @private
+#define _FF_SCHEMA_SVARINT_ENC(w, x, a, b, n) bits_write_svarint(w, (int32_t)(x))
+/// @private
+#define _FF_SCHEMA_SVARINT_DEC(r, x, a, b, n) (x) = bits_read_svarint(r)
+/// @private
+#define _FF_SCHEMA_SVARINT_BITS(a, b, n) 40
+
+/// @private
+#define _FF_SCHEMA_EXPAND(m, ...) m(__VA_ARGS__)
+/// @private
+#define _FF_SCHEMA_ENC_FIELD(field, since, kind, a, b, n) kind##_ENC(&_w, v->field, a, b, n);
+/// @private
+#define _FF_SCHEMA_DEC_FIELD(field, since, kind, a, b, n) \
+    if (_version >= (since))                              \
+    {                                                     \
+        kind##_DEC(&_r, v->field, a, b, n);               \
+    }
+/// @private
+#define _FF_SCHEMA_BITS_FIELD(field, since, kind, a, b, n) +kind##_BITS(a, b, n)
+/// @private
+#define _FF_SCHEMA_ENC(field, since, kind) _FF_SCHEMA_EXPAND(_FF_SCHEMA_ENC_FIELD, field, since, kind)
+/// @private
+#define _FF_SCHEMA_DEC(field, since, kind) _FF_SCHEMA_EXPAND(_FF_SCHEMA_DEC_FIELD, field, since, kind)
+/// @private
+#define _FF_SCHEMA_BITS(field, since, kind) _FF_SCHEMA_EXPAND(_FF_SCHEMA_BITS_FIELD, field, since, kind)
+
+/// @brief Generate the codec for the struct `type` with the fields listed by `FIELDS`.
+/// @details Defines:
+///
+/// * `name_MAX_SIZE`: the most bytes the encoded value can take.
+/// * `size_t name_encode(const type *v, Buffer buf)`: encode the value into
+///   the buffer and return the number of bytes used, or 0 if it didn't fit.
+/// * `bool name_decode(type *v, Buffer data)`: decode the value encoded by
+///   this or an older version of the schema. Returns false if the data is
+///   truncated, invalid, or of a newer version. The value may be partially
+///   updated in that case.
+#define SCHEMA_DEFINE(name, type, version, FIELDS)                              \
+    enum                                                                        \
+    {                                                                           \
+        name##_MAX_SIZE = (40 FIELDS(_FF_SCHEMA_BITS) + 7) / 8                  \
+    };                                                                          \
+    static inline size_t name##_encode(const type *v, Buffer buf)              \
+    {                                                                           \
+        BitWriter _w = new_bit_writer(buf);                                     \
+        bits_write_varint(&_w, (version));                                      \
+        FIELDS(_FF_SCHEMA_ENC)                                                  \
+        return bits_finish(&_w);                                                \
+    }                                                                           \
+    static inline bool name##_decode(type *v, Buffer data)                     \
+    {                                                                           \
+        BitReader _r = new_bit_reader(data);                                    \
+        uint32_t _version = bits_read_varint(&_r);                              \
+        if (_r.error || _version == 0 || _version > (version))                  \
+        {                                                                       \
+            return false;                                                       \
+        }                                                                       \
+        FIELDS(_FF_SCHEMA_DEC)                                                  \
+        return !_r.error;                                                       \
+    }
@@ -0,0 +1,199 @@
+/// @file
+/// @brief The implementation of the pixel kernels. See firefly_simd.h.
+
+#include "firefly_simd.h"
+#include <string.h>
+
+#if defined(FIREFLY_NO_SIMD)
+#define _FF_SIMD_NONE
+#elif defined(__wasm_simd128__)
+#define _FF_SIMD_WASM
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#define _FF_SIMD_SSE2
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define _FF_SIMD_NEON
+#include <arm_neon.h>
+#else
+#define _FF_SIMD_NONE
+#endif
+
+/// @brief Fill pixel data with a single color.
+/// @details The value is the pixel value (0-15) written into both halves of every byte.
+void packed_fill(uint8_t *dst, size_t len, uint8_t value)
+{
+    uint8_t byte = (value & 0xf) * 0x11;
+#if defined(_FF_SIMD_WASM)
+    size_t i = 0;
+    v128_t v = wasm_u8x16_splat(byte);
+    for (; i + 16 <= len; i += 16)
+    {
+        wasm_v128_store(dst + i, v);
+    }
+    for (; i < len; i++)
+    {
+        dst[i] = byte;
+    }
+#else
+    // Native libc memset is already vectorized (and wider than 128 bits).
+    memset(dst, byte, len);
+#endif
+}
+
+/// @brief Copy pixel data. The regions must not overlap.
+void packed_copy(uint8_t *dst, const uint8_t *src, size_t len)
+{
+#if defined(_FF_SIMD_WASM)
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        wasm_v128_store(dst + i, wasm_v128_load(src + i));
+    }
+    for (; i < len; i++)
+    {
+        dst[i] = src[i];
+    }
+#else
+    memcpy(dst, src, len);
+#endif
+}
+
+/// @brief Copy pixel data except the pixels with the transparent value.
+/// @details Pass a value above 15 to copy all pixels.
+void packed_blit(uint8_t *dst, const uint8_t *src, size_t len, uint8_t transparent)
+{
+    if (transparent > 0xf)
+    {
+        packed_copy(dst, src, len);
+        return;
+    }
+    size_t i = 0;
+#if defined(_FF_SIMD_WASM)
+    v128_t t = wasm_u8x16_splat(transparent);
+    v128_t lowMask = wasm_u8x16_splat(0x0f);
+    v128_t highMask = wasm_u8x16_splat(0xf0);
+    for (; i + 16 <= len; i += 16)
+    {
+        v128_t s = wasm_v128_load(src + i);
+        v128_t d = wasm_v128_load(dst + i);
+        v128_t keepHigh = wasm_v128_and(wasm_i8x16_eq(wasm_u8x16_shr(s, 4), t), highMask);
+        v128_t keepLow = wasm_v128_and(wasm_i8x16_eq(wasm_v128_and(s, lowMask), t), lowMask);
+        wasm_v128_store(dst + i, wasm_v128_bitselect(d, s, wasm_v128_or(keepHigh, keepLow)));
+    }
+#elif defined(_FF_SIMD_SSE2)
+    __m128i t = _mm_set1_epi8((char)transparent);
+    __m128i lowMask = _mm_set1_epi8(0x0f);
+    __m128i highMask = _mm_set1_epi8((char)0xf0);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(s, 4), lowMask);
+        __m128i low = _mm_and_si128(s, lowMask);
+        __m128i keep = _mm_or_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(high, t), highMask),
+            _mm_and_si128(_mm_cmpeq_epi8(low, t), lowMask));
+        __m128i out = _mm_or_si128(_mm_andnot_si128(keep, s), _mm_and_si128(keep, d));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+#elif defined(_FF_SIMD_NEON)
+    uint8x16_t t = vdupq_n_u8(transparent);
+    uint8x16_t lowMask = vdupq_n_u8(0x0f);
+    uint8x16_t highMask = vdupq_n_u8(0xf0);
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t d = vld1q_u8(dst + i);
+        uint8x16_t keep = vorrq_u8(
+            vandq_u8(vceqq_u8(vshrq_n_u8(s, 4), t), highMask),
+            vandq_u8(vceqq_u8(vandq_u8(s, lowMask), t), lowMask));
+        vst1q_u8(dst + i, vbslq_u8(keep, d, s));
+    }
+#endif
+    for (; i < len; i++)
+    {
+        uint8_t s = src[i];
+        uint8_t keep = ((s >> 4) == transparent ? 0xf0 : 0) | ((s & 0xf) == transparent ? 0x0f : 0);
+        dst[i] = (s & ~keep) | (dst[i] & keep);
+    }
+}
+
+/// @brief Replace every pixel value v with lut[v].
+/// @details The source and destination may be the same buffer.
+void packed_remap(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t lut[16])
+{
+    size_t i = 0;
+#if defined(_FF_SIMD_WASM)
+    v128_t table = wasm_v128_load(lut);
+    v128_t lowMask = wasm_u8x16_splat(0x0f);
+    for (; i + 16 <= len; i += 16)
+    {
+        v128_t s = wasm_v128_load(src + i);
+        v128_t high = wasm_i8x16_swizzle(table, wasm_u8x16_shr(s, 4));
+        v128_t low = wasm_i8x16_swizzle(table, wasm_v128_and(s, lowMask));
+        v128_t out = wasm_v128_or(wasm_i8x16_shl(high, 4), wasm_v128_and(low, lowMask));
+        wasm_v128_store(dst + i, out);
+    }
+#elif defined(_FF_SIMD_SSE2) && defined(__SSSE3__)
+    __m128i table = _mm_loadu_si128((const __m128i *)lut);
+    __m128i lowMask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i high = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(s, 4), lowMask));
+        __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(s, lowMask));
+        __m128i out = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(high, lowMask), 4), _mm_and_si128(low, lowMask));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+#elif defined(_FF_SIMD_NEON)
+    uint8x16_t table = vld1q_u8(lut);
+    uint8x16_t lowMask = vdupq_n_u8(0x0f);
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t high = vqtbl1q_u8(table, vshrq_n_u8(s, 4));
+        uint8x16_t low = vqtbl1q_u8(table, vandq_u8(s, lowMask));
+        vst1q_u8(dst + i, vorrq_u8(vshlq_n_u8(high, 4), vandq_u8(low, lowMask)));
+    }
+#endif
+#if defined(_FF_SIMD_NONE) || (defined(_FF_SIMD_SSE2) && !defined(__SSSE3__))
+    // Without a byte shuffle, a table of all 256 byte values is the fastest.
+    if (len - i >= 256)
+    {
+        uint8_t bytes[256];
+        for (int32_t b = 0; b < 256; b++)
+        {
+            bytes[b] = (lut[b >> 4] << 4) | (lut[b & 0xf] & 0xf);
+        }
+        for (; i < len; i++)
+        {
+            dst[i] = bytes[src[i]];
+        }
+    }
+#endif
+    for (; i < len; i++)
+    {
+        uint8_t s = src[i];
+        dst[i] = (lut[s >> 4] << 4) | (lut[s & 0xf] & 0xf);
+    }
+}
+
+/// @brief The name of the kernel implementation picked at compile time.
+const char *packed_backend()
+{
+#if defined(_FF_SIMD_WASM)
+    return "wasm-simd128";
+#elif defined(_FF_SIMD_SSE2) && defined(__SSSE3__)
+    return "ssse3";
+#elif defined(_FF_SIMD_SSE2)
+    return "sse2";
+#elif defined(_FF_SIMD_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
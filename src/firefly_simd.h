@@ -0,0 +1,22 @@
+/// @file
+/// @brief Vectorized kernels for the 4 bits per pixel data of images and canvases.
+///
+/// @details All kernels work on whole bytes (two pixels each) of pixel data,
+/// without the image header. The implementation is picked at compile time:
+///
+/// * WASM SIMD128 if compiled with `-msimd128`;
+/// * SSE2 (and SSSE3 for packed_remap) on x86;
+/// * NEON on ARM;
+/// * plain C otherwise or if `FIREFLY_NO_SIMD` is defined.
+///
+/// Natively, fill and copy use libc memset and memcpy which are already vectorized.
+
+#pragma once
+
+#include "firefly.h"
+
+void packed_fill(uint8_t *dst, size_t len, uint8_t value);
+void packed_copy(uint8_t *dst, const uint8_t *src, size_t len);
+void packed_blit(uint8_t *dst, const uint8_t *src, size_t len, uint8_t transparent);
+void packed_remap(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t lut[16]);
+const char *packed_backend();
@@ -0,0 +1,151 @@
+/// @file
+/// @brief The implementation of sprite batches. See firefly_sprites.h.
+
+#include "firefly_sprites.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief Create a sprite batch keeping the sprites in the given storage.
+/// @details The storage must stay alive while the batch is used.
+SpriteBatch new_sprite_batch(Buffer storage)
+{
+    uintptr_t head = (uintptr_t)storage.head;
+    uintptr_t align = _Alignof(Sprite);
+    uintptr_t aligned = (head + align - 1) & ~(align - 1);
+    size_t skip = aligned - head;
+    SpriteBatch b;
+    memset(&b, 0, sizeof(b));
+    b.sprites = (Sprite *)aligned;
+    b.cap = storage.size > skip ? (storage.size - skip) / sizeof(Sprite) : 0;
+    return b;
+}
+
+/// @brief Add a sprite drawn at the given point on the given layer.
+///
+/// @details Lower layers are drawn first. If the storage is full,
+/// the sprites added so far are flushed, so the layering is kept
+/// only within a single flush.
+void sprite_batch_add(SpriteBatch *b, SubImage source, Point p, int32_t layer)
+{
+    b->stats.submitted++;
+    if (source.size.width <= 0 || source.size.height <= 0)
+    {
+        return;
+    }
+    if (b->len == b->cap)
+    {
+        sprite_batch_flush(b);
+        if (b->cap == 0)
+        {
+            draw_sub_image(source, p);
+            b->stats.host_calls++;
+            return;
+        }
+    }
+    Sprite *s = &b->sprites[b->len];
+    s->source = source;
+    s->point = p;
+    s->layer = layer;
+    s->seq = (uint32_t)b->len;
+    b->len++;
+}
+
+/// @private
+static int _ff_sprite_cmp(const void *left, const void *right)
+{
+    const Sprite *a = (const Sprite *)left;
+    const Sprite *b = (const Sprite *)right;
+    if (a->layer != b->layer)
+    {
+        return a->layer < b->layer ? -1 : 1;
+    }
+    uintptr_t aa = (uintptr_t)a->source.image.head;
+    uintptr_t ba = (uintptr_t)b->source.image.head;
+    if (aa != ba)
+    {
+        return aa < ba ? -1 : 1;
+    }
+    return a->seq < b->seq ? -1 : (a->seq > b->seq ? 1 : 0);
+}
+
+/// @private
+/// @brief Try to extend the sprite with the next one.
+/// @details The sprites must be next to each other by the same offset
+/// both on the screen and in the atlas, and form a rectangle together.
+static bool _ff_sprite_merge(Sprite *s, const Sprite *next)
+{
+    if (s->layer != next->layer || s->source.image.head != next->source.image.head)
+    {
+        return false;
+    }
+    const SubImage *a = &s->source;
+    const SubImage *b = &next->source;
+    int32_t dx = next->point.x - s->point.x;
+    int32_t dy = next->point.y - s->point.y;
+    if (b->point.x - a->point.x != dx || b->point.y - a->point.y != dy)
+    {
+        return false;
+    }
+    // Slices reaching out of the atlas are clipped by the host, keep them as they are.
+    Size atlas = image_size(s->source.image);
+    if (a->point.x < 0 || a->point.y < 0 ||
+        b->point.x + b->size.width > atlas.width || b->point.y + b->size.height > atlas.height)
+    {
+        return false;
+    }
+    if (dy == 0 && dx == a->size.width && b->size.height == a->size.height)
+    {
+        s->source.size.width += b->size.width;
+        return true;
+    }
+    if (dx == 0 && dy == a->size.height && b->size.width == a->size.width)
+    {
+        s->source.size.height += b->size.height;
+        return true;
+    }
+    // The same slice at the same place.
+    if (dx == 0 && dy == 0 && b->size.width == a->size.width && b->size.height == a->size.height)
+    {
+        return true;
+    }
+    return false;
+}
+
+/// @brief Draw all added sprites and empty the batch.
+void sprite_batch_flush(SpriteBatch *b)
+{
+    b->stats.flushes++;
+    if (b->len == 0)
+    {
+        return;
+    }
+    qsort(b->sprites, b->len, sizeof(Sprite), _ff_sprite_cmp);
+    const char *atlas = 0;
+    size_t i = 0;
+    while (i < b->len)
+    {
+        Sprite s = b->sprites[i++];
+        while (i < b->len && _ff_sprite_merge(&s, &b->sprites[i]))
+        {
+            b->stats.merged++;
+            i++;
+        }
+        if (s.source.image.head != atlas)
+        {
+            if (atlas != 0)
+            {
+                b->stats.atlas_switches++;
+            }
+            atlas = s.source.image.head;
+        }
+        draw_sub_image(s.source, s.point);
+        b->stats.host_calls++;
+    }
+    b->len = 0;
+}
+
+/// @brief Reset the sprite batch statistics, typically at the start of a frame.
+void sprite_batch_reset_stats(SpriteBatch *b)
+{
+    memset(&b->stats, 0, sizeof(b->stats));
+}
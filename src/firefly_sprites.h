@@ -0,0 +1,63 @@
+/// @file
+/// @brief Collecting sprites from atlas images and drawing them in as few host calls as possible.
+///
+/// @details Sprites added into a SpriteBatch are not drawn right away.
+/// On flush, the batch sorts them by layer and then by atlas,
+/// keeping the order in which they were added for sprites with the same
+/// layer and atlas. That way, the host draws from one atlas image
+/// at a time. Sprites that are next to each other both on the screen
+/// and in the atlas (like the parts of a big sprite or a row of tiles)
+/// are merged into a single draw_sub_image call.
+///
+/// Atlas images must stay alive until the batch is flushed.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief Counters of the sprite batch work.
+struct SpriteStats
+{
+    /// @brief The number of sprites added.
+    uint32_t submitted;
+    /// @brief The number of sprites merged into a neighbor.
+    uint32_t merged;
+    /// @brief The number of draw_sub_image calls made.
+    uint32_t host_calls;
+    /// @brief The number of times the atlas changed between host calls.
+    uint32_t atlas_switches;
+    /// @brief The number of flushes, including ones caused by a full storage.
+    uint32_t flushes;
+};
+typedef struct SpriteStats SpriteStats;
+
+/// @private
+/// @brief A sprite waiting to be drawn.
+struct Sprite
+{
+    SubImage source;
+    Point point;
+    int32_t layer;
+    /// @brief The order in which the sprite was added, to make the sort stable.
+    uint32_t seq;
+};
+typedef struct Sprite Sprite;
+
+/// @brief A collection of sprites to be drawn together.
+struct SpriteBatch
+{
+    /// @private
+    Sprite *sprites;
+    /// @private
+    size_t len;
+    /// @private
+    size_t cap;
+    /// @brief Statistics accumulated since new_sprite_batch or sprite_batch_reset_stats.
+    SpriteStats stats;
+};
+typedef struct SpriteBatch SpriteBatch;
+
+SpriteBatch new_sprite_batch(Buffer storage);
+void sprite_batch_add(SpriteBatch *b, SubImage source, Point p, int32_t layer);
+void sprite_batch_flush(SpriteBatch *b);
+void sprite_batch_reset_stats(SpriteBatch *b);
@@ -0,0 +1,237 @@
+/// @file
+/// @brief The implementation of the stats cache. See firefly_stats.h.
+
+#include "firefly_stats.h"
+#include <string.h>
+
+/// @brief Create an empty cache flushing every `interval` calls of stats_cache_update.
+/// @details With interval 0, the changes are sent only by stats_cache_flush.
+StatsCache new_stats_cache(uint32_t interval)
+{
+    StatsCache c;
+    memset(&c, 0, sizeof(c));
+    c.interval = interval;
+    return c;
+}
+
+/// @private
+static struct _ffStatsEntry *_ff_stats_find(StatsCache *c, bool score, Peer p, uint32_t id)
+{
+    uint32_t h = id * 2654435761u ^ (uint32_t)p * 40503u ^ (score ? 0x9e37u : 0);
+    for (uint32_t i = 0; i < STATS_CACHE_SIZE; i++)
+    {
+        struct _ffStatsEntry *e = &c->entries[(h + i) & (STATS_CACHE_SIZE - 1)];
+        if (!e->used)
+        {
+            return e;
+        }
+        if (e->id == id && e->peer == p && e->score == score)
+        {
+            return e;
+        }
+    }
+    return 0;
+}
+
+/// @private
+/// @brief The entry for the value, read from the host if not cached yet.
+static struct _ffStatsEntry *_ff_stats_entry(StatsCache *c, bool score, Peer p, uint32_t id)
+{
+    struct _ffStatsEntry *e = _ff_stats_find(c, score, p, id);
+    if (e != 0 && e->used)
+    {
+        return e;
+    }
+    if (e == 0 || c->len >= STATS_CACHE_MAX_LOAD)
+    {
+        stats_cache_flush(c);
+        memset(c->entries, 0, sizeof(c->entries));
+        c->len = 0;
+        e = _ff_stats_find(c, score, p, id);
+    }
+    e->used = true;
+    e->dirty = false;
+    e->id = id;
+    e->peer = (uint8_t)p;
+    e->score = score;
+    c->len++;
+    c->stats.reads++;
+    if (score)
+    {
+        e->host = add_score(p, id, 0);
+        e->goal = 0;
+    }
+    else
+    {
+        Progress r = add_progress(p, id, 0);
+        e->host = r.done;
+        e->goal = r.goal;
+    }
+    e->local = e->host;
+    return e;
+}
+
+/// @private
+static bool _ff_stats_cacheable(Peer p)
+{
+    return p >= 0 && p < 32;
+}
+
+/// @private
+static Peers _ff_stats_peers(StatsCache *c)
+{
+    if (!c->peers_known)
+    {
+        c->peers = get_peers();
+        c->peers_known = true;
+    }
+    return c->peers;
+}
+
+/// @private
+static uint32_t _ff_stats_progress_one(StatsCache *c, Peer p, Badge b, int16_t v)
+{
+    struct _ffStatsEntry *e = _ff_stats_entry(c, false, p, b);
+    int32_t done = e->local + v;
+    done = done < 0 ? 0 : (done > e->goal ? e->goal : done);
+    e->local = done;
+    e->dirty = e->local != e->host;
+    return ((uint32_t)done << 16) | e->goal;
+}
+
+/// @brief Add the given value to the progress for the badge, like add_progress.
+/// @details The change is sent to the host on the next flush.
+Progress stats_add_progress(StatsCache *c, Peer p, Badge b, int16_t v)
+{
+    uint32_t r = 0;
+    if (p == COMBINED)
+    {
+        uint32_t lowest = 0xffffffff;
+        for (uint32_t bits = _ff_stats_peers(c).online; bits != 0; bits &= bits - 1)
+        {
+            uint32_t one = _ff_stats_progress_one(c, __builtin_ctz(bits), b, v);
+            lowest = one < lowest ? one : lowest;
+        }
+        r = lowest == 0xffffffff ? 0 : lowest;
+    }
+    else if (_ff_stats_cacheable(p))
+    {
+        r = _ff_stats_progress_one(c, p, b, v);
+    }
+    else
+    {
+        return add_progress(p, b, v);
+    }
+    c->stats.calls++;
+    Progress progress = {
+        .done = r >> 16,
+        .goal = r};
+    return progress;
+}
+
+/// @brief Get the progress of earning the badge, like get_progress.
+Progress stats_get_progress(StatsCache *c, Peer p, Badge b)
+{
+    return stats_add_progress(c, p, b, 0);
+}
+
+/// @private
+static Score _ff_stats_score_one(StatsCache *c, Peer p, Board b, Score v)
+{
+    struct _ffStatsEntry *e = _ff_stats_entry(c, true, p, b);
+    if (v != 0 && (e->local == 0 || v > e->local))
+    {
+        e->local = v;
+        e->dirty = e->local != e->host;
+    }
+    return e->local;
+}
+
+/// @brief Add the given score to the board, like add_score.
+/// @details Only the best of the scores added between flushes is sent to the host.
+Score stats_add_score(StatsCache *c, Peer p, Board b, Score v)
+{
+    Score r = 0;
+    if (p == COMBINED)
+    {
+        bool any = false;
+        for (uint32_t bits = _ff_stats_peers(c).online; bits != 0; bits &= bits - 1)
+        {
+            Score one = _ff_stats_score_one(c, __builtin_ctz(bits), b, v);
+            r = !any || one < r ? one : r;
+            any = true;
+        }
+    }
+    else if (_ff_stats_cacheable(p))
+    {
+        r = _ff_stats_score_one(c, p, b, v);
+    }
+    else
+    {
+        return add_score(p, b, v);
+    }
+    c->stats.calls++;
+    return r;
+}
+
+/// @brief Get the personal best of the player, like get_score.
+Score stats_get_score(StatsCache *c, Peer p, Board b)
+{
+    return stats_add_score(c, p, b, 0);
+}
+
+/// @brief Count a frame and flush if the interval has passed.
+/// @details Call it once per update.
+void stats_cache_update(StatsCache *c)
+{
+    c->frames++;
+    if (c->interval != 0 && c->frames >= c->interval)
+    {
+        stats_cache_flush(c);
+    }
+}
+
+/// @brief Send all accumulated changes to the host.
+/// @details Call it in the BEFORE_EXIT callback so that nothing is lost.
+void stats_cache_flush(StatsCache *c)
+{
+    for (int32_t i = 0; i < STATS_CACHE_SIZE; i++)
+    {
+        struct _ffStatsEntry *e = &c->entries[i];
+        if (!e->used || !e->dirty)
+        {
+            continue;
+        }
+        if (e->score)
+        {
+            e->host = add_score(e->peer, e->id, e->local);
+            c->stats.writes++;
+        }
+        else
+        {
+            // The delta can be bigger than int16_t for goals above 32767.
+            Progress r = {(uint16_t)e->host, e->goal};
+            int32_t delta = e->local - e->host;
+            while (delta != 0)
+            {
+                int16_t step = delta > INT16_MAX ? INT16_MAX : (delta < INT16_MIN ? INT16_MIN : (int16_t)delta);
+                r = add_progress(e->peer, e->id, step);
+                delta -= step;
+                c->stats.writes++;
+            }
+            e->host = r.done;
+            e->goal = r.goal;
+        }
+        e->local = e->host;
+        e->dirty = false;
+    }
+    c->peers_known = false;
+    c->frames = 0;
+    c->stats.flushes++;
+}
+
+/// @brief Reset the cache statistics.
+void stats_cache_reset_stats(StatsCache *c)
+{
+    memset(&c->stats, 0, sizeof(c->stats));
+}
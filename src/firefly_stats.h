@@ -0,0 +1,100 @@
+/// @file
+/// @brief A write-behind cache for badge progress and board scores.
+///
+/// @details add_progress and add_score are synchronous host calls, and so are
+/// get_progress and get_score. The cache answers all of them locally
+/// and sends only the accumulated changes to the host, at most once
+/// per interval and on stats_cache_flush:
+///
+/// ```c
+/// static StatsCache stats;
+///
+/// BOOT void boot()
+/// {
+///     stats = new_stats_cache(60);
+/// }
+///
+/// UPDATE void update()
+/// {
+///     stats_add_progress(&stats, me, BADGE_COINS, 1);
+///     stats_cache_update(&stats);
+/// }
+///
+/// BEFORE_EXIT void before_exit()
+/// {
+///     stats_cache_flush(&stats);
+/// }
+/// ```
+///
+/// The values are the same as the host would return: progress is clamped
+/// after every change and scores keep the personal best. COMBINED changes
+/// the values of every online peer and returns the lowest of them.
+/// The online peers are refreshed on every flush.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The number of slots in the cache, a power of two.
+#define STATS_CACHE_SIZE 64
+
+/// @brief How many slots can be used before the cache is flushed and cleared.
+#define STATS_CACHE_MAX_LOAD (STATS_CACHE_SIZE * 3 / 4)
+
+/// @private
+struct _ffStatsEntry
+{
+    uint32_t id;
+    uint8_t peer;
+    bool score;
+    bool used;
+    bool dirty;
+    /// @brief The value known to be on the host.
+    int32_t host;
+    /// @brief The value including the changes not sent yet.
+    int32_t local;
+    uint16_t goal;
+};
+
+/// @brief Counters of the cache work.
+struct StatsCacheStats
+{
+    /// @brief The number of add and get calls answered by the cache.
+    uint32_t calls;
+    /// @brief The number of host calls reading values not in the cache yet.
+    uint32_t reads;
+    /// @brief The number of host calls writing accumulated changes.
+    uint32_t writes;
+    /// @brief The number of flushes.
+    uint32_t flushes;
+};
+typedef struct StatsCacheStats StatsCacheStats;
+
+/// @brief The cache of badge progress and board scores.
+struct StatsCache
+{
+    /// @private
+    struct _ffStatsEntry entries[STATS_CACHE_SIZE];
+    /// @private
+    int32_t len;
+    /// @private
+    uint32_t interval;
+    /// @private
+    uint32_t frames;
+    /// @private
+    Peers peers;
+    /// @private
+    bool peers_known;
+    /// @brief Statistics accumulated since new_stats_cache or stats_cache_reset_stats.
+    StatsCacheStats stats;
+};
+typedef struct StatsCache StatsCache;
+
+StatsCache new_stats_cache(uint32_t interval);
+Progress stats_add_progress(StatsCache *c, Peer p, Badge b, int16_t v);
+Progress stats_get_progress(StatsCache *c, Peer p, Badge b);
+Score stats_add_score(StatsCache *c, Peer p, Board b, Score v);
+Score stats_get_score(StatsCache *c, Peer p, Board b);
+void stats_cache_update(StatsCache *c);
+void stats_cache_flush(StatsCache *c);
+void stats_cache_reset_stats(StatsCache *c);
@@ -0,0 +1,227 @@
+/// @file
+/// @brief The implementation of text runs and the text cache. See firefly_text.h.
+
+#include "firefly_text.h"
+#include "firefly_canvas.h"
+#include <string.h>
+
+/// @private
+/// @brief The font header: magic, encoding, glyph width, glyph height, baseline.
+#define _FF_FONT_HEADER 5
+
+/// @brief Measure the text rendered with the given font, in pixels.
+/// @details Every line is as high as a glyph. Returns zero size for an invalid font.
+Size measure_text(const char *t, size_t len, Font f)
+{
+    Size s = {0, 0};
+    if (f.size < _FF_FONT_HEADER || len == 0)
+    {
+        return s;
+    }
+    const uint8_t *font = (const uint8_t *)f.head;
+    int32_t lines = 1;
+    int32_t cols = 0;
+    int32_t maxCols = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (t[i] == '\n')
+        {
+            lines++;
+            cols = 0;
+            continue;
+        }
+        cols++;
+        maxCols = cols > maxCols ? cols : maxCols;
+    }
+    s.width = maxCols * font[2];
+    s.height = lines * font[3];
+    return s;
+}
+
+/// @brief Measure the null-terminated text once to draw it many times.
+/// @details The text and the font must stay alive while the run is used.
+TextRun new_text_run(const char *t, Font f)
+{
+    TextRun r;
+    r.text = t;
+    r.len = strlen(t);
+    r.font = f;
+    r.size = measure_text(t, r.len, f);
+    r.baseline = f.size < _FF_FONT_HEADER ? 0 : (uint8_t)f.head[4];
+    return r;
+}
+
+/// @brief Render the text run. The point is the baseline of the first line, like in draw_text.
+void draw_text_run(const TextRun *r, Point p, Color c)
+{
+    DrawCmd cmd = {DRAW_TEXT, (char *)r->text, r->font.head, {p.x, p.y, c, (int32_t)r->len, (int32_t)r->font.size}};
+    submit_draw_cmd(&cmd);
+}
+
+/// @brief Create a text cache keeping the canvases in the given storage.
+/// @details The storage must stay alive while the cache is used.
+TextCache new_text_cache(Buffer storage)
+{
+    TextCache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.storage = storage;
+    return cache;
+}
+
+/// @private
+static uint32_t _ff_text_hash(const char *t, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (uint8_t)t[i]) * 16777619u;
+    }
+    return h;
+}
+
+/// @private
+/// @brief Move the live entries to the start of the storage, closing the gaps.
+static void _ff_text_compact(TextCache *cache)
+{
+    size_t head = 0;
+    while (true)
+    {
+        // Entries are few, so pick the next one by offset instead of sorting.
+        TextCacheEntry *next = 0;
+        for (int32_t i = 0; i < TEXT_CACHE_MAX_ENTRIES; i++)
+        {
+            TextCacheEntry *e = &cache->entries[i];
+            if (e->used && e->offset >= head && (next == 0 || e->offset < next->offset))
+            {
+                next = e;
+            }
+        }
+        if (next == 0)
+        {
+            break;
+        }
+        if (next->offset != head)
+        {
+            memmove(cache->storage.head + head, cache->storage.head + next->offset, next->size);
+            next->offset = head;
+            next->canvas.head = cache->storage.head + head;
+        }
+        head += next->size;
+    }
+    cache->used = head;
+}
+
+/// @private
+/// @brief Find a free entry with the given amount of free storage, evicting old entries.
+static TextCacheEntry *_ff_text_alloc(TextCache *cache, size_t size)
+{
+    if (size > cache->storage.size)
+    {
+        return 0;
+    }
+    while (true)
+    {
+        size_t live = 0;
+        TextCacheEntry *slot = 0;
+        TextCacheEntry *oldest = 0;
+        for (int32_t i = 0; i < TEXT_CACHE_MAX_ENTRIES; i++)
+        {
+            TextCacheEntry *e = &cache->entries[i];
+            if (!e->used)
+            {
+                slot = slot == 0 ? e : slot;
+                continue;
+            }
+            live += e->size;
+            if (oldest == 0 || e->last_used < oldest->last_used)
+            {
+                oldest = e;
+            }
+        }
+        if (slot != 0 && live + size <= cache->storage.size)
+        {
+            if (cache->used + size > cache->storage.size)
+            {
+                _ff_text_compact(cache);
+            }
+            slot->offset = cache->used;
+            slot->size = size;
+            cache->used += size;
+            return slot;
+        }
+        oldest->used = false;
+        cache->stats.evictions++;
+    }
+}
+
+/// @brief Draw the text run from the cache, rendering it into a canvas on the first use.
+///
+/// @details The point is the baseline of the first line, like in draw_text.
+/// Runs are identified by their content, font, and color.
+void text_cache_draw(TextCache *cache, const TextRun *r, Point p, Color c)
+{
+    if (r->len == 0 || r->size.width == 0 || c == NONE)
+    {
+        return;
+    }
+    cache->clock++;
+    uint32_t hash = _ff_text_hash(r->text, r->len);
+    for (int32_t i = 0; i < TEXT_CACHE_MAX_ENTRIES; i++)
+    {
+        TextCacheEntry *e = &cache->entries[i];
+        if (e->used && e->hash == hash && e->len == r->len && e->font == r->font.head && e->color == c &&
+            memcmp(e->canvas.head + e->canvas.size, r->text, r->len) == 0)
+        {
+            e->last_used = cache->clock;
+            cache->stats.hits++;
+            draw_image(e->canvas, (Point){p.x, p.y - e->baseline});
+            return;
+        }
+    }
+
+    // Canvas width must be even.
+    Size size = {(r->size.width + 1) & ~1, r->size.height};
+    size_t canvasSize = canvas_buffer_size(size);
+    TextCacheEntry *e = _ff_text_alloc(cache, canvasSize + r->len);
+    if (e == 0)
+    {
+        cache->stats.uncached++;
+        draw_text_run(r, p, c);
+        return;
+    }
+    e->used = true;
+    e->font = r->font.head;
+    e->color = c;
+    e->len = r->len;
+    e->hash = hash;
+    e->baseline = r->baseline;
+    e->last_used = cache->clock;
+    e->canvas = new_canvas((Buffer){canvasSize, cache->storage.head + e->offset}, size);
+    memcpy(e->canvas.head + canvasSize, r->text, r->len);
+    cache->stats.misses++;
+
+    // Any color other than the text color works as the transparent background.
+    Color key = c == BLACK ? WHITE : BLACK;
+    canvas_clear(e->canvas, key);
+    canvas_set_transparent(e->canvas, key);
+    set_canvas(e->canvas);
+    draw_text_run(r, (Point){0, r->baseline}, c);
+    unset_canvas();
+    draw_image(e->canvas, (Point){p.x, p.y - e->baseline});
+}
+
+/// @brief Drop all cached runs.
+void text_cache_clear(TextCache *cache)
+{
+    for (int32_t i = 0; i < TEXT_CACHE_MAX_ENTRIES; i++)
+    {
+        cache->entries[i].used = false;
+    }
+    cache->used = 0;
+}
+
+/// @brief Reset the text cache statistics.
+void text_cache_reset_stats(TextCache *cache)
+{
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
@@ -0,0 +1,92 @@
+/// @file
+/// @brief Pre-measured text runs and a cache of text rendered into canvases.
+///
+/// @details A TextRun keeps the text length and its size in pixels,
+/// measured once from the font metrics, so drawing it doesn't need strlen.
+///
+/// A TextCache goes further and renders the run into a Canvas
+/// on the first use. Later frames draw the cached canvas with a single
+/// draw_image, without the host rasterizing the glyphs again.
+/// The cache uses a fixed storage and evicts the least recently used runs
+/// when it gets full. Evicting moves the remaining canvases, so flush
+/// any DrawBatch that recorded them before drawing more cached text.
+///
+/// Build firefly_canvas.c and firefly_simd.c as well.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The maximum number of runs kept in a TextCache.
+#define TEXT_CACHE_MAX_ENTRIES 32
+
+/// @brief A text with its length and size measured in advance.
+struct TextRun
+{
+    /// @brief The text. It doesn't have to be null-terminated.
+    const char *text;
+    /// @brief The text length, in bytes.
+    size_t len;
+    /// @brief The font used to measure and render the text.
+    Font font;
+    /// @brief The width and height of the rendered text, in pixels.
+    Size size;
+    /// @brief The distance from the top of the text to the baseline of the first line.
+    int32_t baseline;
+};
+typedef struct TextRun TextRun;
+
+/// @brief Counters of the text cache work.
+struct TextCacheStats
+{
+    /// @brief The number of cached runs drawn from a cached canvas.
+    uint32_t hits;
+    /// @brief The number of cached runs rendered into a new canvas.
+    uint32_t misses;
+    /// @brief The number of runs evicted to make space for new ones.
+    uint32_t evictions;
+    /// @brief The number of runs too big for the cache, drawn as text.
+    uint32_t uncached;
+};
+typedef struct TextCacheStats TextCacheStats;
+
+/// @private
+struct TextCacheEntry
+{
+    const char *font;
+    Color color;
+    size_t len;
+    uint32_t hash;
+    /// @brief The canvas followed by a copy of the text, as an offset in the storage.
+    size_t offset;
+    size_t size;
+    Canvas canvas;
+    int32_t baseline;
+    uint32_t last_used;
+    bool used;
+};
+typedef struct TextCacheEntry TextCacheEntry;
+
+/// @brief A memory-bounded LRU cache of runs rendered into canvases.
+struct TextCache
+{
+    /// @private
+    Buffer storage;
+    /// @private
+    size_t used;
+    /// @private
+    uint32_t clock;
+    /// @private
+    TextCacheEntry entries[TEXT_CACHE_MAX_ENTRIES];
+    /// @brief Statistics accumulated since new_text_cache or text_cache_reset_stats.
+    TextCacheStats stats;
+};
+typedef struct TextCache TextCache;
+
+Size measure_text(const char *t, size_t len, Font f);
+TextRun new_text_run(const char *t, Font f);
+void draw_text_run(const TextRun *r, Point p, Color c);
+TextCache new_text_cache(Buffer storage);
+void text_cache_draw(TextCache *cache, const TextRun *r, Point p, Color c);
+void text_cache_clear(TextCache *cache);
+void text_cache_reset_stats(TextCache *cache);
@@ -0,0 +1,236 @@
+/// @file
+/// @brief The implementation of tilemaps. See firefly_tilemap.h.
+
+#include "firefly_tilemap.h"
+#include "firefly_canvas.h"
+#include <string.h>
+
+/// @private
+/// @brief The preferred chunk width and height, in pixels.
+#define _FF_TILEMAP_CHUNK_PIXELS 128
+
+/// @private
+static Size _ff_tilemap_chunk_tiles(Size tile)
+{
+    Size c = {1, 1};
+    if (tile.width > 0 && tile.width < _FF_TILEMAP_CHUNK_PIXELS)
+    {
+        c.width = _FF_TILEMAP_CHUNK_PIXELS / tile.width;
+    }
+    if (tile.height > 0 && tile.height < _FF_TILEMAP_CHUNK_PIXELS)
+    {
+        c.height = _FF_TILEMAP_CHUNK_PIXELS / tile.height;
+    }
+    c.width = c.width > TILEMAP_MAX_CHUNK_TILES ? TILEMAP_MAX_CHUNK_TILES : c.width;
+    c.height = c.height > TILEMAP_MAX_CHUNK_TILES ? TILEMAP_MAX_CHUNK_TILES : c.height;
+    // Canvas width must be even.
+    if (tile.width % 2 != 0 && c.width % 2 != 0)
+    {
+        c.width = c.width == 1 ? 2 : c.width - 1;
+    }
+    return c;
+}
+
+/// @brief The number of bytes of storage needed to cache one chunk for the tile size.
+/// @details Covering the whole screen takes up to 9 chunks, so give
+/// new_tilemap at least 9 times that.
+size_t tilemap_chunk_buffer_size(Size tile)
+{
+    Size c = _ff_tilemap_chunk_tiles(tile);
+    Size px = {c.width * tile.width, c.height * tile.height};
+    return canvas_buffer_size(px);
+}
+
+/// @brief Initialize a tilemap.
+///
+/// @details The tiles array is not copied and must stay alive.
+/// Change it only using tilemap_set_tile or call tilemap_invalidate after.
+/// The storage is split into chunk caches (see tilemap_chunk_buffer_size).
+void new_tilemap(Tilemap *m, Image tileset, Size tile, uint16_t *tiles, Size map, Buffer storage)
+{
+    memset(m, 0, sizeof(*m));
+    m->tileset = tileset;
+    m->tile = tile;
+    m->tiles = tiles;
+    m->map = map;
+    m->background = BLACK;
+    m->chunk = _ff_tilemap_chunk_tiles(tile);
+    Size px = {m->chunk.width * tile.width, m->chunk.height * tile.height};
+    size_t size = canvas_buffer_size(px);
+    while (m->chunks_len < TILEMAP_MAX_CHUNKS && storage.size >= size)
+    {
+        TileChunk *c = &m->chunks[m->chunks_len++];
+        c->canvas = new_canvas(storage, px);
+        storage.head += size;
+        storage.size -= size;
+    }
+}
+
+/// @private
+static TileChunk *_ff_tilemap_find(Tilemap *m, Point index)
+{
+    for (int32_t i = 0; i < m->chunks_len; i++)
+    {
+        TileChunk *c = &m->chunks[i];
+        if (c->valid && c->index.x == index.x && c->index.y == index.y)
+        {
+            return c;
+        }
+    }
+    return 0;
+}
+
+/// @brief Change a single tile.
+/// @details If the tile is in a cached chunk, only this tile will be rendered again.
+void tilemap_set_tile(Tilemap *m, Point p, uint16_t id)
+{
+    if (p.x < 0 || p.y < 0 || p.x >= m->map.width || p.y >= m->map.height)
+    {
+        return;
+    }
+    uint16_t *tile = &m->tiles[p.y * m->map.width + p.x];
+    if (*tile == id)
+    {
+        return;
+    }
+    *tile = id;
+    Point index = {p.x / m->chunk.width, p.y / m->chunk.height};
+    TileChunk *c = _ff_tilemap_find(m, index);
+    if (c != 0)
+    {
+        c->dirty[p.y % m->chunk.height] |= 1u << (p.x % m->chunk.width);
+    }
+}
+
+/// @brief Drop all cached chunks.
+/// @details Call it after changing the tileset or the tiles array directly.
+void tilemap_invalidate(Tilemap *m)
+{
+    for (int32_t i = 0; i < m->chunks_len; i++)
+    {
+        m->chunks[i].valid = false;
+    }
+}
+
+/// @private
+/// @brief Render a single tile of the chunk.
+static void _ff_tilemap_render_tile(Tilemap *m, TileChunk *c, int32_t tx, int32_t ty)
+{
+    Point dst = {tx * m->tile.width, ty * m->tile.height};
+    int32_t mx = c->index.x * m->chunk.width + tx;
+    int32_t my = c->index.y * m->chunk.height + ty;
+    uint16_t id = TILE_EMPTY;
+    if (mx < m->map.width && my < m->map.height)
+    {
+        id = m->tiles[my * m->map.width + mx];
+    }
+    canvas_rect(c->canvas, dst, m->tile, m->background);
+    m->stats.tiles_rendered++;
+    int32_t cols = image_size(m->tileset).width / m->tile.width;
+    if (id == TILE_EMPTY || cols == 0)
+    {
+        return;
+    }
+    SubImage s = {
+        .image = m->tileset,
+        .point = {(id % cols) * m->tile.width, (id / cols) * m->tile.height},
+        .size = m->tile};
+    canvas_blit_sub(c->canvas, s, dst);
+}
+
+/// @private
+/// @brief Get the chunk from the cache, rendering it if needed.
+static TileChunk *_ff_tilemap_chunk(Tilemap *m, Point index)
+{
+    TileChunk *c = _ff_tilemap_find(m, index);
+    if (c == 0)
+    {
+        // Evict the least recently used chunk.
+        for (int32_t i = 0; i < m->chunks_len; i++)
+        {
+            TileChunk *other = &m->chunks[i];
+            if (c == 0 || !other->valid || (c->valid && other->last_used < c->last_used))
+            {
+                c = other;
+            }
+        }
+        if (c == 0)
+        {
+            return 0;
+        }
+        c->index = index;
+        c->valid = true;
+        canvas_set_transparent(c->canvas, m->transparent ? m->background : NONE);
+        for (int32_t ty = 0; ty < m->chunk.height; ty++)
+        {
+            for (int32_t tx = 0; tx < m->chunk.width; tx++)
+            {
+                _ff_tilemap_render_tile(m, c, tx, ty);
+            }
+        }
+        memset(c->dirty, 0, sizeof(c->dirty));
+        m->stats.chunks_rendered++;
+    }
+    for (int32_t ty = 0; ty < m->chunk.height; ty++)
+    {
+        uint32_t row = c->dirty[ty];
+        while (row != 0)
+        {
+            int32_t tx = __builtin_ctz(row);
+            row &= row - 1;
+            _ff_tilemap_render_tile(m, c, tx, ty);
+        }
+        c->dirty[ty] = 0;
+    }
+    c->last_used = m->frame;
+    return c;
+}
+
+/// @brief Draw the part of the map visible on the screen.
+/// @details The scroll is the map pixel shown in the upper-left corner of the screen.
+void tilemap_draw(Tilemap *m, Point scroll)
+{
+    m->frame++;
+    int32_t cw = m->chunk.width * m->tile.width;
+    int32_t ch = m->chunk.height * m->tile.height;
+    if (cw <= 0 || ch <= 0)
+    {
+        return;
+    }
+    int32_t mapW = m->map.width * m->tile.width;
+    int32_t mapH = m->map.height * m->tile.height;
+    int32_t x0 = scroll.x < 0 ? 0 : scroll.x;
+    int32_t y0 = scroll.y < 0 ? 0 : scroll.y;
+    int32_t x1 = scroll.x + WIDTH > mapW ? mapW : scroll.x + WIDTH;
+    int32_t y1 = scroll.y + HEIGHT > mapH ? mapH : scroll.y + HEIGHT;
+    for (int32_t cy = y0 / ch; cy * ch < y1; cy++)
+    {
+        for (int32_t cx = x0 / cw; cx * cw < x1; cx++)
+        {
+            Point index = {cx, cy};
+            TileChunk *c = _ff_tilemap_chunk(m, index);
+            if (c == 0)
+            {
+                return;
+            }
+            // Draw only the visible part of the chunk.
+            int32_t sx0 = x0 > cx * cw ? x0 - cx * cw : 0;
+            int32_t sy0 = y0 > cy * ch ? y0 - cy * ch : 0;
+            int32_t sx1 = x1 < (cx + 1) * cw ? x1 - cx * cw : cw;
+            int32_t sy1 = y1 < (cy + 1) * ch ? y1 - cy * ch : ch;
+            SubImage s = {
+                .image = c->canvas,
+                .point = {sx0, sy0},
+                .size = {sx1 - sx0, sy1 - sy0}};
+            Point p = {cx * cw + sx0 - scroll.x, cy * ch + sy0 - scroll.y};
+            draw_sub_image(s, p);
+            m->stats.host_calls++;
+        }
+    }
+}
+
+/// @brief Reset the tilemap statistics, typically at the start of a frame.
+void tilemap_reset_stats(Tilemap *m)
+{
+    memset(&m->stats, 0, sizeof(m->stats));
+}
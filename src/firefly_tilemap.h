@@ -0,0 +1,86 @@
+/// @file
+/// @brief Tilemaps rendered from cached pre-rendered chunks.
+///
+/// @details The map is split into chunks of about 128x128 pixels.
+/// Each visible chunk is rendered once into its own Canvas
+/// using the software rasterizer from firefly_canvas.c (no host calls),
+/// and the screen is then covered with a few draw_sub_image calls,
+/// one per visible chunk. When a tile changes, only that tile
+/// is rendered again into the cached chunk.
+///
+/// Build firefly_canvas.c and firefly_simd.c as well.
+
+#pragma once
+
+#include "firefly.h"
+
+/// @brief The tile ID for a tile that is not drawn.
+#define TILE_EMPTY 0xffff
+
+/// @brief The maximum number of chunks kept in the cache.
+#define TILEMAP_MAX_CHUNKS 16
+
+/// @brief The maximum width and height of a chunk, in tiles.
+#define TILEMAP_MAX_CHUNK_TILES 32
+
+/// @brief Counters of the tilemap rendering work.
+struct TilemapStats
+{
+    /// @brief The number of draw_sub_image calls made.
+    uint32_t host_calls;
+    /// @brief The number of chunks rendered from scratch.
+    uint32_t chunks_rendered;
+    /// @brief The number of tiles rendered into chunks, including full renders.
+    uint32_t tiles_rendered;
+};
+typedef struct TilemapStats TilemapStats;
+
+/// @private
+/// @brief A cached pre-rendered chunk.
+struct TileChunk
+{
+    /// @brief The position of the chunk in the map, in chunks.
+    Point index;
+    Canvas canvas;
+    bool valid;
+    uint32_t last_used;
+    /// @brief A bit per tile that changed since the chunk was rendered.
+    uint32_t dirty[TILEMAP_MAX_CHUNK_TILES];
+};
+typedef struct TileChunk TileChunk;
+
+/// @brief A grid of tiles taken from a single tileset image.
+struct Tilemap
+{
+    /// @brief The image with all tiles, row by row.
+    Image tileset;
+    /// @brief The size of a single tile, in pixels.
+    Size tile;
+    /// @brief The tile IDs, row by row. The ID is the tile index in the tileset.
+    uint16_t *tiles;
+    /// @brief The map width and height, in tiles.
+    Size map;
+    /// @brief The color of empty tiles.
+    Color background;
+    /// @brief If true, the background is not drawn, so the map can be layered over other content.
+    /// @details The tileset must not use the background color then.
+    bool transparent;
+    /// @brief Statistics accumulated since new_tilemap or tilemap_reset_stats.
+    TilemapStats stats;
+    /// @private
+    Size chunk;
+    /// @private
+    TileChunk chunks[TILEMAP_MAX_CHUNKS];
+    /// @private
+    int32_t chunks_len;
+    /// @private
+    uint32_t frame;
+};
+typedef struct Tilemap Tilemap;
+
+size_t tilemap_chunk_buffer_size(Size tile);
+void new_tilemap(Tilemap *m, Image tileset, Size tile, uint16_t *tiles, Size map, Buffer storage);
+void tilemap_set_tile(Tilemap *m, Point p, uint16_t id);
+void tilemap_invalidate(Tilemap *m);
+void tilemap_draw(Tilemap *m, Point scroll);
+void tilemap_reset_stats(Tilemap *m);
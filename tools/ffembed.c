@@ -0,0 +1,124 @@
+// Embed ROM files into a C header as constant data.
+//
+//     cc -O2 -o ffembed tools/ffembed.c
+//     ./ffembed src/assets.h rom/player rom/tiles rom/font
+//
+// Every input becomes a `static const` byte array and a ready-to-use value
+// named after the file: an Image for files in the image format (magic 0x21),
+// a Font for files in the font format (magic 0x11), and a File otherwise.
+// The bytes are copied as they are, so convert PNGs and fonts with the
+// firefly CLI first. Embedded assets live in the data segment of the WASM binary:
+// drawing them needs no host file calls and no memory to load them into.
+//
+//     #include "assets.h"
+//
+//     draw_image(player, (Point){10, 20});
+//
+// Define FFEMBED_NO_MAIN to use ffembed_write from other tools and benchmarks.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FFEMBED_MAX_NAME 64
+#define FFEMBED_LINE 16
+
+// Turn the file name (without the directory) into a C identifier.
+static void ffembed_name(const char *path, char *name)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = 0;
+    if (*base >= '0' && *base <= '9')
+    {
+        memcpy(name, "file_", 5);
+        len = 5;
+    }
+    for (; *base && len < FFEMBED_MAX_NAME - 1; base++)
+    {
+        char c = *base;
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        name[len++] = ok ? c : '_';
+    }
+    name[len] = 0;
+}
+
+// The type of the value for the file content.
+static const char *ffembed_type(const uint8_t *data, size_t size)
+{
+    if (size >= 5 && data[0] == 0x21)
+    {
+        return "Image";
+    }
+    if (size >= 5 && data[0] == 0x11)
+    {
+        return "Font";
+    }
+    return "File";
+}
+
+// Write a single embedded asset into the header.
+void ffembed_write(FILE *out, const char *name, const uint8_t *data, size_t size)
+{
+    fprintf(out, "static const unsigned char %s_data[%zu] = {", name, size ? size : 1);
+    for (size_t i = 0; i < size; i++)
+    {
+        fprintf(out, "%s0x%02x,", i % FFEMBED_LINE ? " " : "\n    ", data[i]);
+    }
+    fprintf(out, "%s};\n", size ? "\n" : "0");
+    fprintf(out, "static const %s %s = {%zu, (char *)%s_data};\n\n", ffembed_type(data, size), name, size, name);
+}
+
+#ifndef FFEMBED_NO_MAIN
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: ffembed <output.h> <file>...\n");
+        return 2;
+    }
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "ffembed: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "// Generated by ffembed. Do not edit.\n\n#pragma once\n\n#include \"firefly.h\"\n\n");
+    size_t total = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        FILE *in = fopen(argv[i], "rb");
+        if (in == NULL)
+        {
+            fprintf(stderr, "ffembed: cannot open %s\n", argv[i]);
+            return 1;
+        }
+        fseek(in, 0, SEEK_END);
+        long size = ftell(in);
+        fseek(in, 0, SEEK_SET);
+        uint8_t *data = malloc((size_t)size + 1);
+        if (fread(data, 1, (size_t)size, in) != (size_t)size)
+        {
+            fprintf(stderr, "ffembed: cannot read %s\n", argv[i]);
+            return 1;
+        }
+        fclose(in);
+        char name[FFEMBED_MAX_NAME];
+        ffembed_name(argv[i], name);
+        ffembed_write(out, name, data, (size_t)size);
+        total += (size_t)size;
+        free(data);
+    }
+    if (fclose(out) != 0)
+    {
+        fprintf(stderr, "ffembed: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %d files, %zu bytes\n", argv[1], argc - 2, total);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,176 @@
+// Compress a file for the LZ4 decompressor in the SDK (see src/firefly_lz.h).
+//
+//     cc -O2 -o fflz tools/fflz.c
+//     ./fflz assets/level1 rom/level1
+//
+// The output is the "FFZ1" header, the decompressed size, and a single LZ4 block.
+// The compressor is greedy with a hash table of 4-byte sequences, like LZ4 fast mode.
+// Define FFLZ_NO_MAIN to use fflz_compress from other tools and benchmarks.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FFLZ_HASH_BITS 14
+#define FFLZ_MIN_MATCH 4
+#define FFLZ_MAX_OFFSET 65535
+// LZ4 compatibility: the last match starts at least 12 bytes before the end
+// and the last 5 bytes are always literals.
+#define FFLZ_MF_LIMIT 12
+#define FFLZ_LAST_LITERALS 5
+
+// The largest possible size of the compressed block for the input size.
+static size_t fflz_bound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+static uint32_t fflz_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t fflz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - FFLZ_HASH_BITS);
+}
+
+static uint8_t *fflz_put_length(uint8_t *op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t *fflz_put_sequence(uint8_t *op, const uint8_t *lit, size_t litLen, size_t offset, size_t matchLen)
+{
+    uint8_t *token = op++;
+    *token = (uint8_t)((litLen >= 15 ? 15 : litLen) << 4);
+    if (litLen >= 15)
+    {
+        op = fflz_put_length(op, litLen - 15);
+    }
+    memcpy(op, lit, litLen);
+    op += litLen;
+    if (matchLen == 0)
+    {
+        return op;
+    }
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t m = matchLen - FFLZ_MIN_MATCH;
+    *token |= (uint8_t)(m >= 15 ? 15 : m);
+    if (m >= 15)
+    {
+        op = fflz_put_length(op, m - 15);
+    }
+    return op;
+}
+
+// Compress the input into a raw LZ4 block. The output must have fflz_bound(n) bytes.
+// Returns the compressed size.
+size_t fflz_compress(const uint8_t *src, size_t n, uint8_t *dst)
+{
+    static uint32_t table[1 << FFLZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    uint8_t *op = dst;
+    size_t anchor = 0;
+    size_t ip = 1;
+    if (n > FFLZ_MF_LIMIT)
+    {
+        size_t limit = n - FFLZ_MF_LIMIT;
+        while (ip < limit)
+        {
+            uint32_t seq = fflz_read32(src + ip);
+            uint32_t h = fflz_hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip;
+            if (ref == 0 || ip - ref > FFLZ_MAX_OFFSET || fflz_read32(src + ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+            // Extend the match backwards over pending literals and forwards up to the limit.
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+            {
+                ip--;
+                ref--;
+            }
+            size_t len = FFLZ_MIN_MATCH;
+            size_t maxLen = n - FFLZ_LAST_LITERALS - ip;
+            while (len < maxLen && src[ip + len] == src[ref + len])
+            {
+                len++;
+            }
+            op = fflz_put_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+            if (ip - 2 < limit)
+            {
+                table[fflz_hash(fflz_read32(src + ip - 2))] = (uint32_t)(ip - 2);
+            }
+        }
+    }
+    return (size_t)(fflz_put_sequence(op, src + anchor, n - anchor, 0, 0) - dst);
+}
+
+// Compress the input into a complete FFZ1 file. Returns the file size.
+// The output must have fflz_bound(n) + 8 bytes.
+size_t fflz_compress_file(const uint8_t *src, size_t n, uint8_t *dst)
+{
+    memcpy(dst, "FFZ1", 4);
+    dst[4] = (uint8_t)n;
+    dst[5] = (uint8_t)(n >> 8);
+    dst[6] = (uint8_t)(n >> 16);
+    dst[7] = (uint8_t)(n >> 24);
+    return 8 + fflz_compress(src, n, dst + 8);
+}
+
+#ifndef FFLZ_NO_MAIN
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: fflz <input> <output>\n");
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "fflz: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *src = malloc((size_t)size + 1);
+    uint8_t *dst = malloc(fflz_bound((size_t)size) + 8);
+    if (fread(src, 1, (size_t)size, in) != (size_t)size)
+    {
+        fprintf(stderr, "fflz: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+    size_t out = fflz_compress_file(src, (size_t)size, dst);
+    FILE *f = fopen(argv[2], "wb");
+    if (f == NULL || fwrite(dst, 1, out, f) != out)
+    {
+        fprintf(stderr, "fflz: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    fclose(f);
+    printf("%s: %ld -> %zu bytes (%.1f%%)\n", argv[1], size, out, size ? 100.0 * out / size : 0.0);
+    free(src);
+    free(dst);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,241 @@
+// Pack all files from a directory into a single asset bundle (see src/firefly_bundle.h).
+//
+//     cc -O2 -o ffpack tools/ffpack.c
+//     ./ffpack assets/ rom/bundle       # pack
+//     ./ffpack --list rom/bundle        # list the index
+//
+// Files in subdirectories are stored under their relative path, like "sprites/hero".
+// Define FFPACK_NO_MAIN to use ffpack_dir from other tools and benchmarks.
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct ffpack_entry
+{
+    char path[512];
+    uint32_t hash;
+    uint32_t size;
+    uint32_t offset;
+};
+
+struct ffpack_list
+{
+    struct ffpack_entry *items;
+    size_t len;
+    size_t cap;
+};
+
+static uint32_t ffpack_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s != 0; s++)
+    {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    return h;
+}
+
+static void ffpack_put_u32(FILE *f, uint32_t v)
+{
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    fwrite(b, 1, 4, f);
+}
+
+static int ffpack_cmp(const void *a, const void *b)
+{
+    uint32_t x = ((const struct ffpack_entry *)a)->hash;
+    uint32_t y = ((const struct ffpack_entry *)b)->hash;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Collect the regular files under root/rel into the list.
+static int ffpack_walk(const char *root, const char *rel, struct ffpack_list *list)
+{
+    char dirPath[1024];
+    snprintf(dirPath, sizeof(dirPath), "%s%s%s", root, rel[0] ? "/" : "", rel);
+    DIR *dir = opendir(dirPath);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "ffpack: cannot open %s\n", dirPath);
+        return -1;
+    }
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL)
+    {
+        if (d->d_name[0] == '.')
+        {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s%s%s", rel, rel[0] ? "/" : "", d->d_name);
+        char full[1024];
+        snprintf(full, sizeof(full), "%s/%s", root, path);
+        struct stat st;
+        if (stat(full, &st) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode))
+        {
+            if (ffpack_walk(root, path, list) != 0)
+            {
+                closedir(dir);
+                return -1;
+            }
+            continue;
+        }
+        if (!S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+        if (list->len == list->cap)
+        {
+            list->cap = list->cap ? list->cap * 2 : 64;
+            list->items = realloc(list->items, list->cap * sizeof(struct ffpack_entry));
+        }
+        struct ffpack_entry *e = &list->items[list->len++];
+        snprintf(e->path, sizeof(e->path), "%s", path);
+        e->hash = ffpack_hash(path);
+        e->size = (uint32_t)st.st_size;
+    }
+    closedir(dir);
+    return 0;
+}
+
+// Pack all files under the directory into the bundle at the output path.
+// Returns the number of packed files or -1 on error.
+int ffpack_dir(const char *root, const char *out)
+{
+    struct ffpack_list list = {NULL, 0, 0};
+    if (ffpack_walk(root, "", &list) != 0)
+    {
+        free(list.items);
+        return -1;
+    }
+    qsort(list.items, list.len, sizeof(struct ffpack_entry), ffpack_cmp);
+    for (size_t i = 1; i < list.len; i++)
+    {
+        if (list.items[i].hash == list.items[i - 1].hash)
+        {
+            fprintf(stderr, "ffpack: hash collision between %s and %s, rename one\n",
+                    list.items[i - 1].path, list.items[i].path);
+            free(list.items);
+            return -1;
+        }
+    }
+    uint32_t offset = 8 + 12 * (uint32_t)list.len;
+    for (size_t i = 0; i < list.len; i++)
+    {
+        offset = (offset + 3) & ~3u;
+        list.items[i].offset = offset;
+        offset += list.items[i].size;
+    }
+
+    FILE *f = fopen(out, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "ffpack: cannot create %s\n", out);
+        free(list.items);
+        return -1;
+    }
+    fwrite("FFB1", 1, 4, f);
+    ffpack_put_u32(f, (uint32_t)list.len);
+    for (size_t i = 0; i < list.len; i++)
+    {
+        ffpack_put_u32(f, list.items[i].hash);
+        ffpack_put_u32(f, list.items[i].offset);
+        ffpack_put_u32(f, list.items[i].size);
+    }
+    int status = (int)list.len;
+    for (size_t i = 0; i < list.len && status >= 0; i++)
+    {
+        while (ftell(f) < (long)list.items[i].offset)
+        {
+            fputc(0, f);
+        }
+        char full[1024];
+        snprintf(full, sizeof(full), "%s/%s", root, list.items[i].path);
+        FILE *in = fopen(full, "rb");
+        if (in == NULL)
+        {
+            fprintf(stderr, "ffpack: cannot read %s\n", full);
+            status = -1;
+            break;
+        }
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        {
+            fwrite(buf, 1, n, f);
+        }
+        fclose(in);
+    }
+    fclose(f);
+    free(list.items);
+    return status;
+}
+
+#ifndef FFPACK_NO_MAIN
+
+static int ffpack_list_bundle(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "ffpack: cannot open %s\n", path);
+        return 1;
+    }
+    uint8_t h[8];
+    if (fread(h, 1, 8, f) != 8 || memcmp(h, "FFB1", 4) != 0)
+    {
+        fprintf(stderr, "ffpack: %s is not a bundle\n", path);
+        fclose(f);
+        return 1;
+    }
+    uint32_t count = h[4] | h[5] << 8 | h[6] << 16 | (uint32_t)h[7] << 24;
+    printf("%-10s %10s %10s\n", "hash", "offset", "size");
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t e[12];
+        if (fread(e, 1, 12, f) != 12)
+        {
+            break;
+        }
+        uint32_t v[3];
+        for (int j = 0; j < 3; j++)
+        {
+            v[j] = e[j * 4] | e[j * 4 + 1] << 8 | e[j * 4 + 2] << 16 | (uint32_t)e[j * 4 + 3] << 24;
+        }
+        printf("0x%08x %10u %10u\n", v[0], v[1], v[2]);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "--list") == 0)
+    {
+        return ffpack_list_bundle(argv[2]);
+    }
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: ffpack <dir> <bundle>\n       ffpack --list <bundle>\n");
+        return 2;
+    }
+    int n = ffpack_dir(argv[1], argv[2]);
+    if (n < 0)
+    {
+        return 1;
+    }
+    printf("packed %d files into %s\n", n, argv[2]);
+    return 0;
+}
+
+#endif